@@ -0,0 +1,380 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <new>
+#include <sonar_oculus_m750d/BearingCache.hpp>
+#include <sonar_oculus_m750d/Driver.hpp>
+#include <sonar_oculus_m750d/Protocol.hpp>
+#include <sonar_oculus_m750d/Simulator.hpp>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+/**
+ * Counts the heap allocations, to report allocations per ping
+ */
+static atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+/** Bin counts of the typical low frequency (120 m) and high frequency (40 m)
+ * configurations */
+static const int LF_120M_BINS = 1500;
+static const int HF_40M_BINS = 1000;
+
+static DataSizeType dataSize(int64_t bits)
+{
+    return bits == 16 ? dataSize16Bit : dataSize8Bit;
+}
+
+static vector<uint8_t> ping(benchmark::State const& state)
+{
+    OculusSimpleFireMessage2 fire_message;
+    memset(&fire_message, 0, sizeof(fire_message));
+    fire_message.masterMode = 1;
+    fire_message.speedOfSound = 1500;
+    vector<uint8_t> packet;
+    Simulator::buildPing(packet,
+        fire_message,
+        state.range(0),
+        state.range(1),
+        0.08,
+        dataSize(state.range(2)),
+        0,
+        0);
+    return packet;
+}
+
+/**
+ * Report the usual per-ping metrics, one iteration being one ping
+ */
+class PingCounters {
+    benchmark::State& m_state;
+    size_t m_ping_size;
+    uint64_t m_allocations_start;
+
+public:
+    PingCounters(benchmark::State& state, size_t ping_size)
+        : m_state(state)
+        , m_ping_size(ping_size)
+        , m_allocations_start(allocations)
+    {
+    }
+
+    ~PingCounters()
+    {
+        double pings = m_state.iterations();
+        m_state.SetBytesProcessed(m_state.iterations() * m_ping_size);
+        m_state.counters["pings/s"] =
+            benchmark::Counter(pings, benchmark::Counter::kIsRate);
+        m_state.counters["allocs/ping"] =
+            benchmark::Counter((allocations - m_allocations_start) / pings);
+    }
+};
+
+static void shapes(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgNames({"beams", "bins", "bits"});
+    benchmark->ArgsProduct({{256, 512}, {LF_120M_BINS, HF_40M_BINS}, {8, 16}});
+}
+
+static void BM_extractPacket(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Driver driver(base::Angle::fromDeg(1),
+        base::Angle::fromDeg(20),
+        Driver::maxPacketSize(512, LF_120M_BINS, dataSize16Bit));
+    iodrivers_base::Driver& base = driver;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(base.extractPacket(packet.data(), packet.size()));
+    }
+}
+BENCHMARK(BM_extractPacket)->Apply(shapes);
+
+static void BM_extractPacketResync(benchmark::State& state)
+{
+    // Garbage the size of a ping, without any magic in it
+    vector<uint8_t> garbage(state.range(0) * state.range(1), 0x42);
+    Driver driver(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    iodrivers_base::Driver& base = driver;
+
+    PingCounters counters(state, garbage.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(base.extractPacket(garbage.data(), garbage.size()));
+    }
+}
+BENCHMARK(BM_extractPacketResync)
+    ->ArgNames({"beams", "bins"})
+    ->ArgsProduct({{256, 512}, {LF_120M_BINS, HF_40M_BINS}});
+
+static void BM_handleBuffer(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(protocol.handleBuffer(packet.data(), packet.size()));
+    }
+}
+BENCHMARK(BM_handleBuffer)->Apply(shapes);
+
+static void BM_parseSonar(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+    protocol.handleBuffer(packet.data(), packet.size());
+    base::samples::Sonar sonar;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+        benchmark::DoNotOptimize(sonar.bins.data());
+    }
+}
+BENCHMARK(BM_parseSonar)->Apply(shapes);
+
+static void BM_parseCompactSonar(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+    protocol.handleBuffer(packet.data(), packet.size());
+    CompactSonar sonar;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+        benchmark::DoNotOptimize(sonar.bins.data());
+    }
+}
+BENCHMARK(BM_parseCompactSonar)->Apply(shapes);
+
+static void BM_parseSonarDecimated(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+    DecodeRegion region;
+    region.range_decimation = 2;
+    region.beam_decimation = 2;
+    protocol.setDecodeRegion(region);
+    protocol.handleBuffer(packet.data(), packet.size());
+    base::samples::Sonar sonar;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+        benchmark::DoNotOptimize(sonar.bins.data());
+    }
+}
+BENCHMARK(BM_parseSonarDecimated)->Apply(shapes);
+
+static void BM_parseSonarGainCompensated(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+    GainCompensation compensation;
+    compensation.enabled = true;
+    protocol.setGainCompensation(compensation);
+    protocol.handleBuffer(packet.data(), packet.size());
+    base::samples::Sonar sonar;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+        benchmark::DoNotOptimize(sonar.bins.data());
+    }
+}
+BENCHMARK(BM_parseSonarGainCompensated)->Apply(shapes);
+
+static void BM_parseSonarIntensityLUT(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+    protocol.setIntensityLUT(IntensityLUT::gamma(0.5));
+    protocol.handleBuffer(packet.data(), packet.size());
+    base::samples::Sonar sonar;
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+        benchmark::DoNotOptimize(sonar.bins.data());
+    }
+}
+BENCHMARK(BM_parseSonarIntensityLUT)->Apply(shapes);
+
+static void BM_toBeamMajor(benchmark::State& state)
+{
+    int beams = state.range(0);
+    int bins = state.range(1);
+    vector<uint8_t> image(beams * bins, 42);
+
+    PingCounters counters(state, image.size());
+    for (auto _ : state) {
+        auto bins_vector = Protocol::toBeamMajor(image, beams, bins);
+        benchmark::DoNotOptimize(bins_vector.data());
+    }
+}
+BENCHMARK(BM_toBeamMajor)
+    ->ArgNames({"beams", "bins"})
+    ->ArgsProduct({{256, 512}, {LF_120M_BINS, HF_40M_BINS}});
+
+static void BM_normalizeBins(benchmark::State& state)
+{
+    vector<float> bins(state.range(0) * state.range(1), 42);
+
+    PingCounters counters(state, bins.size());
+    for (auto _ : state) {
+        Protocol::normalizeBins(bins);
+        benchmark::DoNotOptimize(bins.data());
+    }
+}
+BENCHMARK(BM_normalizeBins)
+    ->ArgNames({"beams", "bins"})
+    ->ArgsProduct({{256, 512}, {LF_120M_BINS, HF_40M_BINS}});
+
+static void BM_bearingsCacheHit(benchmark::State& state)
+{
+    state.SetLabel("cached");
+    auto packet = ping(state);
+    Protocol protocol;
+    protocol.handleBuffer(packet.data(), packet.size());
+    BearingCache cache;
+    cache.get(protocol.getPingView());
+
+    PingCounters counters(state, state.range(0) * sizeof(short));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.get(protocol.getPingView()).get());
+    }
+}
+BENCHMARK(BM_bearingsCacheHit)->ArgNames({"beams", "bins", "bits"})->Args({256, 1, 8})->Args({512, 1, 8});
+
+static void BM_bearingsConversion(benchmark::State& state)
+{
+    auto packet = ping(state);
+    Protocol protocol;
+    protocol.handleBuffer(packet.data(), packet.size());
+    PingView const& view = protocol.getPingView();
+    vector<base::Angle> bearings(view.beam_count);
+
+    PingCounters counters(state, state.range(0) * sizeof(short));
+    for (auto _ : state) {
+        for (int i = 0; i < view.beam_count; i++) {
+            bearings[i] = BearingCache::toAngle(view.bearing(i));
+        }
+        benchmark::DoNotOptimize(bearings.data());
+    }
+}
+BENCHMARK(BM_bearingsConversion)->ArgNames({"beams", "bins", "bits"})->Args({256, 1, 8})->Args({512, 1, 8});
+
+/**
+ * Local TCP server that sends the same packets over and over, for end to end
+ * measurements without the cost of generating the pings
+ */
+class ReplayServer {
+    int m_server = -1;
+    atomic<int> m_client{-1};
+    uint16_t m_port = 0;
+    atomic<bool> m_running{true};
+    thread m_thread;
+    vector<uint8_t> m_stream;
+
+public:
+    explicit ReplayServer(vector<uint8_t> stream)
+        : m_stream(move(stream))
+    {
+        m_server = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(m_server, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+            listen(m_server, 1) != 0 ||
+            getsockname(m_server, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            throw runtime_error("cannot create the replay server");
+        }
+        m_port = ntohs(address.sin_port);
+        m_thread = thread([this] { run(); });
+    }
+
+    ~ReplayServer()
+    {
+        m_running = false;
+        shutdown(m_server, SHUT_RDWR);
+        if (m_client >= 0) {
+            shutdown(m_client, SHUT_RDWR);
+        }
+        m_thread.join();
+        close(m_server);
+    }
+
+    uint16_t port() const
+    {
+        return m_port;
+    }
+
+private:
+    void run()
+    {
+        int client = accept(m_server, nullptr, nullptr);
+        m_client = client;
+        if (!m_running) {
+            // The destructor may have missed the client
+            shutdown(client, SHUT_RDWR);
+        }
+        while (m_running && client >= 0) {
+            if (send(client, m_stream.data(), m_stream.size(), MSG_NOSIGNAL) < 0) {
+                break;
+            }
+        }
+        if (client >= 0) {
+            close(client);
+        }
+    }
+};
+
+static void BM_processOne(benchmark::State& state)
+{
+    auto packet = ping(state);
+    ReplayServer server(packet);
+    Driver driver(base::Angle::fromDeg(1),
+        base::Angle::fromDeg(20),
+        Driver::maxPacketSize(512, LF_120M_BINS, dataSize16Bit));
+    driver.openURI("tcp://127.0.0.1:" + to_string(server.port()));
+    base::samples::Sonar sonar;
+    driver.processOne(sonar);
+
+    PingCounters counters(state, packet.size());
+    for (auto _ : state) {
+        driver.processOne(sonar);
+    }
+    driver.close();
+}
+BENCHMARK(BM_processOne)->Apply(shapes)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,166 @@
+#include "AcquisitionPipeline.hpp"
+#include "Driver.hpp"
+#include <algorithm>
+#include <iodrivers_base/Exceptions.hpp>
+
+using namespace sonar_oculus_m750d;
+
+/** How often the stages check whether they should stop */
+static const base::Time POLL_PERIOD = base::Time::fromMilliseconds(100);
+
+void StageLatency::add(base::Time const& latency)
+{
+    count++;
+    last = latency;
+    max = std::max(max, latency);
+    mean = base::Time::fromMicroseconds(
+        mean.toMicroseconds() +
+        (latency.toMicroseconds() - mean.toMicroseconds()) / static_cast<int64_t>(count));
+}
+
+AcquisitionPipeline::AcquisitionPipeline(Driver& driver, size_t queue_depth)
+    : m_driver(driver)
+    , m_packets(std::max<size_t>(queue_depth, 1))
+    , m_samples(std::max<size_t>(queue_depth, 1))
+{
+}
+
+AcquisitionPipeline::~AcquisitionPipeline()
+{
+    stop();
+}
+
+void AcquisitionPipeline::start()
+{
+    if (m_running) {
+        return;
+    }
+    m_packets.reopen();
+    m_samples.reopen();
+    m_error = std::exception_ptr();
+    m_running = true;
+    m_receiver = std::thread(&AcquisitionPipeline::receiveLoop, this);
+    m_decoder = std::thread(&AcquisitionPipeline::decodeLoop, this);
+}
+
+void AcquisitionPipeline::stop()
+{
+    m_running = false;
+    m_packets.close();
+    if (m_receiver.joinable()) {
+        m_receiver.join();
+    }
+    if (m_decoder.joinable()) {
+        m_decoder.join();
+    }
+    m_samples.close();
+}
+
+bool AcquisitionPipeline::isRunning() const
+{
+    return m_running;
+}
+
+void AcquisitionPipeline::receiveLoop()
+{
+    while (m_running) {
+        PacketBuffer& packet = m_packets.writeSlot();
+        // Give the slot's previous buffer back to the pool before asking for
+        // a new one
+        packet.reset();
+        try {
+            m_driver.keepAlive();
+            packet = m_driver.readPacketBuffer(POLL_PERIOD);
+        }
+        catch (iodrivers_base::TimeoutError const&) {
+            continue;
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = std::current_exception();
+            break;
+        }
+
+        bool dropped = !m_packets.publish();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.packets_received++;
+        if (dropped) {
+            m_statistics.packets_dropped++;
+        }
+    }
+    m_running = false;
+    m_packets.close();
+}
+
+void AcquisitionPipeline::decodeLoop()
+{
+    while (true) {
+        PacketBuffer* packet = m_packets.acquire(POLL_PERIOD);
+        if (!packet) {
+            if (!m_running) {
+                break;
+            }
+            continue;
+        }
+
+        DecodedSample& sample = m_samples.writeSlot();
+        base::Time decode_start = base::Time::now();
+        bool decoded = false;
+        try {
+            decoded = m_driver.decodePacket(packet->data(),
+                packet->size(),
+                packet->receivedAt(),
+                sample.sonar);
+        }
+        catch (std::runtime_error const&) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_statistics.decode_errors++;
+        }
+        sample.received_at = packet->receivedAt();
+        sample.decoded_at = base::Time::now();
+        packet->reset();
+        m_packets.release();
+        if (!decoded) {
+            continue;
+        }
+
+        bool dropped = !m_samples.publish();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.samples_decoded++;
+        if (dropped) {
+            m_statistics.samples_dropped++;
+        }
+        m_statistics.receive_queue.add(decode_start - sample.received_at);
+        m_statistics.decode.add(sample.decoded_at - decode_start);
+    }
+    m_samples.close();
+}
+
+bool AcquisitionPipeline::pop(base::samples::Sonar& sonar, base::Time const& timeout)
+{
+    DecodedSample* sample = m_samples.acquire(timeout);
+    if (!sample) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+        return false;
+    }
+
+    base::Time now = base::Time::now();
+    std::swap(sonar, sample->sonar);
+    base::Time received_at = sample->received_at;
+    base::Time decoded_at = sample->decoded_at;
+    m_samples.release();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.output_queue.add(now - decoded_at);
+    m_statistics.total.add(now - received_at);
+    return true;
+}
+
+AcquisitionPipelineStatistics AcquisitionPipeline::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
@@ -0,0 +1,120 @@
+#ifndef SONAR_OCULUS_M750D_ACQUISITIONPIPELINE_HPP
+#define SONAR_OCULUS_M750D_ACQUISITIONPIPELINE_HPP
+
+#include <atomic>
+#include <base/samples/Sonar.hpp>
+#include <exception>
+#include <mutex>
+#include <sonar_oculus_m750d/PacketPool.hpp>
+#include <sonar_oculus_m750d/SlotRing.hpp>
+#include <thread>
+
+namespace sonar_oculus_m750d {
+    class Driver;
+
+    /**
+     * @brief Latency of one pipeline stage
+     */
+    struct StageLatency {
+        base::Time last;
+        base::Time mean;
+        base::Time max;
+        uint64_t count = 0;
+
+        void add(base::Time const& latency);
+    };
+
+    struct AcquisitionPipelineStatistics {
+        /** Packets read from the device */
+        uint64_t packets_received = 0;
+        /** Packets dropped because the decode stage was not keeping up */
+        uint64_t packets_dropped = 0;
+        /** Pings decoded into samples */
+        uint64_t samples_decoded = 0;
+        /** Samples dropped because the consumer was not keeping up */
+        uint64_t samples_dropped = 0;
+        /** Packets that failed to decode */
+        uint64_t decode_errors = 0;
+
+        /** From the packet reception to the start of its decoding */
+        StageLatency receive_queue;
+        /** Decoding and conversion of a ping */
+        StageLatency decode;
+        /** From the end of the decoding to the consumer popping the sample */
+        StageLatency output_queue;
+        /** From the packet reception to the consumer popping the sample */
+        StageLatency total;
+    };
+
+    /**
+     * @brief Threaded acquisition, with separate receive and decode stages
+     *
+     * A receiver thread reads raw packets into buffers from the driver's
+     * packet pool and queues them in a ring, a decoder thread converts them
+     * into samples stored in a second ring, and the consumer pops finished
+     * samples with pop(). A slow conversion therefore never delays the next
+     * socket read.
+     *
+     * Both rings hold queue_depth elements, at least one, and drop the
+     * oldest one when full, so that the consumer always gets the most recent
+     * pings. Drops are counted in the statistics.
+     *
+     * While the pipeline runs, the driver must not be read from other threads
+     * (processOne and the likes). It may be configured from any thread, with
+     * Driver::fireSonar or the conversion setters (Driver::setDecodeRegion
+     * and the likes): the driver hands these over to the decoder thread,
+     * which applies them before its next packet. The receiver thread takes
+     * care of the keep-alive.
+     */
+    class AcquisitionPipeline {
+    public:
+        static const size_t DEFAULT_QUEUE_DEPTH = 4;
+
+        explicit AcquisitionPipeline(Driver& driver,
+            size_t queue_depth = DEFAULT_QUEUE_DEPTH);
+        ~AcquisitionPipeline();
+
+        void start();
+        void stop();
+        bool isRunning() const;
+
+        /**
+         * @brief Get the oldest decoded sample
+         *
+         * The sample is swapped with the one passed as argument, whose memory
+         * is then reused by the decoder. Passing the same sample over and over
+         * does not allocate.
+         *
+         * If the receiver thread stopped on an error, this rethrows it.
+         *
+         * @return true if a sample was available before the timeout
+         */
+        bool pop(base::samples::Sonar& sonar, base::Time const& timeout);
+
+        AcquisitionPipelineStatistics getStatistics() const;
+
+    private:
+        struct DecodedSample {
+            base::samples::Sonar sonar;
+            base::Time received_at;
+            base::Time decoded_at;
+        };
+
+        void receiveLoop();
+        void decodeLoop();
+
+        Driver& m_driver;
+        SlotRing<PacketBuffer> m_packets;
+        SlotRing<DecodedSample> m_samples;
+
+        std::atomic<bool> m_running{false};
+        std::thread m_receiver;
+        std::thread m_decoder;
+
+        mutable std::mutex m_mutex;
+        AcquisitionPipelineStatistics m_statistics;
+        std::exception_ptr m_error;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_ACQUISITIONPIPELINE_HPP
@@ -0,0 +1,74 @@
+#include "BearingCache.hpp"
+#include <algorithm>
+#include <string.h>
+
+using namespace sonar_oculus_m750d;
+
+BearingCache::BearingCache(size_t capacity)
+    : m_capacity(std::max<size_t>(capacity, 1))
+{
+    m_entries.reserve(m_capacity);
+}
+
+base::Angle BearingCache::toAngle(short bearing)
+{
+    return base::Angle::fromDeg(static_cast<double>(-bearing) / 100);
+}
+
+uint64_t BearingCache::hash(PingView const& ping)
+{
+    // FNV-1a
+    uint64_t result = 0xcbf29ce484222325ULL;
+    size_t size = ping.beam_count * sizeof(short);
+    for (size_t i = 0; i < size; i++) {
+        result = (result ^ ping.bearings[i]) * 0x100000001b3ULL;
+    }
+    return result;
+}
+
+bool BearingCache::matches(Entry const& entry, PingView const& ping, uint64_t hash)
+{
+    return entry.beam_count == ping.beam_count && entry.hash == hash &&
+           memcmp(entry.raw.data(), ping.bearings, ping.beam_count * sizeof(short)) ==
+               0;
+}
+
+BearingCache::Bearings BearingCache::get(PingView const& ping)
+{
+    uint64_t key = hash(ping);
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        if (matches(m_entries[i], ping, key)) {
+            m_statistics.hits++;
+            std::rotate(m_entries.begin(), m_entries.begin() + i, m_entries.begin() + i + 1);
+            return m_entries.front().angles;
+        }
+    }
+
+    m_statistics.misses++;
+    if (m_entries.size() < m_capacity) {
+        m_entries.emplace_back();
+    }
+    std::rotate(m_entries.begin(), m_entries.end() - 1, m_entries.end());
+
+    Entry& entry = m_entries.front();
+    entry.beam_count = ping.beam_count;
+    entry.hash = key;
+    entry.raw.resize(ping.beam_count);
+    memcpy(entry.raw.data(), ping.bearings, ping.beam_count * sizeof(short));
+    auto angles = std::make_shared<std::vector<base::Angle>>(ping.beam_count);
+    for (size_t i = 0; i < ping.beam_count; i++) {
+        (*angles)[i] = toAngle(entry.raw[i]);
+    }
+    entry.angles = angles;
+    return entry.angles;
+}
+
+BearingCacheStatistics BearingCache::getStatistics() const
+{
+    return m_statistics;
+}
+
+void BearingCache::resetStatistics()
+{
+    m_statistics = BearingCacheStatistics();
+}
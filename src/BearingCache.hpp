@@ -0,0 +1,71 @@
+#ifndef SONAR_OCULUS_M750D_BEARINGCACHE_HPP
+#define SONAR_OCULUS_M750D_BEARINGCACHE_HPP
+
+#include <base/Angle.hpp>
+#include <memory>
+#include <sonar_oculus_m750d/PingView.hpp>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    struct BearingCacheStatistics {
+        /**
+         * @brief Lookups served from an already converted table
+         */
+        uint64_t hits = 0;
+        /**
+         * @brief Lookups that required converting the bearing table
+         */
+        uint64_t misses = 0;
+    };
+
+    /**
+     * @brief Cache of the bearing tables converted to angles
+     *
+     * The sonar sends the same bearing table with every ping until the mode or
+     * the beam count changes. Tables are keyed by beam count and a hash of the
+     * raw bearings, and confirmed with a full comparison. The cache keeps the
+     * last few tables so that switching back and forth between modes does not
+     * cause conversions either.
+     */
+    class BearingCache {
+    public:
+        typedef std::shared_ptr<std::vector<base::Angle> const> Bearings;
+
+        static const size_t DEFAULT_CAPACITY = 4;
+
+        explicit BearingCache(size_t capacity = DEFAULT_CAPACITY);
+
+        /**
+         * @brief The bearings of a ping as angles
+         *
+         * The returned table is shared with the cache, and is never modified
+         */
+        Bearings get(PingView const& ping);
+
+        BearingCacheStatistics getStatistics() const;
+        void resetStatistics();
+
+        /**
+         * @brief Convert a bearing in 0.01 degrees, as sent by the sonar
+         */
+        static base::Angle toAngle(short bearing);
+
+    private:
+        struct Entry {
+            uint16_t beam_count = 0;
+            uint64_t hash = 0;
+            std::vector<short> raw;
+            Bearings angles;
+        };
+
+        static uint64_t hash(PingView const& ping);
+        static bool matches(Entry const& entry, PingView const& ping, uint64_t hash);
+
+        size_t m_capacity;
+        /** The entries, most recently used first */
+        std::vector<Entry> m_entries;
+        BearingCacheStatistics m_statistics;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_BEARINGCACHE_HPP
@@ -0,0 +1,95 @@
+#include "ClockEstimator.hpp"
+#include <cmath>
+
+using namespace sonar_oculus_m750d;
+
+/** Weight of a new latency measurement in the latency mean and variance */
+static const double LATENCY_SMOOTHING = 0.05;
+
+ClockEstimator::ClockEstimator(base::Time const& window,
+    base::Time const& reset_threshold)
+    : m_window(window)
+    , m_reset_threshold(reset_threshold)
+    , m_samples(MAX_WINDOW_SAMPLES)
+{
+}
+
+ClockEstimator::Sample& ClockEstimator::at(size_t i)
+{
+    return m_samples[(m_front + i) % m_samples.size()];
+}
+
+void ClockEstimator::clearWindow()
+{
+    m_front = 0;
+    m_size = 0;
+    m_has_last = false;
+}
+
+void ClockEstimator::reset()
+{
+    clearWindow();
+    m_latency_mean = 0;
+    m_latency_variance = 0;
+    m_statistics = ClockEstimatorStatistics();
+}
+
+base::Time ClockEstimator::update(double device_time, base::Time const& host_time)
+{
+    base::Time offset = host_time - base::Time::fromSeconds(device_time);
+    if (m_has_last) {
+        bool went_backwards = device_time < m_last_device_time;
+        bool jumped_ahead = offset + m_reset_threshold < m_statistics.offset;
+        if (went_backwards || jumped_ahead) {
+            clearWindow();
+            m_statistics.resets++;
+        }
+    }
+    m_has_last = true;
+    m_last_device_time = device_time;
+
+    // Drop the samples that left the window, then the ones that can no longer
+    // be the minimum
+    while (m_size > 0 && at(0).host_time + m_window < host_time) {
+        m_front = (m_front + 1) % m_samples.size();
+        m_size--;
+    }
+    while (m_size > 0 && offset <= at(m_size - 1).offset) {
+        m_size--;
+    }
+    if (m_size == m_samples.size()) {
+        m_front = (m_front + 1) % m_samples.size();
+        m_size--;
+    }
+    at(m_size) = Sample{host_time, offset};
+    m_size++;
+
+    m_statistics.offset = at(0).offset;
+    m_statistics.samples++;
+
+    double latency = (offset - m_statistics.offset).toSeconds();
+    if (m_statistics.samples == 1) {
+        m_latency_mean = latency;
+        m_latency_variance = 0;
+    }
+    else {
+        double delta = latency - m_latency_mean;
+        m_latency_mean += LATENCY_SMOOTHING * delta;
+        m_latency_variance =
+            (1 - LATENCY_SMOOTHING) * (m_latency_variance + LATENCY_SMOOTHING * delta * delta);
+    }
+    m_statistics.latency = base::Time::fromSeconds(m_latency_mean);
+    m_statistics.jitter = base::Time::fromSeconds(std::sqrt(m_latency_variance));
+
+    return toHostTime(device_time);
+}
+
+base::Time ClockEstimator::toHostTime(double device_time) const
+{
+    return base::Time::fromSeconds(device_time) + m_statistics.offset;
+}
+
+ClockEstimatorStatistics ClockEstimator::getStatistics() const
+{
+    return m_statistics;
+}
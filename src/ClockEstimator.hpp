@@ -0,0 +1,106 @@
+#ifndef SONAR_OCULUS_M750D_CLOCKESTIMATOR_HPP
+#define SONAR_OCULUS_M750D_CLOCKESTIMATOR_HPP
+
+#include <base/Time.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    struct ClockEstimatorStatistics {
+        /**
+         * @brief The current estimate of host time minus device time
+         */
+        base::Time offset;
+        /**
+         * @brief Standard deviation of the transport latency
+         *
+         * The latency being the difference between the time a ping was
+         * received and the time at which it was emitted, as estimated
+         */
+        base::Time jitter;
+        /**
+         * @brief Mean transport latency
+         */
+        base::Time latency;
+        /**
+         * @brief How many times a device clock reset has been detected
+         */
+        uint64_t resets = 0;
+        /**
+         * @brief How many time pairs have been processed
+         */
+        uint64_t samples = 0;
+    };
+
+    /**
+     * @brief Map the device clock (seconds since power-up) to the host clock
+     *
+     * Each ping gives a pair (device time, host reception time). Their
+     * difference is the clock offset plus a transport latency that is always
+     * positive, so the offset is estimated as the minimum of the differences
+     * over a sliding window. The window lets the estimate follow the relative
+     * drift of the two clocks.
+     *
+     * The device clock is assumed to have been reset (e.g. sonar power cycle)
+     * when it goes backwards, or when it jumps ahead of the host clock by
+     * more than the reset threshold. The window is then cleared.
+     */
+    class ClockEstimator {
+    public:
+        /** Maximum number of pairs held in the window */
+        static const size_t MAX_WINDOW_SAMPLES = 1024;
+
+        explicit ClockEstimator(base::Time const& window = base::Time::fromSeconds(10),
+            base::Time const& reset_threshold = base::Time::fromSeconds(1));
+
+        /**
+         * @brief Update the estimate
+         *
+         * @param device_time the device timestamp, in seconds
+         * @param host_time the host time at which the data was received
+         * @return the host time corresponding to device_time
+         */
+        base::Time update(double device_time, base::Time const& host_time);
+
+        /**
+         * @brief Convert a device time with the current estimate
+         */
+        base::Time toHostTime(double device_time) const;
+
+        ClockEstimatorStatistics getStatistics() const;
+
+        /**
+         * @brief Forget all past measurements and statistics
+         */
+        void reset();
+
+    private:
+        struct Sample {
+            base::Time host_time;
+            base::Time offset;
+        };
+
+        /** Drop the current window, keeping the statistics */
+        void clearWindow();
+        Sample& at(size_t i);
+
+        base::Time m_window;
+        base::Time m_reset_threshold;
+
+        /**
+         * Monotonic queue (increasing offsets) stored in a fixed size ring, its
+         * front is the minimum over the window
+         */
+        std::vector<Sample> m_samples;
+        size_t m_front = 0;
+        size_t m_size = 0;
+
+        bool m_has_last = false;
+        double m_last_device_time = 0;
+        double m_latency_mean = 0;
+        double m_latency_variance = 0;
+        ClockEstimatorStatistics m_statistics;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_CLOCKESTIMATOR_HPP
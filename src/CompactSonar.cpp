@@ -0,0 +1,43 @@
+#include "CompactSonar.hpp"
+
+using namespace sonar_oculus_m750d;
+
+void CompactSonar::toSonar(base::samples::Sonar& sonar) const
+{
+    sonar.time = time;
+    sonar.bin_duration = bin_duration;
+    sonar.beam_width = beam_width;
+    sonar.beam_height = beam_height;
+    sonar.speed_of_sound = speed_of_sound;
+    sonar.bin_count = bin_count;
+    sonar.beam_count = beam_count;
+    sonar.timestamps.clear();
+    sonar.bearings = bearings;
+
+    // There are only 256 possible values, convert them once
+    float values[256];
+    for (int i = 0; i < 256; i++) {
+        values[i] = static_cast<float>(static_cast<double>(i) * scale);
+    }
+    sonar.bins.resize(bins.size());
+    if (gains.empty()) {
+        for (size_t i = 0; i < bins.size(); i++) {
+            sonar.bins[i] = values[bins[i]];
+        }
+        return;
+    }
+    for (size_t b = 0; b < beam_count; b++) {
+        float* out = sonar.bins.data() + b * bin_count;
+        uint8_t const* in = bins.data() + b * bin_count;
+        for (size_t r = 0; r < bin_count; r++) {
+            out[r] = values[in[r]] * gains[r];
+        }
+    }
+}
+
+base::samples::Sonar CompactSonar::toSonar() const
+{
+    base::samples::Sonar sonar;
+    toSonar(sonar);
+    return sonar;
+}
@@ -0,0 +1,60 @@
+#ifndef SONAR_OCULUS_M750D_COMPACTSONAR_HPP
+#define SONAR_OCULUS_M750D_COMPACTSONAR_HPP
+
+#include <base/Angle.hpp>
+#include <base/Time.hpp>
+#include <base/samples/Sonar.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief A sonar sample that keeps the echoes as bytes
+     *
+     * base::samples::Sonar stores each bin as a float, four times the size of
+     * the 8 bit image the sonar sends. This type holds the same data with one
+     * byte per bin, which is what should be logged or sent between processes.
+     * Consumers convert it with toSonar when they need a
+     * base::samples::Sonar.
+     */
+    struct CompactSonar {
+        base::Time time;
+        base::Time bin_duration;
+        base::Angle beam_width;
+        base::Angle beam_height;
+        float speed_of_sound = 0;
+        uint32_t bin_count = 0;
+        uint32_t beam_count = 0;
+        std::vector<base::Angle> bearings;
+        /**
+         * @brief The echoes in beam-major order, [beam * bin_count + bin]
+         */
+        std::vector<uint8_t> bins;
+        /**
+         * @brief The factor that converts the bytes in bins to the values of
+         * base::samples::Sonar::bins
+         */
+        double scale = 1;
+        /**
+         * @brief Per-bin amplitude gains, bin_count of them, or empty if the
+         * pings were not compensated
+         *
+         * The bytes are kept as the sonar sent them, so that the gains, which
+         * reach several orders of magnitude, do not saturate them. toSonar
+         * applies them. See GainCompensation
+         */
+        std::vector<float> gains;
+
+        /**
+         * @brief Convert into a caller-owned sample
+         *
+         * The memory already held by the sample is reused. For images the
+         * sonar sent with 8 bit samples, the result is identical to what
+         * Protocol::parseSonar produces, gains included.
+         */
+        void toSonar(base::samples::Sonar& sonar) const;
+        base::samples::Sonar toSonar() const;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_COMPACTSONAR_HPP
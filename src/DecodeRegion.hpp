@@ -0,0 +1,64 @@
+#ifndef SONAR_OCULUS_M750D_DECODEREGION_HPP
+#define SONAR_OCULUS_M750D_DECODEREGION_HPP
+
+#include <base/Float.hpp>
+#include <cstdint>
+#include <sonar_oculus_m750d/Transpose.hpp>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief The part of the pings that should be converted, and how much it
+     * should be decimated
+     *
+     * The default converts the whole ping at full resolution
+     */
+    struct DecodeRegion {
+        /**
+         * @brief The bins closer than this range, in meters, are set to zero
+         * instead of being converted
+         *
+         * base::samples::Sonar has no notion of a starting range, so the
+         * bins are kept to preserve the bin to range mapping
+         */
+        double min_range = 0;
+        /**
+         * @brief The bins further than this range, in meters, are dropped
+         *
+         * Leave unknown to keep the whole range
+         */
+        double max_range = base::unknown<double>();
+        /**
+         * @brief The index of the first beam to keep
+         */
+        uint16_t first_beam = 0;
+        /**
+         * @brief How many beams to keep from first_beam, 0 for all the
+         * remaining ones
+         */
+        uint16_t beam_count = 0;
+        /**
+         * @brief How many consecutive bins are pooled into one
+         */
+        uint16_t range_decimation = 1;
+        /**
+         * @brief How many consecutive beams are pooled into one
+         */
+        uint16_t beam_decimation = 1;
+        /**
+         * @brief How the decimated samples are combined
+         */
+        PoolingMode pooling = POOLING_MAX;
+
+        /**
+         * @brief Whether this region converts the whole ping at full
+         * resolution
+         */
+        bool isFull() const
+        {
+            return min_range <= 0 && base::isUnknown(max_range) && first_beam == 0 &&
+                   beam_count == 0 && range_decimation <= 1 && beam_decimation <= 1;
+        }
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_DECODEREGION_HPP
@@ -1,26 +1,47 @@
 #include "Driver.hpp"
 #include "Oculus.h"
+#include "PacketValidation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iodrivers_base/Exceptions.hpp>
 #include <string.h>
 
 using namespace sonar_oculus_m750d;
 
-Driver::Driver(base::Angle const& beam_width, base::Angle const& beam_height)
-    : iodrivers_base::Driver::Driver(INTERNAL_BUFFER_SIZE)
+Driver::Driver(base::Angle const& beam_width,
+    base::Angle const& beam_height,
+    int max_packet_size)
+    : iodrivers_base::Driver::Driver(max_packet_size)
+    , m_packet_pool(max_packet_size)
     , m_beam_width(beam_width)
     , m_beam_height(beam_height)
 {
     m_protocol = Protocol();
 }
 
-static bool isValidHeader(OculusMessageHeader const& header)
+int Driver::maxPacketSize(uint16_t beam_count,
+    uint16_t bin_count,
+    DataSizeType data_size)
 {
-    return header.oculusId == OCULUS_CHECK_ID;
+    // The full ping result has the larger header of the two ping messages
+    size_t header_size =
+        std::max(sizeof(OculusReturnFireMessage), sizeof(OculusSimplePingResult2));
+    size_t bearings_size = beam_count * sizeof(short);
+    size_t image_size = static_cast<size_t>(beam_count) * bin_count *
+                        Protocol::sampleSize(data_size);
+    return header_size + bearings_size + image_size;
 }
 
+static size_t findSyncCandidate(uint8_t const* buffer, size_t buffer_size, size_t start);
+
 int Driver::extractPacket(uint8_t const* buffer, size_t buffer_size) const
 {
     auto header_size = sizeof(OculusMessageHeader);
 
+    size_t sync = findSyncCandidate(buffer, buffer_size, 0);
+    if (sync != 0) {
+        return resync(sync);
+    }
     if (buffer_size < header_size) {
         // Not enough data for a header — wait for more
         return 0;
@@ -28,34 +49,618 @@ int Driver::extractPacket(uint8_t const* buffer, size_t buffer_size) const
 
     OculusMessageHeader header;
     memcpy(&header, buffer, header_size);
-    if (!isValidHeader(header)) {
-        // discard first byte
-        return -1;
+    if (!isValidHeader(header, getMaxPacketSize())) {
+        // Garbage that happens to start with the magic
+        m_counters.rejected_packets++;
+        return resync(findSyncCandidate(buffer, buffer_size, 1));
     }
 
     size_t packet_size = header_size + header.payloadSize;
-    if (buffer_size >= packet_size) {
-        // Packet starting at zero is valid
-        return packet_size;
+    if (buffer_size < packet_size) {
+        // Not enough bytes for a valid packet - wait for new bytes
+        return 0;
     }
 
-    // Not enough bytes for a valid packet - wait for new bytes
-    return 0;
+    if (!isConsistentPacket(buffer, header, packet_size)) {
+        m_counters.rejected_packets++;
+        return resync(findSyncCandidate(buffer, buffer_size, 1));
+    }
+    return packet_size;
+}
+
+int Driver::resync(size_t skip) const
+{
+    m_counters.resync_events++;
+    m_counters.bytes_skipped += skip;
+    return -static_cast<int>(skip);
+}
+
+ResyncStatistics Driver::getResyncStatistics() const
+{
+    ResyncStatistics stats;
+    stats.resync_events = m_counters.resync_events;
+    stats.bytes_skipped = m_counters.bytes_skipped;
+    stats.rejected_packets = m_counters.rejected_packets;
+    return stats;
+}
+
+DriverStatistics Driver::getStatistics() const
+{
+    DriverStatistics stats;
+    stats.time = base::Time::now();
+    m_counters.snapshot(stats);
+    stats.clock = getClockEstimatorStatistics();
+    stats.time_to_first_ping = getTimeToFirstPing();
+    return stats;
+}
+
+void Driver::resetStatistics()
+{
+    m_counters.reset();
+
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    m_first_fire_time = base::Time();
+    m_time_to_first_ping = base::Time();
+    m_first_ping_received = false;
+}
+
+/**
+ * Find the first position at or after start that may be the start of a
+ * message header, i.e. the 0x4f53 magic, or its first byte at the very end
+ * of the buffer. Returns buffer_size if there is none
+ */
+size_t findSyncCandidate(uint8_t const* buffer, size_t buffer_size, size_t start)
+{
+    uint8_t const first = OCULUS_CHECK_ID & 0xff;
+    uint8_t const second = OCULUS_CHECK_ID >> 8;
+
+    while (start < buffer_size) {
+        auto candidate = static_cast<uint8_t const*>(
+            memchr(buffer + start, first, buffer_size - start));
+        if (!candidate) {
+            return buffer_size;
+        }
+        size_t offset = candidate - buffer;
+        if (offset + 1 == buffer_size || buffer[offset + 1] == second) {
+            return offset;
+        }
+        start = offset + 1;
+    }
+    return buffer_size;
 }
 
 std::optional<base::samples::Sonar> Driver::processOne()
 {
-    readPacket(m_read_buffer, INTERNAL_BUFFER_SIZE);
-    if (m_protocol.handleBuffer(m_read_buffer)) {
-        auto sonar = m_protocol.parseSonar(m_beam_width, m_beam_height);
+    base::samples::Sonar sonar;
+    if (processOne(sonar)) {
         return sonar;
     }
     return std::nullopt;
 }
 
-static uint8_t setFlags(bool gain_assist);
+bool Driver::processOne(base::samples::Sonar& sonar)
+{
+    return processOneSample(sonar);
+}
+
+bool Driver::processOne(CompactSonar& sonar)
+{
+    return processOneSample(sonar);
+}
+
+template <typename Sample> bool Driver::processOneSample(Sample& sonar)
+{
+    waitForPacket();
+    return decodeLastPacket(sonar);
+}
+
+void Driver::waitForPacket()
+{
+    base::Time deadline = base::Time::now() + getReadTimeout();
+    while (true) {
+        keepAlive();
+        // Wake up for the keep-alive if it is due before the read timeout
+        base::Time keepalive_deadline = nextKeepaliveDeadline();
+        base::Time now = base::Time::now();
+        base::Time timeout = std::min(deadline, keepalive_deadline) - now;
+        try {
+            readNextPacket(std::max(timeout, base::Time()));
+            return;
+        }
+        catch (iodrivers_base::TimeoutError const&) {
+            now = base::Time::now();
+            if (now >= deadline || now < keepalive_deadline) {
+                throw;
+            }
+        }
+    }
+}
+
+size_t Driver::tryProcess(std::vector<base::samples::Sonar>& samples)
+{
+    return tryProcessSamples(samples);
+}
+
+size_t Driver::tryProcess(std::vector<CompactSonar>& samples)
+{
+    return tryProcessSamples(samples);
+}
+
+size_t Driver::processAvailable(std::vector<base::samples::Sonar>& samples)
+{
+    return processAvailableSamples(samples);
+}
+
+size_t Driver::processAvailable(std::vector<CompactSonar>& samples)
+{
+    return processAvailableSamples(samples);
+}
+
+template <typename Sample>
+size_t Driver::processAvailableSamples(std::vector<Sample>& samples)
+{
+    if (samples.empty()) {
+        samples.emplace_back();
+    }
+    waitForPacket();
+    size_t count = decodeLastPacketOrSkip(samples[0]) ? 1 : 0;
+    return drainSamples(samples, count);
+}
+
+template <typename Sample> size_t Driver::tryProcessSamples(std::vector<Sample>& samples)
+{
+    keepAlive();
+    return drainSamples(samples, 0);
+}
+
+template <typename Sample>
+size_t Driver::drainSamples(std::vector<Sample>& samples, size_t count)
+{
+    while (true) {
+        try {
+            readNextPacket(base::Time());
+        }
+        catch (iodrivers_base::TimeoutError const&) {
+            return count;
+        }
+        if (count == samples.size()) {
+            samples.emplace_back();
+        }
+        if (decodeLastPacketOrSkip(samples[count])) {
+            count++;
+        }
+    }
+}
+
+template <typename Sample> bool Driver::decodeLastPacketOrSkip(Sample& sonar)
+{
+    try {
+        return decodeLastPacket(sonar);
+    }
+    catch (std::runtime_error const&) {
+        // Already counted in decode_errors. The samples decoded so far in
+        // the batch are kept
+        return false;
+    }
+}
+
+static base::Time keepaliveDeadline(base::Time const& last_fire_time,
+    base::Time const& period);
+
+base::Time Driver::nextKeepaliveDeadline() const
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    return keepaliveDeadline(m_last_fire_time, m_keepalive_period);
+}
+
+void Driver::setKeepalivePeriod(base::Time const& period)
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    m_keepalive_period = period;
+}
+
+base::Time Driver::getKeepalivePeriod() const
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    return m_keepalive_period;
+}
+
+bool Driver::keepAlive()
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    base::Time deadline = keepaliveDeadline(m_last_fire_time, m_keepalive_period);
+    base::Time now = base::Time::now();
+    if (now < deadline) {
+        return false;
+    }
+
+    // Count the periods that elapsed entirely past the deadline
+    m_counters.keepalives_missed +=
+        (now - deadline).toMicroseconds() / m_keepalive_period.toMicroseconds();
+    m_counters.keepalives_sent++;
+    writeFireMessage();
+    return true;
+}
+
+KeepaliveStatistics Driver::getKeepaliveStatistics() const
+{
+    KeepaliveStatistics stats;
+    stats.fire_messages_sent = m_counters.fire_messages_sent;
+    stats.keepalives_sent = m_counters.keepalives_sent;
+    stats.keepalives_missed = m_counters.keepalives_missed;
+    stats.message_rebuilds = m_counters.message_rebuilds;
+    return stats;
+}
+
+base::Time keepaliveDeadline(base::Time const& last_fire_time, base::Time const& period)
+{
+    if (last_fire_time.isNull() || period.isNull()) {
+        return base::Time::max();
+    }
+    return last_fire_time + period;
+}
+
+void Driver::readNextPacket(base::Time const& timeout)
+{
+    // Release the previous packet first, so that the pool can hand the same
+    // buffer back unless somebody else still holds it
+    m_last_packet.reset();
+    m_last_packet = readPacketBuffer(timeout);
+}
+
+template <typename Sample> bool Driver::decodeLastPacket(Sample& sonar)
+{
+    return decodePacket(m_last_packet.data(),
+        m_last_packet.size(),
+        m_last_packet.receivedAt(),
+        sonar);
+}
+
+PacketBuffer Driver::readPacketBuffer(base::Time const& timeout)
+{
+    PacketBuffer packet = m_packet_pool.acquire();
+    base::Time start = base::Time::now();
+    int size = readPacket(packet.data(), packet.capacity(), timeout);
+    base::Time received_at = base::Time::now();
+    packet.resize(size);
+    packet.setReceivedAt(received_at);
+
+    OculusMessageHeader header;
+    memcpy(&header, packet.data(), sizeof(OculusMessageHeader));
+    m_counters.packetReceived(header.msgId, size);
+    m_counters.read.add(received_at - start);
+
+    std::lock_guard<std::mutex> lock(m_recorder_mutex);
+    if (m_recorder.isOpen()) {
+        m_recorder.write(packet.data(), size, received_at);
+    }
+    return packet;
+}
+
+void Driver::startRecording(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(m_recorder_mutex);
+    m_recorder.open(path);
+}
+
+void Driver::stopRecording()
+{
+    std::lock_guard<std::mutex> lock(m_recorder_mutex);
+    m_recorder.close();
+}
+
+bool Driver::isRecording() const
+{
+    std::lock_guard<std::mutex> lock(m_recorder_mutex);
+    return m_recorder.isOpen();
+}
+
+PacketBuffer Driver::getLastPacket() const
+{
+    return m_last_packet;
+}
+
+PacketPool& Driver::getPacketPool()
+{
+    return m_packet_pool;
+}
+
+bool Driver::decodePacket(uint8_t const* packet,
+    size_t size,
+    base::Time const& received_at,
+    base::samples::Sonar& sonar)
+{
+    return decodeSample(packet, size, received_at, sonar);
+}
+
+bool Driver::decodePacket(uint8_t const* packet,
+    size_t size,
+    base::Time const& received_at,
+    CompactSonar& sonar)
+{
+    return decodeSample(packet, size, received_at, sonar);
+}
+
+template <typename Sample>
+bool Driver::decodeSample(uint8_t const* packet,
+    size_t size,
+    base::Time const& received_at,
+    Sample& sonar)
+{
+    base::Time start = base::Time::now();
+    applyProtocolSettings();
+    try {
+        if (!m_protocol.handleBuffer(packet, size)) {
+            return false;
+        }
+        if (!updatePingGeneration(received_at)) {
+            m_counters.stale_pings++;
+            if (m_drop_stale_pings) {
+                m_counters.stale_pings_dropped++;
+                return false;
+            }
+        }
+        base::Time decoded = base::Time::now();
+        m_protocol.parseSonar(sonar, m_beam_width, m_beam_height);
+        base::Time converted = base::Time::now();
+
+        double ping_start_time = m_protocol.getPingStartTime();
+        if (base::isUnknown(ping_start_time)) {
+            sonar.time = received_at;
+        }
+        else {
+            std::lock_guard<std::mutex> lock(m_clock_mutex);
+            sonar.time = m_clock_estimator.update(ping_start_time, received_at);
+        }
+
+        m_counters.decode.add(decoded - start);
+        m_counters.transpose.add(converted - decoded);
+        m_counters.total.add(converted - received_at);
+    }
+    catch (std::runtime_error const&) {
+        m_counters.decode_errors++;
+        throw;
+    }
+
+    m_counters.pings_decoded++;
+    updatePingId(m_protocol.getPingId());
+    if (!m_first_ping_received) {
+        recordFirstPing(received_at);
+    }
+    return true;
+}
+
+void Driver::applyProtocolSettings()
+{
+    if (!m_settings_changed) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    m_protocol.setSpeedOfSound(m_settings.speed_of_sound);
+    m_protocol.setSalinity(m_settings.salinity);
+    m_protocol.setDecodeRegion(m_settings.region);
+    m_protocol.setGainCompensation(m_settings.gain_compensation);
+    m_protocol.setIntensityLUT(m_settings.intensity_lut);
+    m_settings_changed = false;
+}
+
+void Driver::recordFirstPing(base::Time const& received_at)
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    // Pings received before the sonar is fired come from a previous session
+    if (m_first_fire_time.isNull()) {
+        return;
+    }
+    m_time_to_first_ping = received_at - m_first_fire_time;
+    m_first_ping_received = true;
+}
+
+base::Time Driver::getTimeToFirstPing() const
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    return m_time_to_first_ping;
+}
+
+static bool isEchoOf(OculusSimpleFireMessage const& echo,
+    OculusSimpleFireMessage2 const& sent);
+
+bool Driver::updatePingGeneration(base::Time const& received_at)
+{
+    if (!m_configuration_pending) {
+        return true;
+    }
+
+    auto echo = m_protocol.getFireMessage();
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    if (echo && !isEchoOf(*echo, m_fire_message)) {
+        if (received_at - m_configuration_sent_at < m_configuration_timeout) {
+            return false;
+        }
+        // The firmware changed a value we compare, which would otherwise
+        // make every ping stale from now on
+        m_counters.configurations_assumed++;
+    }
+    else {
+        m_counters.configuration_apply.add(received_at - m_configuration_sent_at);
+    }
+    m_ping_generation = m_configuration_generation;
+    m_configuration_pending = false;
+    return true;
+}
+
+/** The flags that change how the image must be interpreted: range in meters,
+ * 16 bit samples and gain assist */
+static const uint8_t IMAGE_FLAGS = 0x01 | 0x02 | 0x10;
+/** Relative difference up to which an echoed range is the one sent */
+static const double RANGE_TOLERANCE = 1e-3;
+/** Difference, in percent, up to which an echoed gain is the one sent */
+static const double GAIN_TOLERANCE = 0.5;
+
+/**
+ * Whether an echoed value is the one sent, up to the tolerance. Values that
+ * were sent unknown are left to the firmware, and match anything
+ */
+static bool isClose(double echo, double sent, double tolerance)
+{
+    return base::isUnknown(sent) || std::abs(echo - sent) <= tolerance;
+}
+
+/**
+ * Whether the fire message echoed by a ping is the one that was sent
+ *
+ * Only the fields that change the image are compared. The ping and network
+ * rates do not affect how a ping must be interpreted, and the firmware
+ * reports the speed of sound it actually used in the ping itself
+ */
+bool isEchoOf(OculusSimpleFireMessage const& echo, OculusSimpleFireMessage2 const& sent)
+{
+    return echo.masterMode == sent.masterMode &&
+           (echo.flags & IMAGE_FLAGS) == (sent.flags & IMAGE_FLAGS) &&
+           echo.gammaCorrection == sent.gammaCorrection &&
+           isClose(echo.range, sent.range, RANGE_TOLERANCE * std::abs(sent.range)) &&
+           isClose(echo.gainPercent, sent.gainPercent, GAIN_TOLERANCE);
+}
+
+uint64_t Driver::getConfigurationGeneration() const
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    return m_configuration_generation;
+}
+
+uint64_t Driver::getPingGeneration() const
+{
+    return m_ping_generation;
+}
+
+void Driver::setConfigurationTimeout(base::Time const& timeout)
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    m_configuration_timeout = timeout;
+}
+
+base::Time Driver::getConfigurationTimeout() const
+{
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    return m_configuration_timeout;
+}
+
+void Driver::setDropStalePings(bool drop)
+{
+    m_drop_stale_pings = drop;
+}
+
+bool Driver::getDropStalePings() const
+{
+    return m_drop_stale_pings;
+}
+
+void Driver::updatePingId(std::optional<uint32_t> ping_id)
+{
+    if (!ping_id) {
+        return;
+    }
+    if (m_last_ping_id && *ping_id != *m_last_ping_id + 1) {
+        m_counters.ping_id_gaps++;
+        if (*ping_id > *m_last_ping_id) {
+            m_counters.pings_lost += *ping_id - *m_last_ping_id - 1;
+        }
+    }
+    m_last_ping_id = ping_id;
+}
+
+void Driver::setDecodeRegion(DecodeRegion const& region)
+{
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    m_settings.region = region;
+    m_settings_changed = true;
+}
+
+DecodeRegion Driver::getDecodeRegion() const
+{
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    return m_settings.region;
+}
+
+void Driver::setGainCompensation(GainCompensation const& compensation)
+{
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    m_settings.gain_compensation = compensation;
+    m_settings_changed = true;
+}
+
+GainCompensation Driver::getGainCompensation() const
+{
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    return m_settings.gain_compensation;
+}
+
+void Driver::setIntensityLUT(IntensityLUT const& lut)
+{
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    m_settings.intensity_lut = lut;
+    m_settings_changed = true;
+}
+
+IntensityLUT Driver::getIntensityLUT() const
+{
+    std::lock_guard<std::mutex> lock(m_settings_mutex);
+    return m_settings.intensity_lut;
+}
+
+ClockEstimatorStatistics Driver::getClockEstimatorStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_clock_mutex);
+    return m_clock_estimator.getStatistics();
+}
+
+static uint8_t setFlags(M750DConfiguration const& config);
+static OculusSimpleFireMessage2 buildFireMessage(M750DConfiguration const& config,
+    UpdateRate update_rate);
 
 void Driver::fireSonar(M750DConfiguration const& config, UpdateRate update_rate)
+{
+    {
+        // Before sending, so that the first ping made with the new
+        // configuration is interpreted with it
+        std::lock_guard<std::mutex> lock(m_settings_mutex);
+        if (!base::isUnknown(config.speed_of_sound)) {
+            m_settings.speed_of_sound = config.speed_of_sound;
+        }
+        m_settings.salinity = config.salinity;
+        m_settings_changed = true;
+    }
+
+    std::lock_guard<std::mutex> lock(m_fire_mutex);
+    bool changed = !m_has_fire_message || config != m_fire_configuration ||
+                   update_rate != m_fire_update_rate;
+    if (changed) {
+        m_fire_message = buildFireMessage(config, update_rate);
+        m_fire_configuration = config;
+        m_fire_update_rate = update_rate;
+        m_has_fire_message = true;
+        m_counters.message_rebuilds++;
+    }
+    m_counters.fire_messages_sent++;
+    writeFireMessage();
+    if (m_first_fire_time.isNull()) {
+        m_first_fire_time = m_last_fire_time;
+    }
+    if (changed) {
+        m_configuration_generation++;
+        m_configuration_sent_at = m_last_fire_time;
+        m_configuration_pending = true;
+    }
+}
+
+void Driver::writeFireMessage()
+{
+    writePacket(reinterpret_cast<uint8_t*>(&m_fire_message),
+        sizeof(OculusSimpleFireMessage));
+    m_last_fire_time = base::Time::now();
+}
+
+OculusSimpleFireMessage2 buildFireMessage(M750DConfiguration const& config,
+    UpdateRate update_rate)
 {
     OculusSimpleFireMessage2 simple_fire_message;
     memset(&simple_fire_message, 0, sizeof(OculusSimpleFireMessage));
@@ -63,7 +668,7 @@ void Driver::fireSonar(M750DConfiguration const& config, UpdateRate update_rate)
     simple_fire_message.head.srcDeviceId = 0;
     simple_fire_message.head.dstDeviceId = 0;
     simple_fire_message.head.oculusId = 0x4f53;
-    uint8_t flags = setFlags(config.gain_assist);
+    uint8_t flags = setFlags(config);
     simple_fire_message.pingRate = static_cast<PingRateType>(update_rate);
     simple_fire_message.flags = flags;
     simple_fire_message.gammaCorrection = config.gamma;
@@ -81,23 +686,28 @@ void Driver::fireSonar(M750DConfiguration const& config, UpdateRate update_rate)
         std::end(simple_fire_message.reserved1),
         0);
     simple_fire_message.beaconLocatorFrequency = 0;
-
-    writePacket(reinterpret_cast<uint8_t*>(&simple_fire_message),
-        sizeof(OculusSimpleFireMessage));
+    return simple_fire_message;
 }
 
-uint8_t setFlags(bool gain_assist)
+uint8_t setFlags(M750DConfiguration const& config)
 {
     // Range in metres
     uint8_t flags = 0x01;
 
-    if (gain_assist) {
+    if (config.data_16bit) {
+        // 16 bit image samples
+        flags |= 0x02;
+    }
+
+    if (config.gain_assist) {
         // Enable gain assist
         flags |= 0x10;
     }
 
-    // Oculus will output simple fire returns
-    flags |= 0x08;
+    if (!config.full_ping_result) {
+        // Oculus will output simple fire returns
+        flags |= 0x08;
+    }
 
     // Enable 512 beams
     flags |= 0x40;
@@ -1,11 +1,18 @@
 #ifndef SONAR_OCULUS_M750D_DRIVER_HPP
 #define SONAR_OCULUS_M750D_DRIVER_HPP
 
+#include <atomic>
 #include <base/samples/Sonar.hpp>
 #include <iodrivers_base/Driver.hpp>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <sonar_oculus_m750d/ClockEstimator.hpp>
+#include <sonar_oculus_m750d/CompactSonar.hpp>
+#include <sonar_oculus_m750d/DriverStatistics.hpp>
 #include <sonar_oculus_m750d/M750DConfiguration.hpp>
+#include <sonar_oculus_m750d/PacketLogWriter.hpp>
+#include <sonar_oculus_m750d/PacketPool.hpp>
 #include <sonar_oculus_m750d/Protocol.hpp>
 #include <sonar_oculus_m750d/UpdateRate.hpp>
 
@@ -14,19 +21,295 @@ namespace sonar_oculus_m750d {
 
     public:
         static const int INTERNAL_BUFFER_SIZE = 800000;
+        /**
+         * @brief Default interval between two fire messages when the sonar is
+         * kept alive
+         */
+        static const int DEFAULT_KEEPALIVE_PERIOD_MS = 1000;
+        /**
+         * @brief Default time after which a configuration no ping echoes is
+         * assumed to be applied anyway
+         */
+        static const int DEFAULT_CONFIGURATION_TIMEOUT_MS = 2000;
+
+        /**
+         * @param max_packet_size the size of the largest packet the driver
+         *   can receive. Packet buffers are allocated with this size, use
+         *   maxPacketSize to compute it from the expected ping size.
+         */
+        Driver(base::Angle const& beam_width,
+            base::Angle const& beam_height,
+            int max_packet_size = INTERNAL_BUFFER_SIZE);
+
+        /**
+         * @brief The size of the largest packet a ping of the given dimensions
+         * may generate
+         */
+        static int maxPacketSize(uint16_t beam_count,
+            uint16_t bin_count,
+            DataSizeType data_size = dataSize8Bit);
 
-        Driver(base::Angle const& beam_width, base::Angle const& beam_height);
         std::optional<base::samples::Sonar> processOne();
         /**
-         * @brief It calls a sonar reconfiguration
+         * @brief Read one packet and, if it is a ping, convert it into a
+         * caller-owned sample
+         *
+         * Unlike the optional-returning version, this reuses the memory already
+         * held by the sample. Once it has seen a ping of a given size, it does
+         * not allocate anymore.
          *
-         * This is also needed to keep the sonar alive
+         * When the sonar reports it, the sample is stamped with the time of
+         * the ping itself, mapped to the host clock by a ClockEstimator.
+         * Otherwise, it is stamped with the reception time.
          *
+         * While waiting for a packet, it re-sends the fire message when the
+         * keep-alive deadline passes.
+         *
+         * @return true if a ping was received and written in the sample
          */
-
+        bool processOne(base::samples::Sonar& sonar);
+        /**
+         * @brief Read one packet and, if it is a ping, convert it into a
+         * compact sample
+         *
+         * Same as processOne(base::samples::Sonar&), without widening the
+         * bins to floats. See CompactSonar
+         */
+        bool processOne(CompactSonar& sonar);
+        /**
+         * @brief Process the packets that are available without blocking
+         *
+         * This is meant for event loops: wait for getFileDescriptor() to be
+         * readable, or for nextKeepaliveDeadline(), then call tryProcess. It
+         * consumes every complete packet already received, and returns as
+         * soon as there is none left. It sends the keep-alive when it is due.
+         *
+         * The pings are written in the first elements of the given vector,
+         * whose memory is reused. The vector is grown when needed but never
+         * shrunk, use the return value rather than its size.
+         *
+         * A packet that fails to decode is skipped, and counted in
+         * DriverStatistics::decode_errors, so that one corrupt ping does not
+         * lose the others. Only the errors reading the device are thrown.
+         *
+         * @return the number of samples written in the vector
+         */
+        size_t tryProcess(std::vector<base::samples::Sonar>& samples);
+        /**
+         * @brief Process the packets that are available into compact samples
+         *
+         * See tryProcess(std::vector<base::samples::Sonar>&)
+         */
+        size_t tryProcess(std::vector<CompactSonar>& samples);
+        /**
+         * @brief Wait for data, then process everything that is available
+         *
+         * This blocks like processOne until a first packet arrives, then
+         * handles every complete packet already received without waiting
+         * further. Pings that arrive back to back, e.g. after a network stall,
+         * are therefore all returned by a single call.
+         *
+         * The samples are written, and the packets that fail to decode
+         * skipped, as with tryProcess.
+         *
+         * @return the number of samples written in the vector. It is zero if
+         *   the packets received were not pings
+         * @throw iodrivers_base::TimeoutError if nothing arrived within the
+         *   read timeout
+         */
+        size_t processAvailable(std::vector<base::samples::Sonar>& samples);
+        size_t processAvailable(std::vector<CompactSonar>& samples);
+        /**
+         * @brief The time at which the fire message is due again to keep the
+         * sonar alive
+         *
+         * It is base::Time::max() until fireSonar has been called once, or if
+         * the keep-alive is disabled
+         */
+        base::Time nextKeepaliveDeadline() const;
+        /**
+         * @brief Set the interval between two fire messages
+         *
+         * A null period disables the keep-alive
+         */
+        void setKeepalivePeriod(base::Time const& period);
+        base::Time getKeepalivePeriod() const;
+        /**
+         * @brief Re-send the last fire message if the keep-alive deadline has
+         * passed
+         *
+         * processOne, tryProcess and AcquisitionPipeline call this on their
+         * own. Event loops that do not read the device for long periods may
+         * call it when nextKeepaliveDeadline() is reached.
+         *
+         * @return true if the message was sent
+         */
+        bool keepAlive();
+        KeepaliveStatistics getKeepaliveStatistics() const;
+        /**
+         * @brief How much garbage was skipped in the stream
+         */
+        ResyncStatistics getResyncStatistics() const;
+        /**
+         * @brief Snapshot of all the driver instrumentation
+         *
+         * It is safe to call from any thread, including while an
+         * AcquisitionPipeline is running
+         */
+        DriverStatistics getStatistics() const;
+        /**
+         * @brief Reset the counters and latency histograms
+         *
+         * The time to first ping is measured again from the next fireSonar,
+         * e.g. after reconnecting to a sonar that was power-cycled. The clock
+         * estimation is not affected
+         */
+        void resetStatistics();
+        /**
+         * @brief Time from the first fireSonar to the first ping received
+         *
+         * Null until a ping was received after the sonar was fired
+         */
+        base::Time getTimeToFirstPing() const;
+        /**
+         * @brief Identifier of the configuration last sent by fireSonar
+         *
+         * It is incremented each time fireSonar is given a configuration or
+         * update rate different from the previous one. It is zero before
+         * the first fireSonar
+         */
+        uint64_t getConfigurationGeneration() const;
+        /**
+         * @brief The configuration generation the decoded pings are using
+         *
+         * Every ping echoes the fire message it was produced with. After a
+         * reconfiguration, this stays at the previous generation until a
+         * ping echoes the new configuration. After processOne or
+         * decodePacket, it is the generation of the sample just decoded.
+         *
+         * Only the echoed fields that change the image are compared: the
+         * mode, the range and gain up to the rounding of the firmware, the
+         * gamma and the range unit, data size and gain assist flags. The
+         * firmware may fill in the others (e.g. a default speed of sound)
+         *
+         * If no ping echoes the new configuration within the configuration
+         * timeout, e.g. because the firmware clamped the range, it is
+         * assumed to be applied anyway. This is counted in
+         * DriverStatistics::configurations_assumed
+         *
+         * Full ping results (messagePingResult) do not echo the fire message,
+         * and are assumed to use the configuration last sent
+         */
+        uint64_t getPingGeneration() const;
+        /**
+         * @brief Set how long after a reconfiguration the pings may go on
+         * echoing another configuration, see getPingGeneration
+         */
+        void setConfigurationTimeout(base::Time const& timeout);
+        base::Time getConfigurationTimeout() const;
+        /**
+         * @brief Whether pings that still use the previous configuration
+         * should be dropped without being converted
+         *
+         * Disabled by default. When enabled, processOne, tryProcess and
+         * decodePacket behave as if stale pings were not pings. They are
+         * counted in DriverStatistics either way
+         */
+        void setDropStalePings(bool drop);
+        bool getDropStalePings() const;
+        /**
+         * @brief Read one packet into a buffer from the driver's packet pool
+         *
+         * The buffer goes back to the pool once all copies of the returned
+         * handle are destroyed
+         *
+         * @throw iodrivers_base::TimeoutError if no packet arrived in time
+         */
+        PacketBuffer readPacketBuffer(base::Time const& timeout);
+        /**
+         * @brief The last packet read by processOne
+         *
+         * The protocol's ping view points into this buffer. Keeping the handle
+         * keeps the packet, without copying it.
+         */
+        PacketBuffer getLastPacket() const;
+        /**
+         * @brief The pool the packet buffers are taken from
+         */
+        PacketPool& getPacketPool();
+        /**
+         * @brief Record all the packets read from the device in a log
+         *
+         * The log can be read back with PacketLogReader
+         */
+        void startRecording(std::string const& path);
+        /**
+         * @brief Stop recording and write the log's index
+         */
+        void stopRecording();
+        bool isRecording() const;
+        /**
+         * @brief Decode a packet already read from the device
+         *
+         * This is the decoding half of processOne, for callers that do the
+         * reading themselves (e.g. AcquisitionPipeline). It does not touch the
+         * I/O state of the driver, and can therefore run in parallel with
+         * readPacket
+         *
+         * @param packet a complete packet, as returned by readPacket
+         * @param size the size of the packet
+         * @param received_at the time at which the packet was read
+         * @return true if the packet was a ping and was written in the sample
+         */
+        bool decodePacket(uint8_t const* packet,
+            size_t size,
+            base::Time const& received_at,
+            base::samples::Sonar& sonar);
+        /**
+         * @brief Decode a packet already read from the device into a compact
+         * sample
+         */
+        bool decodePacket(uint8_t const* packet,
+            size_t size,
+            base::Time const& received_at,
+            CompactSonar& sonar);
+        /**
+         * @brief Restrict the conversion to a part of the pings, and decimate
+         * it
+         *
+         * See Protocol::setDecodeRegion. Like the gain compensation and the
+         * intensity curve, it may be changed from any thread, and applies from
+         * the next packet decoded
+         */
+        void setDecodeRegion(DecodeRegion const& region);
+        DecodeRegion getDecodeRegion() const;
+        /**
+         * @brief Compensate the transmission loss while converting the pings
+         *
+         * See Protocol::setGainCompensation
+         */
+        void setGainCompensation(GainCompensation const& compensation);
+        GainCompensation getGainCompensation() const;
+        /**
+         * @brief Map the samples through an intensity curve while converting
+         * them
+         *
+         * See Protocol::setIntensityLUT
+         */
+        void setIntensityLUT(IntensityLUT const& lut);
+        IntensityLUT getIntensityLUT() const;
+        /**
+         * @brief The state of the device to host clock mapping
+         */
+        ClockEstimatorStatistics getClockEstimatorStatistics() const;
         /**
          * @brief It calls a sonar reconfiguration
          *
+         * The sonar stops pinging if it does not receive this message
+         * regularly. The driver keeps the message and re-sends it on its own
+         * (see keepAlive). The message is only rebuilt when the configuration
+         * or update rate change.
+         *
          * @param configuration The sonar paramenters
          * @param update_rate The sonar update rate
          */
@@ -34,11 +317,122 @@ namespace sonar_oculus_m750d {
         Protocol m_protocol;
 
     private:
+        /**
+         * @brief Extract a message from the stream
+         *
+         * On garbage, it skips straight to the next occurence of the message
+         * magic, instead of one byte at a time. Messages whose size is
+         * inconsistent with their content are skipped as garbage.
+         */
         virtual int extractPacket(uint8_t const* buffer, size_t buffer_size) const final;
-        uint8_t m_read_buffer[INTERNAL_BUFFER_SIZE];
-        uint8_t m_write_buffer[INTERNAL_BUFFER_SIZE];
+        int resync(size_t skip) const;
+        template <typename Sample> bool processOneSample(Sample& sonar);
+        template <typename Sample> size_t tryProcessSamples(std::vector<Sample>& samples);
+        template <typename Sample>
+        size_t processAvailableSamples(std::vector<Sample>& samples);
+        /** Process the packets available without waiting, writing the
+         * samples from the given index on */
+        template <typename Sample>
+        size_t drainSamples(std::vector<Sample>& samples, size_t count);
+        /** Read a packet into m_last_packet, sending the keep-alive while
+         * waiting for it, within the read timeout */
+        void waitForPacket();
+        /** Read a packet into m_last_packet */
+        void readNextPacket(base::Time const& timeout);
+        template <typename Sample> bool decodeLastPacket(Sample& sonar);
+        /** Decode m_last_packet, returning false instead of throwing if it
+         * fails to decode */
+        template <typename Sample> bool decodeLastPacketOrSkip(Sample& sonar);
+        template <typename Sample>
+        bool decodeSample(uint8_t const* packet,
+            size_t size,
+            base::Time const& received_at,
+            Sample& sonar);
+        PacketPool m_packet_pool;
+        PacketBuffer m_last_packet;
+
+        /** Protects the recorder, which may be started and stopped while
+         * another thread reads */
+        mutable std::mutex m_recorder_mutex;
+        PacketLogWriter m_recorder;
         base::Angle m_beam_width;
         base::Angle m_beam_height;
+        void updatePingId(std::optional<uint32_t> ping_id);
+
+        /** Protects the clock estimator, whose statistics may be read from
+         * other threads */
+        mutable std::mutex m_clock_mutex;
+        ClockEstimator m_clock_estimator;
+
+        void writeFireMessage();
+
+        /** Protects the fire message and keep-alive state, which is accessed
+         * from both the reading and the commanding threads */
+        mutable std::mutex m_fire_mutex;
+        OculusSimpleFireMessage2 m_fire_message;
+        bool m_has_fire_message = false;
+        M750DConfiguration m_fire_configuration;
+        UpdateRate m_fire_update_rate = UPDATE_10HZ_MAX;
+        base::Time m_keepalive_period =
+            base::Time::fromMilliseconds(DEFAULT_KEEPALIVE_PERIOD_MS);
+        base::Time m_last_fire_time;
+        base::Time m_first_fire_time;
+        base::Time m_time_to_first_ping;
+        /** Set once the time to first ping is known, so that decoding does
+         * not take m_fire_mutex afterwards */
+        std::atomic<bool> m_first_ping_received{false};
+        void recordFirstPing(base::Time const& received_at);
+
+        uint64_t m_configuration_generation = 0;
+        /** When the configuration of m_configuration_generation was sent */
+        base::Time m_configuration_sent_at;
+        base::Time m_configuration_timeout =
+            base::Time::fromMilliseconds(DEFAULT_CONFIGURATION_TIMEOUT_MS);
+        /** Set from fireSonar until a ping echoes the new configuration, so
+         * that decoding only takes m_fire_mutex while a change is pending */
+        std::atomic<bool> m_configuration_pending{false};
+        std::atomic<uint64_t> m_ping_generation{0};
+        std::atomic<bool> m_drop_stale_pings{false};
+        /**
+         * @brief Compare the last ping's echoed fire message with the last
+         * configuration sent, and update the ping generation
+         *
+         * The configuration is accepted without a matching echo once the
+         * configuration timeout expired
+         *
+         * @return false if the ping is stale
+         */
+        bool updatePingGeneration(base::Time const& received_at);
+
+        /**
+         * @brief Protocol settings, written by the commanding threads and
+         * applied to m_protocol by the decoding thread
+         */
+        struct ProtocolSettings {
+            double speed_of_sound = Protocol::DEFAULT_SPEED_OF_SOUND;
+            double salinity = base::unknown<double>();
+            DecodeRegion region;
+            GainCompensation gain_compensation;
+            IntensityLUT intensity_lut;
+        };
+        /** Protects m_settings, which may be changed while another thread
+         * decodes */
+        mutable std::mutex m_settings_mutex;
+        ProtocolSettings m_settings;
+        /** Set when m_settings changed, so that decoding only takes
+         * m_settings_mutex when there is something to apply */
+        std::atomic<bool> m_settings_changed{false};
+        /**
+         * @brief Apply the pending settings changes to m_protocol
+         *
+         * Called by the decoding thread before each packet
+         */
+        void applyProtocolSettings();
+
+        /** Mutable as extractPacket, which is const, updates it */
+        mutable DriverCounters m_counters;
+        /** The ID of the last ping, to detect lost pings */
+        std::optional<uint32_t> m_last_ping_id;
     };
 }
 
@@ -0,0 +1,173 @@
+#include "DriverStatistics.hpp"
+#include "Oculus.h"
+#include <algorithm>
+
+using namespace sonar_oculus_m750d;
+
+base::Time LatencyHistogram::bucketUpperBound(int bucket)
+{
+    if (bucket >= BUCKET_COUNT - 1) {
+        return base::Time::max();
+    }
+    return base::Time::fromMicroseconds(int64_t(1) << bucket);
+}
+
+int LatencyHistogram::bucketOf(base::Time const& latency)
+{
+    int64_t us = latency.toMicroseconds();
+    if (us <= 0) {
+        return 0;
+    }
+    // Number of significant bits, i.e. the smallest i such that us < 2^i
+    int bucket = 64 - __builtin_clzll(static_cast<uint64_t>(us));
+    return std::min(bucket, BUCKET_COUNT - 1);
+}
+
+base::Time LatencyHistogram::mean() const
+{
+    if (count == 0) {
+        return base::Time();
+    }
+    return base::Time::fromMicroseconds(total.toMicroseconds() / static_cast<int64_t>(count));
+}
+
+base::Time LatencyHistogram::quantile(double quantile) const
+{
+    if (count == 0) {
+        return base::Time();
+    }
+    uint64_t rank = std::max<uint64_t>(1, quantile * count + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+void AtomicLatencyHistogram::add(base::Time const& latency)
+{
+    int64_t us = latency.toMicroseconds();
+    m_buckets[LatencyHistogram::bucketOf(latency)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(us, std::memory_order_relaxed);
+
+    int64_t max = m_max.load(std::memory_order_relaxed);
+    while (us > max &&
+           !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram AtomicLatencyHistogram::snapshot() const
+{
+    LatencyHistogram histogram;
+    for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        histogram.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    histogram.count = m_count.load(std::memory_order_relaxed);
+    histogram.total = base::Time::fromMicroseconds(m_total.load(std::memory_order_relaxed));
+    histogram.max = base::Time::fromMicroseconds(m_max.load(std::memory_order_relaxed));
+    return histogram;
+}
+
+void AtomicLatencyHistogram::reset()
+{
+    for (auto& bucket : m_buckets) {
+        bucket = 0;
+    }
+    m_count = 0;
+    m_total = 0;
+    m_max = 0;
+}
+
+static bool isKnownMessage(uint16_t msg_id)
+{
+    switch (msg_id) {
+        case messageSimpleFire:
+        case messagePingResult:
+        case messageSimplePingResult:
+        case messageUserConfig:
+        case messageDummy:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void DriverCounters::packetReceived(uint16_t msg_id, size_t size)
+{
+    packets_received.fetch_add(1, std::memory_order_relaxed);
+    bytes_received.fetch_add(size, std::memory_order_relaxed);
+    if (msg_id < 256) {
+        packets_by_msg_id[msg_id].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!isKnownMessage(msg_id)) {
+        unknown_messages.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void DriverCounters::snapshot(DriverStatistics& statistics) const
+{
+    statistics.packets_received = packets_received;
+    statistics.bytes_received = bytes_received;
+    for (int i = 0; i < 256; i++) {
+        statistics.packets_by_msg_id[i] = packets_by_msg_id[i];
+    }
+    statistics.unknown_messages = unknown_messages;
+    statistics.pings_decoded = pings_decoded;
+    statistics.decode_errors = decode_errors;
+    statistics.ping_id_gaps = ping_id_gaps;
+    statistics.pings_lost = pings_lost;
+    statistics.stale_pings = stale_pings;
+    statistics.stale_pings_dropped = stale_pings_dropped;
+    statistics.configurations_assumed = configurations_assumed;
+
+    statistics.read = read.snapshot();
+    statistics.decode = decode.snapshot();
+    statistics.transpose = transpose.snapshot();
+    statistics.total = total.snapshot();
+    statistics.configuration_apply = configuration_apply.snapshot();
+
+    statistics.keepalive.fire_messages_sent = fire_messages_sent;
+    statistics.keepalive.keepalives_sent = keepalives_sent;
+    statistics.keepalive.keepalives_missed = keepalives_missed;
+    statistics.keepalive.message_rebuilds = message_rebuilds;
+
+    statistics.resync.resync_events = resync_events;
+    statistics.resync.bytes_skipped = bytes_skipped;
+    statistics.resync.rejected_packets = rejected_packets;
+}
+
+void DriverCounters::reset()
+{
+    packets_received = 0;
+    bytes_received = 0;
+    for (auto& counter : packets_by_msg_id) {
+        counter = 0;
+    }
+    unknown_messages = 0;
+    pings_decoded = 0;
+    decode_errors = 0;
+    ping_id_gaps = 0;
+    pings_lost = 0;
+    stale_pings = 0;
+    stale_pings_dropped = 0;
+    configurations_assumed = 0;
+
+    read.reset();
+    decode.reset();
+    transpose.reset();
+    total.reset();
+    configuration_apply.reset();
+
+    fire_messages_sent = 0;
+    keepalives_sent = 0;
+    keepalives_missed = 0;
+    message_rebuilds = 0;
+
+    resync_events = 0;
+    bytes_skipped = 0;
+    rejected_packets = 0;
+}
@@ -0,0 +1,193 @@
+#ifndef SONAR_OCULUS_M750D_DRIVERSTATISTICS_HPP
+#define SONAR_OCULUS_M750D_DRIVERSTATISTICS_HPP
+
+#include <atomic>
+#include <base/Time.hpp>
+#include <cstdint>
+#include <sonar_oculus_m750d/ClockEstimator.hpp>
+
+namespace sonar_oculus_m750d {
+    struct KeepaliveStatistics {
+        /** Fire messages sent by fireSonar */
+        uint64_t fire_messages_sent = 0;
+        /** Fire messages re-sent automatically to keep the sonar alive */
+        uint64_t keepalives_sent = 0;
+        /**
+         * Keep-alive periods that elapsed without a fire message being sent,
+         * because the driver was not given a chance to send it in time
+         */
+        uint64_t keepalives_missed = 0;
+        /** Times the fire message had to be rebuilt from the configuration */
+        uint64_t message_rebuilds = 0;
+    };
+
+    struct ResyncStatistics {
+        /** Times the driver had to skip bytes to find the next message */
+        uint64_t resync_events = 0;
+        /** Bytes skipped while resynchronizing */
+        uint64_t bytes_skipped = 0;
+        /**
+         * Messages dropped because their header or content were
+         * inconsistent, although they started with the right magic
+         */
+        uint64_t rejected_packets = 0;
+    };
+
+    /**
+     * @brief Latency distribution with fixed, power of two buckets
+     *
+     * Bucket i counts the latencies below 2^i microseconds that did not fall
+     * in the previous buckets. The last bucket counts everything above.
+     */
+    struct LatencyHistogram {
+        static const int BUCKET_COUNT = 24;
+
+        uint64_t buckets[BUCKET_COUNT] = {};
+        uint64_t count = 0;
+        base::Time total;
+        base::Time max;
+
+        /**
+         * @brief The (exclusive) upper bound of a bucket
+         *
+         * It is base::Time::max() for the last bucket
+         */
+        static base::Time bucketUpperBound(int bucket);
+        /**
+         * @brief The bucket a latency falls in
+         */
+        static int bucketOf(base::Time const& latency);
+
+        base::Time mean() const;
+        /**
+         * @brief An upper bound of the given quantile, with the resolution
+         * of the buckets
+         *
+         * @param quantile between 0 and 1
+         */
+        base::Time quantile(double quantile) const;
+    };
+
+    /**
+     * @brief Snapshot of the driver instrumentation
+     */
+    struct DriverStatistics {
+        /** The time at which the snapshot was taken */
+        base::Time time;
+
+        /** Packets read from the device, whatever their type */
+        uint64_t packets_received = 0;
+        /** Bytes in the packets read from the device */
+        uint64_t bytes_received = 0;
+        /** Packets received, indexed by message ID */
+        uint64_t packets_by_msg_id[256] = {};
+        /** Packets whose message ID is not one of OculusMessageType */
+        uint64_t unknown_messages = 0;
+        /** Pings converted into samples */
+        uint64_t pings_decoded = 0;
+        /** Pings that could not be decoded */
+        uint64_t decode_errors = 0;
+        /** Times the ping ID did not follow the previous one */
+        uint64_t ping_id_gaps = 0;
+        /** Pings missing according to the ping IDs */
+        uint64_t pings_lost = 0;
+        /** From the first fire message to the first ping, null until then */
+        base::Time time_to_first_ping;
+        /**
+         * Pings whose echoed fire message did not match the configuration
+         * last sent, i.e. that were still using the previous configuration
+         */
+        uint64_t stale_pings = 0;
+        /** Stale pings that were not decoded, see Driver::setDropStalePings */
+        uint64_t stale_pings_dropped = 0;
+        /**
+         * Configurations no ping echoed within the configuration timeout, and
+         * that were assumed to be applied, see Driver::getPingGeneration
+         */
+        uint64_t configurations_assumed = 0;
+
+        /** Time spent in readPacket, including the wait for data */
+        LatencyHistogram read;
+        /** Parsing of the ping message */
+        LatencyHistogram decode;
+        /** Conversion of the image into the sample */
+        LatencyHistogram transpose;
+        /** From the reception of the packet to the sample being ready */
+        LatencyHistogram total;
+        /**
+         * From the fireSonar that changed the configuration to the reception
+         * of the first ping using it
+         */
+        LatencyHistogram configuration_apply;
+
+        KeepaliveStatistics keepalive;
+        ResyncStatistics resync;
+        ClockEstimatorStatistics clock;
+    };
+
+    /**
+     * @brief Lock-free accumulation of a LatencyHistogram
+     */
+    class AtomicLatencyHistogram {
+    public:
+        void add(base::Time const& latency);
+        LatencyHistogram snapshot() const;
+        void reset();
+
+    private:
+        std::atomic<uint64_t> m_buckets[LatencyHistogram::BUCKET_COUNT] = {};
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<int64_t> m_total{0};
+        std::atomic<int64_t> m_max{0};
+    };
+
+    /**
+     * @brief The counters behind DriverStatistics
+     *
+     * They are atomics so that they can be updated from the reading and
+     * decoding threads while being read from another one
+     */
+    struct DriverCounters {
+        std::atomic<uint64_t> packets_received{0};
+        std::atomic<uint64_t> bytes_received{0};
+        std::atomic<uint64_t> packets_by_msg_id[256] = {};
+        std::atomic<uint64_t> unknown_messages{0};
+        std::atomic<uint64_t> pings_decoded{0};
+        std::atomic<uint64_t> decode_errors{0};
+        std::atomic<uint64_t> ping_id_gaps{0};
+        std::atomic<uint64_t> pings_lost{0};
+        std::atomic<uint64_t> stale_pings{0};
+        std::atomic<uint64_t> stale_pings_dropped{0};
+        std::atomic<uint64_t> configurations_assumed{0};
+
+        AtomicLatencyHistogram read;
+        AtomicLatencyHistogram decode;
+        AtomicLatencyHistogram transpose;
+        AtomicLatencyHistogram total;
+        AtomicLatencyHistogram configuration_apply;
+
+        std::atomic<uint64_t> fire_messages_sent{0};
+        std::atomic<uint64_t> keepalives_sent{0};
+        std::atomic<uint64_t> keepalives_missed{0};
+        std::atomic<uint64_t> message_rebuilds{0};
+
+        std::atomic<uint64_t> resync_events{0};
+        std::atomic<uint64_t> bytes_skipped{0};
+        std::atomic<uint64_t> rejected_packets{0};
+
+        /**
+         * @brief Count a packet read from the device
+         */
+        void packetReceived(uint16_t msg_id, size_t size);
+
+        /**
+         * @brief Fill the counters of a statistics snapshot
+         *
+         * The clock statistics are left untouched, they are not counters
+         */
+        void snapshot(DriverStatistics& statistics) const;
+        void reset();
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_DRIVERSTATISTICS_HPP
@@ -0,0 +1,251 @@
+#include "FanImageRenderer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+using namespace sonar_oculus_m750d;
+
+FanImageRenderer::FanImageRenderer(uint32_t width, uint32_t height)
+    : m_width(width)
+    , m_height(height)
+{
+    if (width == 0 || height == 0) {
+        throw std::invalid_argument("FanImageRenderer: the image size cannot be zero");
+    }
+}
+
+void FanImageRenderer::setThreadCount(uint32_t count)
+{
+    m_thread_count = std::max<uint32_t>(1, count);
+}
+
+uint32_t FanImageRenderer::getThreadCount() const
+{
+    return m_thread_count;
+}
+
+uint32_t FanImageRenderer::getWidth() const
+{
+    return m_width;
+}
+
+uint32_t FanImageRenderer::getHeight() const
+{
+    return m_height;
+}
+
+double FanImageRenderer::getMetersPerPixel() const
+{
+    return m_meters_per_pixel;
+}
+
+uint64_t FanImageRenderer::getTableBuilds() const
+{
+    return m_table_builds;
+}
+
+double FanImageRenderer::sampleRange(base::samples::Sonar const& sonar)
+{
+    return sonar.bin_count * sonar.bin_duration.toSeconds() * sonar.speed_of_sound;
+}
+
+void FanImageRenderer::render(base::samples::Sonar const& sonar,
+    std::vector<uint8_t>& image)
+{
+    renderWith(sonar, image, [](float value) {
+        return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255 + 0.5f);
+    });
+}
+
+void FanImageRenderer::render(base::samples::Sonar const& sonar, std::vector<float>& image)
+{
+    renderWith(sonar, image, [](float value) { return value; });
+}
+
+template <typename Pixel, typename Convert>
+void FanImageRenderer::renderWith(base::samples::Sonar const& sonar,
+    std::vector<Pixel>& image,
+    Convert convert)
+{
+    if (sonar.bins.size() != static_cast<size_t>(sonar.beam_count) * sonar.bin_count ||
+        sonar.bearings.size() != sonar.beam_count) {
+        throw std::invalid_argument(
+            "FanImageRenderer: inconsistent bins, bearings and beam/bin counts");
+    }
+    updateTable(sonar);
+
+    image.resize(static_cast<size_t>(m_width) * m_height);
+    std::fill(image.begin(), image.end(), Pixel());
+
+    float const* bins = sonar.bins.data();
+    uint32_t bin_step = m_bin_step;
+    uint32_t beam_step = m_beam_step;
+    uint32_t const* pixels = m_pixels.data();
+    uint32_t const* offsets = m_offsets.data();
+    float const* beam_weights = m_beam_weights.data();
+    float const* bin_weights = m_bin_weights.data();
+    Pixel* out = image.data();
+
+    auto gather = [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float const* near_beam = bins + offsets[i];
+            float const* far_beam = near_beam + beam_step;
+            float wr = bin_weights[i];
+            float wb = beam_weights[i];
+            float a = near_beam[0] + wr * (near_beam[bin_step] - near_beam[0]);
+            float b = far_beam[0] + wr * (far_beam[bin_step] - far_beam[0]);
+            out[pixels[i]] = convert(a + wb * (b - a));
+        }
+    };
+
+    size_t count = m_pixels.size();
+    if (m_thread_count == 1) {
+        gather(0, count);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(m_thread_count - 1);
+    size_t chunk = (count + m_thread_count - 1) / m_thread_count;
+    for (uint32_t t = 1; t < m_thread_count; t++) {
+        size_t begin = std::min(count, t * chunk);
+        size_t end = std::min(count, begin + chunk);
+        threads.emplace_back(gather, begin, end);
+    }
+    gather(0, std::min(count, chunk));
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void FanImageRenderer::updateTable(base::samples::Sonar const& sonar)
+{
+    double range = sampleRange(sonar);
+    if (m_has_table && m_bin_count == sonar.bin_count && m_range == range &&
+        m_bearings == sonar.bearings) {
+        return;
+    }
+    buildTable(sonar);
+    m_bearings = sonar.bearings;
+    m_bin_count = sonar.bin_count;
+    m_range = range;
+    m_has_table = true;
+    m_table_builds++;
+}
+
+static bool fractionalBeam(std::vector<std::pair<double, uint32_t>> const& sorted,
+    double bearing,
+    uint32_t& near_beam,
+    float& weight);
+
+void FanImageRenderer::buildTable(base::samples::Sonar const& sonar)
+{
+    m_pixels.clear();
+    m_offsets.clear();
+    m_beam_weights.clear();
+    m_bin_weights.clear();
+
+    uint32_t bin_count = sonar.bin_count;
+    uint32_t beam_count = sonar.beam_count;
+    double range = sampleRange(sonar);
+    if (beam_count == 0 || bin_count == 0 || !(range > 0)) {
+        m_meters_per_pixel = 0;
+        return;
+    }
+    // Without a next bin or beam, the gather reads the same one twice, so
+    // that it never reads past the sample
+    m_bin_step = bin_count > 1 ? 1 : 0;
+    m_beam_step = beam_count > 1 ? bin_count : 0;
+
+    std::vector<std::pair<double, uint32_t>> sorted(beam_count);
+    for (uint32_t i = 0; i < beam_count; i++) {
+        sorted[i] = std::make_pair(sonar.bearings[i].getRad(), i);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    // Fit the fan: full range vertically, widest bearing horizontally.
+    // Bearings are counter-clockwise, i.e. positive to the left
+    double half_width = range * std::max(std::sin(std::fabs(sorted.front().first)),
+                                    std::sin(std::fabs(sorted.back().first)));
+    m_meters_per_pixel = std::max(range / m_height, 2 * half_width / m_width);
+
+    double bin_size = range / bin_count;
+    for (uint32_t v = 0; v < m_height; v++) {
+        double forward = (m_height - v - 0.5) * m_meters_per_pixel;
+        for (uint32_t u = 0; u < m_width; u++) {
+            double right = (u + 0.5 - m_width / 2.0) * m_meters_per_pixel;
+            double distance = std::hypot(forward, right);
+            if (distance >= range) {
+                continue;
+            }
+
+            uint32_t beam;
+            float beam_weight;
+            if (!fractionalBeam(sorted, std::atan2(-right, forward), beam, beam_weight)) {
+                continue;
+            }
+            if (beam + 1 >= beam_count) {
+                // Last beam, interpolate with itself
+                beam = beam_count > 1 ? beam_count - 2 : 0;
+                beam_weight = beam_count > 1 ? 1 : 0;
+            }
+
+            // Bin centers are at (bin + 0.5) * bin_size
+            double bin_position =
+                std::min(std::max(distance / bin_size - 0.5, 0.0), bin_count - 1.0);
+            uint32_t bin = std::min<uint32_t>(bin_position, bin_count > 1 ? bin_count - 2 : 0);
+            float bin_weight = bin_count > 1 ? bin_position - bin : 0;
+
+            m_pixels.push_back(v * m_width + u);
+            m_offsets.push_back(beam * bin_count + bin);
+            m_beam_weights.push_back(beam_weight);
+            m_bin_weights.push_back(bin_weight);
+        }
+    }
+}
+
+/**
+ * Find the fractional beam index of a bearing, given the bearings sorted in
+ * increasing order along with their original indexes
+ *
+ * @return false if the bearing is outside of the fan
+ */
+bool fractionalBeam(std::vector<std::pair<double, uint32_t>> const& sorted,
+    double bearing,
+    uint32_t& near_beam,
+    float& weight)
+{
+    if (sorted.size() == 1) {
+        near_beam = sorted[0].second;
+        weight = 0;
+        return bearing == sorted[0].first;
+    }
+    if (bearing < sorted.front().first || bearing > sorted.back().first) {
+        return false;
+    }
+
+    auto upper = std::upper_bound(sorted.begin(),
+        sorted.end(),
+        bearing,
+        [](double value, std::pair<double, uint32_t> const& entry) {
+            return value < entry.first;
+        });
+    if (upper == sorted.end()) {
+        --upper;
+    }
+    auto lower = upper - 1;
+    double span = upper->first - lower->first;
+    double t = span > 0 ? (bearing - lower->first) / span : 0;
+
+    // Interpolation goes from beam i to beam i + 1 in the sample, whatever
+    // the order of the bearings
+    if (upper->second == lower->second + 1) {
+        near_beam = lower->second;
+        weight = t;
+    }
+    else {
+        near_beam = upper->second;
+        weight = 1 - t;
+    }
+    return true;
+}
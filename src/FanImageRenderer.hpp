@@ -0,0 +1,107 @@
+#ifndef SONAR_OCULUS_M750D_FANIMAGERENDERER_HPP
+#define SONAR_OCULUS_M750D_FANIMAGERENDERER_HPP
+
+#include <base/samples/Sonar.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief Projects sonar samples into a Cartesian (fan) image
+     *
+     * The sonar is at the middle of the bottom edge of the image, looking up.
+     * The scale is the largest that fits the whole fan in the image, see
+     * getMetersPerPixel. Pixels outside of the fan are set to zero.
+     *
+     * The mapping from pixels to (beam, bin) pairs and their bilinear
+     * interpolation weights is computed once, and kept as long as the
+     * bearings, bin count, range and image size do not change. Rendering a
+     * frame is then a gather over this table.
+     */
+    class FanImageRenderer {
+    public:
+        FanImageRenderer(uint32_t width, uint32_t height);
+
+        /**
+         * @brief Split the rendering among this many threads
+         *
+         * The default of 1 renders in the calling thread. Otherwise, render
+         * starts count - 1 threads and joins them on every frame. This costs
+         * in the order of tens of microseconds per thread, which only pays
+         * off on large images
+         */
+        void setThreadCount(uint32_t count);
+        uint32_t getThreadCount() const;
+
+        uint32_t getWidth() const;
+        uint32_t getHeight() const;
+
+        /**
+         * @brief Render a sample as bytes
+         *
+         * The bins are expected between 0 and 1, as output by the driver, and
+         * are mapped to 0-255
+         *
+         * @param image the row-major output image, resized to width * height
+         */
+        void render(base::samples::Sonar const& sonar, std::vector<uint8_t>& image);
+        /**
+         * @brief Render a sample as floats, with the values of the bins
+         *
+         * @param image the row-major output image, resized to width * height
+         */
+        void render(base::samples::Sonar const& sonar, std::vector<float>& image);
+
+        /**
+         * @brief The size of a pixel for the last rendered sample, in meters
+         */
+        double getMetersPerPixel() const;
+        /**
+         * @brief How many times the lookup table was computed
+         */
+        uint64_t getTableBuilds() const;
+
+        /**
+         * @brief The range of a sample, in meters
+         *
+         * The bin duration is a one-way travel time, as computed by
+         * Protocol::binDuration
+         */
+        static double sampleRange(base::samples::Sonar const& sonar);
+
+    private:
+        void updateTable(base::samples::Sonar const& sonar);
+        void buildTable(base::samples::Sonar const& sonar);
+        template <typename Pixel, typename Convert>
+        void renderWith(base::samples::Sonar const& sonar,
+            std::vector<Pixel>& image,
+            Convert convert);
+
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_thread_count = 1;
+
+        /** The parameters the table was built for */
+        std::vector<base::Angle> m_bearings;
+        uint32_t m_bin_count = 0;
+        double m_range = 0;
+        bool m_has_table = false;
+        double m_meters_per_pixel = 0;
+        uint64_t m_table_builds = 0;
+
+        /**
+         * The table, one entry per pixel inside the fan, in pixel order.
+         * Entry i interpolates between the bins at m_offsets[i] and
+         * m_offsets[i] + m_bin_step of beams m_offsets[i] / bin_count and
+         * the next one, m_beam_step further
+         */
+        uint32_t m_bin_step = 0;
+        uint32_t m_beam_step = 0;
+        std::vector<uint32_t> m_pixels;
+        std::vector<uint32_t> m_offsets;
+        std::vector<float> m_beam_weights;
+        std::vector<float> m_bin_weights;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_FANIMAGERENDERER_HPP
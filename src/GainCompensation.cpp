@@ -0,0 +1,98 @@
+#include "GainCompensation.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace sonar_oculus_m750d;
+
+/** Salinity assumed when the pings do not report it, in ppt */
+static const double DEFAULT_SALINITY = 35;
+
+static bool isSameValue(double a, double b)
+{
+    return a == b || (base::isUnknown(a) && base::isUnknown(b));
+}
+
+double GainCompensation::absorptionCoefficient(double frequency,
+    double salinity,
+    double temperature)
+{
+    // The formula uses kHz and gives dB/km
+    double f = frequency / 1e3;
+    double f2 = f * f;
+    // Relaxation frequencies of boric acid and magnesium sulphate
+    double f_boric = 0.78 * std::sqrt(salinity / 35) * std::exp(temperature / 26);
+    double f_magnesium = 42 * std::exp(temperature / 17);
+    double boric = 0.106 * f_boric * f2 / (f_boric * f_boric + f2);
+    double magnesium = 0.52 * (1 + temperature / 43) * (salinity / 35) * f_magnesium *
+                       f2 / (f_magnesium * f_magnesium + f2);
+    double water = 0.00049 * f2 * std::exp(-temperature / 27);
+    return (boric + magnesium + water) / 1e3;
+}
+
+void GainCompensation::computeGains(std::vector<float>& gains,
+    double range_resolution,
+    uint16_t bin_count,
+    double frequency,
+    double salinity) const
+{
+    double alpha = absorption;
+    if (base::isUnknown(alpha)) {
+        if (base::isUnknown(frequency)) {
+            alpha = 0;
+        }
+        else {
+            alpha = absorptionCoefficient(frequency,
+                base::isUnknown(salinity) ? DEFAULT_SALINITY : salinity,
+                temperature);
+        }
+    }
+
+    gains.resize(bin_count);
+    for (uint16_t i = 0; i < bin_count; i++) {
+        double range = std::max((i + 0.5) * range_resolution, reference_range);
+        double gain = spreading * std::log10(range / reference_range) +
+                      2 * alpha * (range - reference_range);
+        gains[i] = std::pow(10, std::min(gain, max_gain) / 20);
+    }
+}
+
+bool GainCompensation::operator==(GainCompensation const& other) const
+{
+    return enabled == other.enabled && spreading == other.spreading &&
+           isSameValue(absorption, other.absorption) &&
+           temperature == other.temperature &&
+           reference_range == other.reference_range && max_gain == other.max_gain;
+}
+
+bool GainCompensation::operator!=(GainCompensation const& other) const
+{
+    return !(*this == other);
+}
+
+float const* GainTable::get(GainCompensation const& compensation,
+    double range_resolution,
+    uint16_t bin_count,
+    double frequency,
+    double salinity)
+{
+    if (m_table_builds == 0 || compensation != m_compensation ||
+        bin_count != m_gains.size() || range_resolution != m_range_resolution ||
+        !isSameValue(frequency, m_frequency) || !isSameValue(salinity, m_salinity)) {
+        compensation.computeGains(m_gains,
+            range_resolution,
+            bin_count,
+            frequency,
+            salinity);
+        m_compensation = compensation;
+        m_range_resolution = range_resolution;
+        m_frequency = frequency;
+        m_salinity = salinity;
+        m_table_builds++;
+    }
+    return m_gains.data();
+}
+
+uint64_t GainTable::getTableBuilds() const
+{
+    return m_table_builds;
+}
@@ -0,0 +1,119 @@
+#ifndef SONAR_OCULUS_M750D_GAINCOMPENSATION_HPP
+#define SONAR_OCULUS_M750D_GAINCOMPENSATION_HPP
+
+#include <base/Float.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief Range-dependent gain (TVG) that compensates the transmission loss
+     *
+     * The gain at range r, in dB, is
+     *
+     *   spreading * log10(r / reference_range) + 2 * absorption * (r - reference_range)
+     *
+     * i.e. the two-way transmission loss relative to the reference range. It
+     * is applied to the bins as an amplitude factor, 10^(gain / 20). Bins
+     * closer than the reference range are left untouched.
+     *
+     * The default is disabled
+     */
+    struct GainCompensation {
+        bool enabled = false;
+        /**
+         * @brief The spreading loss coefficient, 40 for the two-way spherical
+         * spreading of a point target, 30 for the backscatter of an area
+         */
+        double spreading = 40;
+        /**
+         * @brief One-way absorption in dB/m
+         *
+         * Leave unknown to compute it from the frequency and salinity of the
+         * pings, see absorptionCoefficient
+         */
+        double absorption = base::unknown<double>();
+        /**
+         * @brief The water temperature in degrees Celsius, used to compute
+         * the absorption
+         */
+        double temperature = 10;
+        /**
+         * @brief The range, in meters, at which the gain is 0 dB
+         */
+        double reference_range = 1;
+        /**
+         * @brief The gain is clamped to this value, in dB
+         */
+        double max_gain = 60;
+
+        /**
+         * @brief Sea water absorption, in dB/m
+         *
+         * This is the Ainslie and McColm (1998) approximation at the surface,
+         * for a pH of 8
+         *
+         * @param frequency the acoustic frequency in Hz
+         * @param salinity in ppt
+         * @param temperature in degrees Celsius
+         */
+        static double absorptionCoefficient(double frequency,
+            double salinity,
+            double temperature);
+
+        /**
+         * @brief Compute the amplitude gain of each bin
+         *
+         * Bin i is given the gain at the center of its range interval,
+         * (i + 0.5) * range_resolution
+         *
+         * @param frequency the acoustic frequency in Hz. If unknown and
+         *   absorption is unknown too, only the spreading is compensated
+         * @param salinity in ppt
+         */
+        void computeGains(std::vector<float>& gains,
+            double range_resolution,
+            uint16_t bin_count,
+            double frequency,
+            double salinity) const;
+
+        bool operator==(GainCompensation const& other) const;
+        bool operator!=(GainCompensation const& other) const;
+    };
+
+    /**
+     * @brief Cache of the per-bin gains of a GainCompensation
+     *
+     * The table only depends on the ping geometry and environment, which
+     * change only on reconfiguration. It is therefore computed once and reused
+     * until one of them changes
+     */
+    class GainTable {
+    public:
+        /**
+         * @brief The gains for the given pings
+         *
+         * The returned pointer is valid until the next call
+         */
+        float const* get(GainCompensation const& compensation,
+            double range_resolution,
+            uint16_t bin_count,
+            double frequency,
+            double salinity);
+
+        /**
+         * @brief How many times the table had to be computed
+         */
+        uint64_t getTableBuilds() const;
+
+    private:
+        std::vector<float> m_gains;
+        GainCompensation m_compensation;
+        double m_range_resolution = base::unknown<double>();
+        double m_frequency = base::unknown<double>();
+        double m_salinity = base::unknown<double>();
+        uint64_t m_table_builds = 0;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_GAINCOMPENSATION_HPP
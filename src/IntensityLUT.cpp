@@ -0,0 +1,79 @@
+#include "IntensityLUT.hpp"
+#include "Normalization.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace sonar_oculus_m750d;
+
+IntensityLUT::IntensityLUT()
+{
+    for (int i = 0; i < SIZE; i++) {
+        m_table[i] = static_cast<float>(i * NORMALIZATION_FACTOR_8BIT);
+    }
+}
+
+IntensityLUT IntensityLUT::linear()
+{
+    return IntensityLUT();
+}
+
+IntensityLUT IntensityLUT::gamma(double gamma)
+{
+    IntensityLUT lut = fromCurve([gamma](double x) { return std::pow(x, gamma); });
+    lut.m_curve = INTENSITY_GAMMA;
+    return lut;
+}
+
+IntensityLUT IntensityLUT::logarithmic(double contrast)
+{
+    if (contrast <= 0) {
+        throw std::runtime_error("the contrast of a logarithmic curve must be positive");
+    }
+    double norm = std::log1p(contrast);
+    IntensityLUT lut = fromCurve(
+        [contrast, norm](double x) { return std::log1p(contrast * x) / norm; });
+    lut.m_curve = INTENSITY_LOG;
+    return lut;
+}
+
+IntensityLUT IntensityLUT::fromCurve(std::function<double(double)> const& curve)
+{
+    IntensityLUT lut;
+    for (int i = 0; i < SIZE; i++) {
+        lut.m_table[i] = static_cast<float>(curve(i * NORMALIZATION_FACTOR_8BIT));
+    }
+    lut.m_curve = INTENSITY_USER;
+    return lut;
+}
+
+IntensityLUT IntensityLUT::fromTable(std::vector<float> const& table)
+{
+    if (table.size() != SIZE) {
+        throw std::runtime_error("an intensity table must have 256 entries");
+    }
+    IntensityLUT lut;
+    std::copy(table.begin(), table.end(), lut.m_table.begin());
+    lut.m_curve = INTENSITY_USER;
+    return lut;
+}
+
+IntensityCurve IntensityLUT::getCurve() const
+{
+    return m_curve;
+}
+
+bool IntensityLUT::isLinear() const
+{
+    return m_curve == INTENSITY_LINEAR;
+}
+
+float const* IntensityLUT::data() const
+{
+    return m_table.data();
+}
+
+float IntensityLUT::operator[](uint8_t sample) const
+{
+    return m_table[sample];
+}
@@ -0,0 +1,78 @@
+#ifndef SONAR_OCULUS_M750D_INTENSITYLUT_HPP
+#define SONAR_OCULUS_M750D_INTENSITYLUT_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief The shapes of intensity transfer curve an IntensityLUT can hold
+     */
+    enum IntensityCurve : uint8_t {
+        INTENSITY_LINEAR = 0x00, // sample / 255
+        INTENSITY_GAMMA = 0x01,  // (sample / 255)^gamma
+        INTENSITY_LOG = 0x02,    // log(1 + c sample / 255) / log(1 + c)
+        INTENSITY_USER = 0x03    // given by the caller
+    };
+
+    /**
+     * @brief Intensity transfer curve, as a table from the 8 bit sample values
+     * to the values of the converted bins
+     *
+     * Any mapping of 8 bit samples is a 256 entry table. Applying it during
+     * the conversion (see transposeLookup) replaces both the normalization
+     * and the curves consumers would otherwise apply on every bin. Changing
+     * the curve only recomputes the table.
+     *
+     * The default is the linear curve, whose table gives the exact same bins
+     * than the conversion without a table
+     */
+    class IntensityLUT {
+    public:
+        static const int SIZE = 256;
+
+        IntensityLUT();
+
+        static IntensityLUT linear();
+        /**
+         * @brief Gamma curve of the normalized samples
+         *
+         * A gamma below 1 brightens the weak echoes
+         */
+        static IntensityLUT gamma(double gamma);
+        /**
+         * @brief Logarithmic curve of the normalized samples
+         *
+         * @param contrast how strongly the weak echoes are amplified, must be
+         *   strictly positive
+         */
+        static IntensityLUT logarithmic(double contrast);
+        /**
+         * @brief Curve given by a function of the normalized samples, in
+         * [0, 1]
+         */
+        static IntensityLUT fromCurve(std::function<double(double)> const& curve);
+        /**
+         * @brief Curve given directly as the SIZE entries of the table
+         *
+         * @throw std::runtime_error if the table does not have SIZE entries
+         */
+        static IntensityLUT fromTable(std::vector<float> const& table);
+
+        IntensityCurve getCurve() const;
+        bool isLinear() const;
+        /**
+         * @brief The SIZE entries of the table
+         */
+        float const* data() const;
+        float operator[](uint8_t sample) const;
+
+    private:
+        IntensityCurve m_curve = INTENSITY_LINEAR;
+        std::array<float, SIZE> m_table;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_INTENSITYLUT_HPP
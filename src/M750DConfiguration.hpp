@@ -54,7 +54,39 @@ namespace sonar_oculus_m750d {
          *
          */
         uint8_t net_speed_limit = 0;
+        /**
+         * @brief Request 16 bit image samples instead of 8 bit
+         *
+         * This doubles the bandwidth but restores the dynamic range lost by
+         * the 8 bit compression
+         */
+        bool data_16bit = false;
+        /**
+         * @brief Request the full ping result (messagePingResult) instead of
+         * the simple one (messageSimplePingResult)
+         */
+        bool full_ping_result = false;
     };
+
+    /**
+     * @brief Field by field comparison, where unknown values compare equal
+     */
+    inline bool operator==(M750DConfiguration const& a, M750DConfiguration const& b)
+    {
+        auto same = [](double x, double y) {
+            return x == y || (base::isUnknown(x) && base::isUnknown(y));
+        };
+        return a.mode == b.mode && same(a.range, b.range) && same(a.gain, b.gain) &&
+               same(a.speed_of_sound, b.speed_of_sound) &&
+               same(a.salinity, b.salinity) && a.gain_assist == b.gain_assist &&
+               a.gamma == b.gamma && a.net_speed_limit == b.net_speed_limit &&
+               a.data_16bit == b.data_16bit && a.full_ping_result == b.full_ping_result;
+    }
+
+    inline bool operator!=(M750DConfiguration const& a, M750DConfiguration const& b)
+    {
+        return !(a == b);
+    }
 }
 
 #endif // SONAR_OCULUS_M750D_M750DCONFIGURATION_HPP
\ No newline at end of file
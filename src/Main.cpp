@@ -1,6 +1,7 @@
 #include <iostream>
 #include <sonar_oculus_m750d/Driver.hpp>
 #include <sonar_oculus_m750d/Protocol.hpp>
+#include <sonar_oculus_m750d/StatusListener.hpp>
 
 using namespace std;
 using namespace sonar_oculus_m750d;
@@ -8,8 +9,10 @@ using namespace sonar_oculus_m750d;
 int usage()
 {
     cerr << "Usage: "
-         << "sonar_oculus_m750d_ctl URI \n"
+         << "sonar_oculus_m750d_ctl URI [LOG]\n"
          << "URI is a valid iodrivers_base URI, e.g. tcp://192.168.1.200:52100\n"
+         << "    or 'auto' to connect to the first sonar that broadcasts its status\n"
+         << "LOG if given, the received packets are recorded in this file\n"
          << flush;
     return 0;
 }
@@ -22,10 +25,24 @@ int main(int argc, char const* argv[])
     string uri(argv[1]);
     base::Angle beam_width = base::Angle::fromDeg(0.25390625);
     base::Angle beam_height = base::Angle::fromDeg(20);
+    DeviceStatus status;
+    if (uri == "auto") {
+        StatusListener listener;
+        listener.open();
+        cout << "waiting for a sonar status broadcast" << endl;
+        while (!listener.waitForStatus(status, base::Time::fromSeconds(5))) {
+        }
+        uri = status.uri();
+        cout << "found sonar " << status.device_id << " with part number "
+             << status.part_number << " at " << status.ip_address << endl;
+    }
     Driver driver(beam_width, beam_height);
     driver.setReadTimeout(base::Time::fromMilliseconds(2000));
     driver.setWriteTimeout(base::Time::fromMilliseconds(1000));
     driver.openURI(uri);
+    if (argc > 2) {
+        driver.startRecording(argv[2]);
+    }
     M750DConfiguration conf;
     conf.mode = 1;
     conf.gain = 1;
@@ -35,11 +52,18 @@ int main(int argc, char const* argv[])
     conf.range = 120;
     conf.salinity = 35;
     conf.speed_of_sound = 1500;
-    driver.fireSonar(conf, UPDATE_10HZ_MAX);
+    driver.fireSonar(status.limits.apply(conf), UPDATE_10HZ_MAX);
+    base::samples::Sonar sonar;
+    bool first_ping = true;
     while (true) {
-        auto sonar = driver.processOne();
-        if (sonar) {
-            std::cout << "bins size = " << sonar->bins.size() << std::endl;
+        if (driver.processOne(sonar)) {
+            if (first_ping) {
+                std::cout << "time to first ping: "
+                          << driver.getTimeToFirstPing().toMilliseconds() << " ms"
+                          << std::endl;
+                first_ping = false;
+            }
+            std::cout << "bins size = " << sonar.bins.size() << std::endl;
         }
     }
 }
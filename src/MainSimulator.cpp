@@ -0,0 +1,118 @@
+#include <csignal>
+#include <getopt.h>
+#include <iostream>
+#include <sonar_oculus_m750d/Simulator.hpp>
+#include <unistd.h>
+
+using namespace std;
+using namespace sonar_oculus_m750d;
+
+int usage()
+{
+    cerr << "Usage: "
+         << "sonar_oculus_m750d_sim [OPTIONS]\n"
+         << "Simulated Oculus M750d, listening on localhost\n"
+         << "  --port PORT          TCP port (default: 52100)\n"
+         << "  --beams COUNT        256 or 512 (default: 512)\n"
+         << "  --range METERS       range until the client sets it (default: 40)\n"
+         << "  --resolution METERS  size of a range line (default: 0.08)\n"
+         << "  --16bit              send 16 bit images\n"
+         << "  --rate HZ            ping rate, overriding the one requested\n"
+         << "  --no-wait            stream without waiting for a fire message\n"
+         << "  --fragment BYTES     send packets in fragments of at most BYTES\n"
+         << "  --corrupt P          probability that a packet is corrupted\n"
+         << "  --stall P            probability of a stall in a packet\n"
+         << "  --stall-ms MS        duration of the stalls (default: 500)\n"
+         << "  --seed SEED          seed of the fault injection\n"
+         << flush;
+    return 0;
+}
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleSignal(int)
+{
+    interrupted = 1;
+}
+
+int main(int argc, char* argv[])
+{
+    SimulatorConfiguration config;
+    config.port = 52100;
+
+    option options[] = {{"port", required_argument, nullptr, 'p'},
+        {"beams", required_argument, nullptr, 'b'},
+        {"range", required_argument, nullptr, 'r'},
+        {"resolution", required_argument, nullptr, 'R'},
+        {"16bit", no_argument, nullptr, '6'},
+        {"rate", required_argument, nullptr, 'f'},
+        {"no-wait", no_argument, nullptr, 'n'},
+        {"fragment", required_argument, nullptr, 'F'},
+        {"corrupt", required_argument, nullptr, 'c'},
+        {"stall", required_argument, nullptr, 's'},
+        {"stall-ms", required_argument, nullptr, 'S'},
+        {"seed", required_argument, nullptr, 'x'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (option) {
+            case 'p':
+                config.port = stoi(optarg);
+                break;
+            case 'b':
+                config.beam_count = stoi(optarg);
+                break;
+            case 'r':
+                config.range = stod(optarg);
+                break;
+            case 'R':
+                config.range_resolution = stod(optarg);
+                break;
+            case '6':
+                config.data_size = dataSize16Bit;
+                break;
+            case 'f':
+                config.ping_rate = stod(optarg);
+                break;
+            case 'n':
+                config.wait_for_fire = false;
+                break;
+            case 'F':
+                config.max_fragment_size = stoul(optarg);
+                break;
+            case 'c':
+                config.corruption_probability = stod(optarg);
+                break;
+            case 's':
+                config.stall_probability = stod(optarg);
+                break;
+            case 'S':
+                config.stall_duration = base::Time::fromMilliseconds(stoi(optarg));
+                break;
+            case 'x':
+                config.seed = stoul(optarg);
+                break;
+            default:
+                return usage();
+        }
+    }
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    Simulator simulator(config);
+    simulator.start();
+    cout << "listening on tcp://127.0.0.1:" << simulator.getPort() << endl;
+    while (!interrupted) {
+        sleep(1);
+        auto stats = simulator.getStatistics();
+        cout << "pings=" << stats.pings_sent << " bytes=" << stats.bytes_sent
+             << " fire=" << stats.fire_messages_received
+             << " corruptions=" << stats.corruptions << " stalls=" << stats.stalls
+             << endl;
+    }
+    simulator.stop();
+    return 0;
+}
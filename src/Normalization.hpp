@@ -0,0 +1,15 @@
+#ifndef SONAR_OCULUS_M750D_NORMALIZATION_HPP
+#define SONAR_OCULUS_M750D_NORMALIZATION_HPP
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief The factor that maps the 8 bit image samples to [0, 1]
+     *
+     * Both Protocol::NORMALIZATION_FACTOR and the linear IntensityLUT are
+     * defined from it, so that the conversion gives the same bins with and
+     * without the table
+     */
+    constexpr double NORMALIZATION_FACTOR_8BIT = 1.0 / 255;
+}
+
+#endif // SONAR_OCULUS_M750D_NORMALIZATION_HPP
@@ -0,0 +1,53 @@
+#ifndef SONAR_OCULUS_M750D_PACKETLOGFORMAT_HPP
+#define SONAR_OCULUS_M750D_PACKETLOGFORMAT_HPP
+
+#include <cstdint>
+
+/**
+ * On-disk layout of the packet logs, shared by PacketLogWriter and
+ * PacketLogReader. All fields are little-endian.
+ *
+ *   FileHeader
+ *   RecordHeader, packet bytes, padding to RECORD_ALIGNMENT   (repeated)
+ *   uint64_t ping_offsets[ping_count]                          (index)
+ *   FileFooter
+ *
+ * The index and footer are written when the log is closed. A log without
+ * them (e.g. after a crash) is still readable, the reader rebuilds the index
+ * by walking the records.
+ */
+namespace sonar_oculus_m750d {
+    namespace packet_log {
+        static const char FILE_MAGIC[8] = {'O', 'C', 'U', 'L', 'O', 'G', '0', '1'};
+        static const char FOOTER_MAGIC[8] = {'O', 'C', 'U', 'L', 'I', 'D', 'X', '1'};
+        static const uint32_t RECORD_ALIGNMENT = 8;
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+        };
+
+        struct RecordHeader {
+            /** Size of the packet, without the record header and padding */
+            uint32_t size;
+            uint32_t reserved;
+            /** Reception time, in microseconds since the epoch */
+            int64_t time;
+        };
+
+        struct FileFooter {
+            uint64_t index_offset;
+            uint64_t ping_count;
+            uint64_t packet_count;
+            char magic[8];
+        };
+
+        inline uint64_t alignRecord(uint64_t size)
+        {
+            return (size + RECORD_ALIGNMENT - 1) & ~uint64_t(RECORD_ALIGNMENT - 1);
+        }
+    }
+}
+
+#endif // SONAR_OCULUS_M750D_PACKETLOGFORMAT_HPP
@@ -0,0 +1,272 @@
+#include "PacketLogReader.hpp"
+#include "Oculus.h"
+#include "PacketLogFormat.hpp"
+#include "PacketValidation.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace sonar_oculus_m750d::packet_log;
+
+PacketLogReader::PacketLogReader(std::string const& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open packet log " + path + ": " +
+                                 strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat packet log " + path + ": " +
+                                 strerror(errno));
+    }
+    m_size = info.st_size;
+    if (m_size < sizeof(FileHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a packet log");
+    }
+
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cannot map packet log " + path + ": " +
+                                 strerror(errno));
+    }
+    m_data = static_cast<uint8_t const*>(mapping);
+    madvise(mapping, m_size, MADV_SEQUENTIAL);
+
+    FileHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != 1) {
+        munmap(mapping, m_size);
+        throw std::runtime_error(path + " is not a packet log");
+    }
+
+    m_records_end = m_size;
+    readIndex();
+    if (!m_has_index) {
+        rebuildIndex();
+    }
+    rewind();
+}
+
+PacketLogReader::~PacketLogReader()
+{
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+void PacketLogReader::readIndex()
+{
+    if (m_size < sizeof(FileHeader) + sizeof(FileFooter)) {
+        return;
+    }
+    FileFooter footer;
+    memcpy(&footer, m_data + m_size - sizeof(footer), sizeof(footer));
+    if (memcmp(footer.magic, FOOTER_MAGIC, sizeof(footer.magic)) != 0) {
+        return;
+    }
+    uint64_t index_size = m_size - sizeof(footer) - sizeof(FileHeader);
+    if (footer.ping_count > index_size / sizeof(uint64_t)) {
+        return;
+    }
+    uint64_t index_end = footer.index_offset + footer.ping_count * sizeof(uint64_t);
+    if (footer.index_offset < sizeof(FileHeader) || index_end != m_size - sizeof(footer)) {
+        return;
+    }
+
+    // A corrupted index would make ping() read outside of the mapping. Ignore
+    // it, the records before it are walked instead
+    m_records_end = footer.index_offset;
+    uint8_t const* offsets = m_data + footer.index_offset;
+    for (uint64_t i = 0; i < footer.ping_count; ++i) {
+        uint64_t offset;
+        memcpy(&offset, offsets + i * sizeof(uint64_t), sizeof(offset));
+        if (!isRecordWithin(offset, m_records_end)) {
+            return;
+        }
+    }
+
+    m_has_index = true;
+    m_ping_offsets = m_data + footer.index_offset;
+    m_ping_count = footer.ping_count;
+    m_packet_count = footer.packet_count;
+}
+
+bool PacketLogReader::isRecordWithin(uint64_t offset, uint64_t end) const
+{
+    if (offset < sizeof(FileHeader) || offset % RECORD_ALIGNMENT != 0 ||
+        offset > end || end - offset < sizeof(RecordHeader)) {
+        return false;
+    }
+    RecordHeader header;
+    memcpy(&header, m_data + offset, sizeof(header));
+    return header.size <= end - offset - sizeof(RecordHeader);
+}
+
+static bool isPing(LoggedPacket const& packet);
+
+void PacketLogReader::rebuildIndex()
+{
+    m_rebuilt_ping_offsets.clear();
+    m_packet_count = 0;
+
+    uint64_t end = m_records_end;
+    uint64_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= end) {
+        RecordHeader header;
+        memcpy(&header, m_data + offset, sizeof(header));
+        uint64_t next = offset + sizeof(RecordHeader) + alignRecord(header.size);
+        if (!isRecordWithin(offset, end)) {
+            // Truncated record
+            break;
+        }
+        if (isPing(packetAt(offset))) {
+            m_rebuilt_ping_offsets.push_back(offset);
+        }
+        m_packet_count++;
+        offset = std::min<uint64_t>(next, end);
+    }
+
+    m_records_end = offset;
+    m_ping_offsets = reinterpret_cast<uint8_t const*>(m_rebuilt_ping_offsets.data());
+    m_ping_count = m_rebuilt_ping_offsets.size();
+}
+
+bool isPing(LoggedPacket const& packet)
+{
+    if (packet.size < sizeof(OculusMessageHeader)) {
+        return false;
+    }
+    OculusMessageHeader header;
+    memcpy(&header, packet.data, sizeof(header));
+    return header.msgId == messageSimplePingResult || header.msgId == messagePingResult;
+}
+
+LoggedPacket PacketLogReader::packetAt(uint64_t offset) const
+{
+    RecordHeader header;
+    memcpy(&header, m_data + offset, sizeof(header));
+    LoggedPacket packet;
+    packet.data = m_data + offset + sizeof(RecordHeader);
+    packet.size = header.size;
+    packet.time = base::Time::fromMicroseconds(header.time);
+    return packet;
+}
+
+uint64_t PacketLogReader::pingOffset(uint64_t index) const
+{
+    if (index >= m_ping_count) {
+        throw std::out_of_range("ping index beyond the end of the packet log");
+    }
+    uint64_t offset;
+    memcpy(&offset, m_ping_offsets + index * sizeof(uint64_t), sizeof(offset));
+    return offset;
+}
+
+uint64_t PacketLogReader::getPacketCount() const
+{
+    return m_packet_count;
+}
+
+uint64_t PacketLogReader::getPingCount() const
+{
+    return m_ping_count;
+}
+
+bool PacketLogReader::hasIndex() const
+{
+    return m_has_index;
+}
+
+bool PacketLogReader::next(LoggedPacket& packet)
+{
+    while (true) {
+        if (m_cursor + sizeof(RecordHeader) > m_records_end) {
+            return false;
+        }
+        packet = packetAt(m_cursor);
+        if (m_cursor + sizeof(RecordHeader) + packet.size > m_records_end) {
+            return false;
+        }
+        m_cursor += sizeof(RecordHeader) + alignRecord(packet.size);
+        if (isValidPacket(packet.data, packet.size)) {
+            break;
+        }
+        m_rejected_records++;
+    }
+
+    if (m_replay_speed == REPLAY_RECORDED_SPEED) {
+        waitForReplayTime(packet.time);
+    }
+    return true;
+}
+
+LoggedPacket PacketLogReader::ping(uint64_t index) const
+{
+    LoggedPacket packet = packetAt(pingOffset(index));
+    if (!isValidPacket(packet.data, packet.size)) {
+        throw std::runtime_error("ping " + std::to_string(index) +
+                                 " of the packet log is corrupted");
+    }
+    return packet;
+}
+
+uint64_t PacketLogReader::getRejectedRecordCount() const
+{
+    return m_rejected_records;
+}
+
+void PacketLogReader::seekToPing(uint64_t index)
+{
+    m_cursor = pingOffset(index);
+    restartReplayClock();
+}
+
+void PacketLogReader::rewind()
+{
+    m_cursor = sizeof(FileHeader);
+    restartReplayClock();
+}
+
+void PacketLogReader::setReplaySpeed(ReplaySpeed speed)
+{
+    m_replay_speed = speed;
+    restartReplayClock();
+}
+
+ReplaySpeed PacketLogReader::getReplaySpeed() const
+{
+    return m_replay_speed;
+}
+
+void PacketLogReader::restartReplayClock()
+{
+    m_replay_started = false;
+}
+
+void PacketLogReader::waitForReplayTime(base::Time const& packet_time)
+{
+    base::Time now = base::Time::now();
+    if (!m_replay_started) {
+        m_replay_started = true;
+        m_replay_start = now;
+        m_replay_log_start = packet_time;
+        return;
+    }
+
+    base::Time target = m_replay_start + (packet_time - m_replay_log_start);
+    if (now < target) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds((target - now).toMicroseconds()));
+    }
+}
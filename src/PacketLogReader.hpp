@@ -0,0 +1,112 @@
+#ifndef SONAR_OCULUS_M750D_PACKETLOGREADER_HPP
+#define SONAR_OCULUS_M750D_PACKETLOGREADER_HPP
+
+#include <base/Time.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief A packet from a log. The data points into the log's mapping
+     */
+    struct LoggedPacket {
+        uint8_t const* data = nullptr;
+        uint32_t size = 0;
+        /** The time at which the packet was received when recorded */
+        base::Time time;
+    };
+
+    enum ReplaySpeed {
+        /** next() returns immediately */
+        REPLAY_AS_FAST_AS_POSSIBLE,
+        /** next() waits so that packets come out spaced as they were
+         * received */
+        REPLAY_RECORDED_SPEED
+    };
+
+    /**
+     * @brief Reads a log written by PacketLogWriter
+     *
+     * The file is memory-mapped, and the packets point into the mapping. They
+     * can be given as-is, with their size, to Protocol::handleBuffer or
+     * Driver::decodePacket, and are valid as long as the reader exists. Each
+     * packet goes through the checks of Driver::extractPacket before being
+     * returned: next() skips the records that fail them, and ping() throws.
+     *
+     * If the log has no index (the recording was interrupted), or if its
+     * index points outside of the records, the reader rebuilds it, and
+     * ignores a truncated last record.
+     */
+    class PacketLogReader {
+    public:
+        explicit PacketLogReader(std::string const& path);
+        ~PacketLogReader();
+        PacketLogReader(PacketLogReader const&) = delete;
+        PacketLogReader& operator=(PacketLogReader const&) = delete;
+
+        uint64_t getPacketCount() const;
+        uint64_t getPingCount() const;
+        /**
+         * @brief Whether the log had a valid index, i.e. was closed properly
+         */
+        bool hasIndex() const;
+
+        /**
+         * @brief Get the next packet
+         *
+         * Records that do not hold a valid packet are skipped, and counted in
+         * getRejectedRecordCount
+         *
+         * @return false at the end of the log
+         */
+        bool next(LoggedPacket& packet);
+        /**
+         * @brief Random access to a ping, in constant time
+         *
+         * @throw std::runtime_error if the record does not hold a valid packet
+         */
+        LoggedPacket ping(uint64_t index) const;
+        /**
+         * @brief How many records next() skipped so far
+         */
+        uint64_t getRejectedRecordCount() const;
+        /**
+         * @brief Make next() continue from the given ping
+         */
+        void seekToPing(uint64_t index);
+        void rewind();
+
+        void setReplaySpeed(ReplaySpeed speed);
+        ReplaySpeed getReplaySpeed() const;
+
+    private:
+        void readIndex();
+        void rebuildIndex();
+        LoggedPacket packetAt(uint64_t offset) const;
+        /** Whether the record at offset, packet included, ends before end */
+        bool isRecordWithin(uint64_t offset, uint64_t end) const;
+        uint64_t pingOffset(uint64_t index) const;
+        void restartReplayClock();
+        void waitForReplayTime(base::Time const& packet_time);
+
+        uint8_t const* m_data = nullptr;
+        size_t m_size = 0;
+        uint64_t m_records_end = 0;
+        uint64_t m_cursor = 0;
+        bool m_has_index = false;
+        /** Ping offsets, in the mapping when the log had an index */
+        uint8_t const* m_ping_offsets = nullptr;
+        std::vector<uint64_t> m_rebuilt_ping_offsets;
+        uint64_t m_ping_count = 0;
+        uint64_t m_packet_count = 0;
+        uint64_t m_rejected_records = 0;
+
+        ReplaySpeed m_replay_speed = REPLAY_AS_FAST_AS_POSSIBLE;
+        bool m_replay_started = false;
+        base::Time m_replay_start;
+        base::Time m_replay_log_start;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_PACKETLOGREADER_HPP
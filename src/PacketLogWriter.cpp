@@ -0,0 +1,171 @@
+#include "PacketLogWriter.hpp"
+#include "Oculus.h"
+#include "PacketLogFormat.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace sonar_oculus_m750d::packet_log;
+
+PacketLogWriter::PacketLogWriter(std::string const& path)
+{
+    open(path);
+}
+
+PacketLogWriter::~PacketLogWriter()
+{
+    if (isOpen()) {
+        try {
+            close();
+        }
+        catch (std::runtime_error const&) {
+        }
+    }
+}
+
+void PacketLogWriter::open(std::string const& path)
+{
+    if (isOpen()) {
+        close();
+    }
+
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        throw std::runtime_error("cannot create packet log " + path + ": " +
+                                 strerror(errno));
+    }
+    m_chunk.clear();
+    m_chunk.reserve(CHUNK_SIZE);
+    m_offset = 0;
+    m_ping_offsets.clear();
+    m_packet_count = 0;
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    writeRaw(reinterpret_cast<uint8_t const*>(&header), sizeof(header));
+}
+
+bool PacketLogWriter::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+static bool isPing(uint8_t const* packet, uint32_t size);
+
+void PacketLogWriter::write(uint8_t const* packet,
+    uint32_t size,
+    base::Time const& received_at)
+{
+    if (!isOpen()) {
+        throw std::runtime_error("PacketLogWriter::write: the log is not open");
+    }
+
+    if (isPing(packet, size)) {
+        m_ping_offsets.push_back(m_offset + m_chunk.size());
+    }
+    m_packet_count++;
+
+    RecordHeader header;
+    header.size = size;
+    header.reserved = 0;
+    header.time = received_at.toMicroseconds();
+    writeRaw(reinterpret_cast<uint8_t const*>(&header), sizeof(header));
+    writeRaw(packet, size);
+    static const uint8_t padding[RECORD_ALIGNMENT] = {};
+    writeRaw(padding, alignRecord(size) - size);
+}
+
+bool isPing(uint8_t const* packet, uint32_t size)
+{
+    if (size < sizeof(OculusMessageHeader)) {
+        return false;
+    }
+    OculusMessageHeader header;
+    memcpy(&header, packet, sizeof(header));
+    return header.msgId == messageSimplePingResult || header.msgId == messagePingResult;
+}
+
+static void writeAll(int fd, uint8_t const* data, size_t size);
+
+void PacketLogWriter::writeRaw(uint8_t const* data, size_t size)
+{
+    if (m_chunk.size() + size > CHUNK_SIZE) {
+        flush();
+    }
+    if (size > CHUNK_SIZE) {
+        // Larger than a chunk, write it directly
+        writeAll(m_fd, data, size);
+        m_offset += size;
+        return;
+    }
+    m_chunk.insert(m_chunk.end(), data, data + size);
+}
+
+void PacketLogWriter::flush()
+{
+    writeAll(m_fd, m_chunk.data(), m_chunk.size());
+    m_offset += m_chunk.size();
+    m_chunk.clear();
+}
+
+void writeAll(int fd, uint8_t const* data, size_t size)
+{
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = ::write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("failed to write packet log: ") +
+                                     strerror(errno));
+        }
+        written += ret;
+    }
+}
+
+void PacketLogWriter::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    FileFooter footer;
+    footer.index_offset = m_offset + m_chunk.size();
+    footer.ping_count = m_ping_offsets.size();
+    footer.packet_count = m_packet_count;
+    memcpy(footer.magic, FOOTER_MAGIC, sizeof(footer.magic));
+
+    int fd = m_fd;
+    try {
+        writeRaw(reinterpret_cast<uint8_t const*>(m_ping_offsets.data()),
+            m_ping_offsets.size() * sizeof(uint64_t));
+        writeRaw(reinterpret_cast<uint8_t const*>(&footer), sizeof(footer));
+        flush();
+    }
+    catch (...) {
+        m_fd = -1;
+        ::close(fd);
+        throw;
+    }
+    m_fd = -1;
+    if (::close(fd) != 0) {
+        throw std::runtime_error(std::string("failed to close packet log: ") +
+                                 strerror(errno));
+    }
+}
+
+uint64_t PacketLogWriter::getPacketCount() const
+{
+    return m_packet_count;
+}
+
+uint64_t PacketLogWriter::getPingCount() const
+{
+    return m_ping_offsets.size();
+}
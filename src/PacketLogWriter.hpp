@@ -0,0 +1,64 @@
+#ifndef SONAR_OCULUS_M750D_PACKETLOGWRITER_HPP
+#define SONAR_OCULUS_M750D_PACKETLOGWRITER_HPP
+
+#include <base/Time.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief Records raw Oculus packets in a binary log
+     *
+     * Each packet is stored with its length and reception time. Records are
+     * accumulated in memory and written in chunks of CHUNK_SIZE bytes, so
+     * that recording does not cost a system call per packet. The ping index
+     * used by PacketLogReader for seeking is written by close().
+     */
+    class PacketLogWriter {
+    public:
+        static const size_t CHUNK_SIZE = 1 << 20;
+
+        PacketLogWriter() = default;
+        /**
+         * @brief Create the log, truncating any existing file
+         */
+        explicit PacketLogWriter(std::string const& path);
+        ~PacketLogWriter();
+        PacketLogWriter(PacketLogWriter const&) = delete;
+        PacketLogWriter& operator=(PacketLogWriter const&) = delete;
+
+        void open(std::string const& path);
+        bool isOpen() const;
+        /**
+         * @brief Flush the records and write the index
+         */
+        void close();
+
+        /**
+         * @brief Append a packet
+         *
+         * Ping results are added to the index
+         */
+        void write(uint8_t const* packet, uint32_t size, base::Time const& received_at);
+        /**
+         * @brief Write the records accumulated so far
+         */
+        void flush();
+
+        uint64_t getPacketCount() const;
+        uint64_t getPingCount() const;
+
+    private:
+        void writeRaw(uint8_t const* data, size_t size);
+
+        int m_fd = -1;
+        std::vector<uint8_t> m_chunk;
+        /** Offset in the file of the start of m_chunk */
+        uint64_t m_offset = 0;
+        std::vector<uint64_t> m_ping_offsets;
+        uint64_t m_packet_count = 0;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_PACKETLOGWRITER_HPP
@@ -0,0 +1,229 @@
+#include "PacketPool.hpp"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace sonar_oculus_m750d;
+
+namespace sonar_oculus_m750d {
+    struct PacketPoolState {
+        std::mutex mutex;
+        std::vector<PacketNode*> idle;
+        size_t buffer_size;
+        size_t max_idle;
+        bool closed = false;
+        PacketPoolStatistics statistics;
+
+        ~PacketPoolState();
+        void release(PacketNode* node);
+    };
+
+    struct PacketNode {
+        std::atomic<long> references{0};
+        std::vector<uint8_t> data;
+        size_t size = 0;
+        base::Time received_at;
+        /** The pool the node is handed out from. Reset while the node is idle */
+        std::shared_ptr<PacketPoolState> pool;
+    };
+}
+
+PacketPoolState::~PacketPoolState()
+{
+    for (auto node : idle) {
+        delete node;
+    }
+}
+
+void PacketPoolState::release(PacketNode* node)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    statistics.in_use--;
+    if (!closed && idle.size() < max_idle && node->data.size() == buffer_size) {
+        idle.push_back(node);
+        statistics.idle = idle.size();
+    }
+    else {
+        delete node;
+    }
+}
+
+static void releaseNode(PacketNode* node)
+{
+    if (node->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // The node may hold the last reference to the pool state, make sure it
+    // survives until the release is done
+    auto pool = std::move(node->pool);
+    pool->release(node);
+}
+
+PacketBuffer::PacketBuffer(PacketNode* node)
+    : m_node(node)
+{
+    m_node->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+PacketBuffer::PacketBuffer(PacketBuffer const& other)
+    : m_node(other.m_node)
+{
+    if (m_node) {
+        m_node->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PacketBuffer::PacketBuffer(PacketBuffer&& other) noexcept
+    : m_node(other.m_node)
+{
+    other.m_node = nullptr;
+}
+
+PacketBuffer& PacketBuffer::operator=(PacketBuffer const& other)
+{
+    if (other.m_node) {
+        other.m_node->references.fetch_add(1, std::memory_order_relaxed);
+    }
+    reset();
+    m_node = other.m_node;
+    return *this;
+}
+
+PacketBuffer& PacketBuffer::operator=(PacketBuffer&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_node = other.m_node;
+        other.m_node = nullptr;
+    }
+    return *this;
+}
+
+PacketBuffer::~PacketBuffer()
+{
+    reset();
+}
+
+bool PacketBuffer::valid() const
+{
+    return m_node != nullptr;
+}
+
+void PacketBuffer::reset()
+{
+    if (m_node) {
+        releaseNode(m_node);
+        m_node = nullptr;
+    }
+}
+
+uint8_t* PacketBuffer::data()
+{
+    return m_node->data.data();
+}
+
+uint8_t const* PacketBuffer::data() const
+{
+    return m_node->data.data();
+}
+
+size_t PacketBuffer::size() const
+{
+    return m_node->size;
+}
+
+void PacketBuffer::resize(size_t size)
+{
+    if (size > m_node->data.size()) {
+        throw std::length_error("PacketBuffer::resize: size exceeds the buffer capacity");
+    }
+    m_node->size = size;
+}
+
+size_t PacketBuffer::capacity() const
+{
+    return m_node->data.size();
+}
+
+base::Time PacketBuffer::receivedAt() const
+{
+    return m_node->received_at;
+}
+
+void PacketBuffer::setReceivedAt(base::Time const& time)
+{
+    m_node->received_at = time;
+}
+
+long PacketBuffer::useCount() const
+{
+    return m_node ? m_node->references.load(std::memory_order_relaxed) : 0;
+}
+
+PacketPool::PacketPool(size_t buffer_size, size_t max_idle)
+    : m_state(std::make_shared<PacketPoolState>())
+{
+    m_state->buffer_size = buffer_size;
+    m_state->max_idle = max_idle;
+    m_state->idle.reserve(max_idle);
+}
+
+PacketPool::~PacketPool()
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->closed = true;
+}
+
+PacketBuffer PacketPool::acquire()
+{
+    PacketNode* node = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        if (!m_state->idle.empty()) {
+            node = m_state->idle.back();
+            m_state->idle.pop_back();
+            m_state->statistics.reuses++;
+        }
+        else {
+            m_state->statistics.allocations++;
+        }
+        m_state->statistics.in_use++;
+        m_state->statistics.idle = m_state->idle.size();
+    }
+
+    if (!node) {
+        node = new PacketNode();
+        node->data.resize(getBufferSize());
+    }
+    node->size = 0;
+    node->received_at = base::Time();
+    node->pool = m_state;
+    return PacketBuffer(node);
+}
+
+void PacketPool::setBufferSize(size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    if (size == m_state->buffer_size) {
+        return;
+    }
+    m_state->buffer_size = size;
+    for (auto node : m_state->idle) {
+        delete node;
+    }
+    m_state->idle.clear();
+    m_state->statistics.idle = 0;
+}
+
+size_t PacketPool::getBufferSize() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->buffer_size;
+}
+
+PacketPoolStatistics PacketPool::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->statistics;
+}
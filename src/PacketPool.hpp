@@ -0,0 +1,117 @@
+#ifndef SONAR_OCULUS_M750D_PACKETPOOL_HPP
+#define SONAR_OCULUS_M750D_PACKETPOOL_HPP
+
+#include <base/Time.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace sonar_oculus_m750d {
+    struct PacketNode;
+    struct PacketPoolState;
+
+    /**
+     * @brief Reference-counted handle on a packet buffer from a PacketPool
+     *
+     * Copying the handle shares the buffer, it does not copy it. The buffer
+     * goes back to its pool when the last handle is destroyed, even if the
+     * pool itself has been destroyed in between.
+     */
+    class PacketBuffer {
+    public:
+        PacketBuffer() = default;
+        PacketBuffer(PacketBuffer const& other);
+        PacketBuffer(PacketBuffer&& other) noexcept;
+        PacketBuffer& operator=(PacketBuffer const& other);
+        PacketBuffer& operator=(PacketBuffer&& other) noexcept;
+        ~PacketBuffer();
+
+        /**
+         * @brief Whether this handle refers to a buffer
+         */
+        bool valid() const;
+        /**
+         * @brief Release this handle's reference
+         */
+        void reset();
+
+        uint8_t* data();
+        uint8_t const* data() const;
+        /**
+         * @brief The number of bytes actually used in the buffer
+         */
+        size_t size() const;
+        /**
+         * @brief Set the number of bytes used. Must not exceed capacity()
+         */
+        void resize(size_t size);
+        size_t capacity() const;
+
+        /**
+         * @brief The time at which the packet was received
+         */
+        base::Time receivedAt() const;
+        void setReceivedAt(base::Time const& time);
+
+        /**
+         * @brief The number of handles sharing this buffer
+         */
+        long useCount() const;
+
+    private:
+        friend class PacketPool;
+        explicit PacketBuffer(PacketNode* node);
+
+        PacketNode* m_node = nullptr;
+    };
+
+    struct PacketPoolStatistics {
+        /** Buffers that had to be allocated */
+        uint64_t allocations = 0;
+        /** Buffers handed out from the idle list */
+        uint64_t reuses = 0;
+        /** Buffers currently handed out */
+        uint64_t in_use = 0;
+        /** Buffers currently waiting in the idle list */
+        uint64_t idle = 0;
+    };
+
+    /**
+     * @brief Pool of preallocated packet buffers
+     *
+     * Buffers are allocated on demand and recycled when released, so that
+     * in steady state acquiring a buffer does not allocate. At most max_idle
+     * released buffers are kept, the others are freed.
+     */
+    class PacketPool {
+    public:
+        static const size_t DEFAULT_MAX_IDLE = 8;
+
+        explicit PacketPool(size_t buffer_size, size_t max_idle = DEFAULT_MAX_IDLE);
+        ~PacketPool();
+        PacketPool(PacketPool const&) = delete;
+        PacketPool& operator=(PacketPool const&) = delete;
+
+        /**
+         * @brief Get an unused buffer of getBufferSize() bytes
+         *
+         * The returned buffer has a size of zero
+         */
+        PacketBuffer acquire();
+
+        /**
+         * @brief Change the size of the buffers
+         *
+         * Idle buffers of the old size are freed, buffers in use are freed
+         * when released
+         */
+        void setBufferSize(size_t size);
+        size_t getBufferSize() const;
+
+        PacketPoolStatistics getStatistics() const;
+
+    private:
+        std::shared_ptr<PacketPoolState> m_state;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_PACKETPOOL_HPP
@@ -0,0 +1,79 @@
+#include "PacketValidation.hpp"
+#include <string.h>
+
+using namespace sonar_oculus_m750d;
+
+bool sonar_oculus_m750d::isValidHeader(OculusMessageHeader const& header,
+    size_t max_packet_size)
+{
+    if (header.oculusId != OCULUS_CHECK_ID) {
+        return false;
+    }
+    // All Oculus message IDs fit in a byte
+    if (header.msgId == 0 || header.msgId > 0xff) {
+        return false;
+    }
+    // A packet bigger than the driver's buffers would never be extracted
+    // and stall the stream
+    return header.payloadSize <= max_packet_size - sizeof(OculusMessageHeader);
+}
+
+static bool isWithin(uint64_t offset, uint64_t size, size_t packet_size)
+{
+    return offset + size <= packet_size;
+}
+
+template <typename Result>
+static bool isConsistentSimplePingResult(uint8_t const* buffer, size_t packet_size)
+{
+    if (packet_size < sizeof(Result)) {
+        return false;
+    }
+    Result result;
+    memcpy(&result, buffer, sizeof(Result));
+    return result.messageSize == packet_size &&
+           isWithin(sizeof(Result), result.nBeams * sizeof(short), packet_size) &&
+           isWithin(result.imageOffset, result.imageSize, packet_size);
+}
+
+bool sonar_oculus_m750d::isConsistentPacket(uint8_t const* buffer,
+    OculusMessageHeader const& header,
+    size_t packet_size)
+{
+    switch (header.msgId) {
+        case messageSimplePingResult:
+            if (header.msgVersion == 2) {
+                return isConsistentSimplePingResult<OculusSimplePingResult2>(buffer,
+                    packet_size);
+            }
+            return isConsistentSimplePingResult<OculusSimplePingResult>(buffer,
+                packet_size);
+        case messagePingResult: {
+            if (packet_size < sizeof(OculusReturnFireMessage)) {
+                return false;
+            }
+            OculusReturnFireMessage result;
+            memcpy(&result, buffer, sizeof(OculusReturnFireMessage));
+            return isWithin(sizeof(OculusReturnFireMessage),
+                       result.ping.nBeams * sizeof(short),
+                       packet_size) &&
+                   isWithin(result.ping_params.imageOffset,
+                       result.ping_params.imageSize,
+                       packet_size);
+        }
+        default:
+            return true;
+    }
+}
+
+bool sonar_oculus_m750d::isValidPacket(uint8_t const* buffer, size_t packet_size)
+{
+    if (packet_size < sizeof(OculusMessageHeader)) {
+        return false;
+    }
+    OculusMessageHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    return isValidHeader(header, packet_size) &&
+           sizeof(OculusMessageHeader) + header.payloadSize == packet_size &&
+           isConsistentPacket(buffer, header, packet_size);
+}
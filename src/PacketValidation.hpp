@@ -0,0 +1,33 @@
+#ifndef SONAR_OCULUS_M750D_PACKETVALIDATION_HPP
+#define SONAR_OCULUS_M750D_PACKETVALIDATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <sonar_oculus_m750d/Oculus.h>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief Whether a header may start a packet of at most max_packet_size
+     * bytes
+     */
+    bool isValidHeader(OculusMessageHeader const& header, size_t max_packet_size);
+    /**
+     * @brief Whether the bearings and image of a ping result lie within the
+     * packet
+     *
+     * Other messages are not checked
+     */
+    bool isConsistentPacket(uint8_t const* buffer,
+        OculusMessageHeader const& header,
+        size_t packet_size);
+    /**
+     * @brief Whether the buffer holds exactly one packet, that passes the
+     * checks of Driver::extractPacket
+     *
+     * Used on packets that do not come from the stream, e.g. the ones
+     * replayed from a packet log
+     */
+    bool isValidPacket(uint8_t const* buffer, size_t packet_size);
+}
+
+#endif // SONAR_OCULUS_M750D_PACKETVALIDATION_HPP
@@ -0,0 +1,46 @@
+#ifndef SONAR_OCULUS_M750D_PINGVIEW_HPP
+#define SONAR_OCULUS_M750D_PINGVIEW_HPP
+
+#include <cstdint>
+#include <sonar_oculus_m750d/Oculus.h>
+#include <string.h>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief Non-owning view over a ping packet
+     *
+     * The pointers refer to the packet bytes themselves (usually the driver's
+     * read buffer), which must therefore outlive the view
+     */
+    struct PingView {
+        /**
+         * @brief The header of the packet
+         */
+        OculusMessageHeader header;
+        /**
+         * @brief The beam bearings, as beam_count shorts in 0.01 degrees
+         *
+         * The packed message layout does not guarantee that they are aligned,
+         * use bearing() to read them
+         */
+        uint8_t const* bearings = nullptr;
+        uint16_t beam_count = 0;
+        /**
+         * @brief The image, in bin-major order
+         */
+        uint8_t const* image = nullptr;
+        uint32_t image_size = 0;
+
+        /**
+         * @brief The bearing of a beam, in 0.01 degrees
+         */
+        short bearing(uint16_t beam) const
+        {
+            short value;
+            memcpy(&value, bearings + beam * sizeof(short), sizeof(short));
+            return value;
+        }
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_PINGVIEW_HPP
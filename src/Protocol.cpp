@@ -1,101 +1,515 @@
 #include "Protocol.hpp"
 #include "Oculus.h"
+#include "Transpose.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <sonar_oculus_m750d/Protocol.hpp>
 #include <string.h>
 
 using namespace sonar_oculus_m750d;
 
-bool Protocol::handleBuffer(uint8_t const* buffer)
+bool Protocol::handleBuffer(uint8_t const* buffer, size_t size)
 {
+    if (size < sizeof(OculusMessageHeader)) {
+        throw std::runtime_error("buffer is smaller than a message header");
+    }
     OculusMessageHeader header;
     memcpy(&header, buffer, sizeof(OculusMessageHeader));
     switch (header.msgId) {
         case messageSimplePingResult:
-            handleMessageSimplePingResult(buffer, header.msgVersion);
+            handleMessageSimplePingResult(buffer, size, header.msgVersion);
             return true;
         case messagePingResult:
-            throw std::runtime_error("messagePingResult handler is not implemented");
+            handleMessagePingResult(buffer, size);
+            return true;
         default:
             return false;
     }
 }
 
-static void setBearings(SonarData& sonar_data, uint32_t size, uint8_t const* buffer);
-static void setImage(SonarData& sonar_data, uint32_t image_offset, uint8_t const* buffer);
+static void checkHeaderSize(size_t header_size, size_t buffer_size);
 
-void Protocol::handleMessageSimplePingResult(uint8_t const* buffer, uint16_t version)
+void Protocol::handleMessageSimplePingResult(uint8_t const* buffer,
+    size_t buffer_size,
+    uint16_t version)
 {
-    m_simple_ping_result = true;
-
     uint32_t size = 0;
     uint32_t image_offset = 0;
 
     if (version == 2) {
         OculusSimplePingResult2 result;
         size = sizeof(OculusSimplePingResult2);
+        checkHeaderSize(size, buffer_size);
         memcpy(&result, buffer, size);
         m_data.image_size = result.imageSize;
         m_data.beam_count = result.nBeams;
         m_data.bin_count = result.nRanges;
         m_data.range = m_data.bin_count * result.rangeResolution;
         m_data.speed_of_sound = result.speedOfSoundUsed;
+        m_data.frequency = result.frequency;
+        m_data.salinity = result.fireMessage.salinity;
+        m_data.data_size = result.dataSize;
+        m_data.ping_start_time = result.pingStartTime;
+        m_data.ping_id = result.pingId;
+        memcpy(&m_data.fire_message,
+            &result.fireMessage,
+            sizeof(OculusSimpleFireMessage));
         image_offset = result.imageOffset;
     }
     else {
         OculusSimplePingResult result;
         size = sizeof(OculusSimplePingResult);
+        checkHeaderSize(size, buffer_size);
         memcpy(&result, buffer, size);
         m_data.image_size = result.imageSize;
         m_data.beam_count = result.nBeams;
         m_data.bin_count = result.nRanges;
         m_data.range = m_data.bin_count * result.rangeResolution;
         m_data.speed_of_sound = result.speedOfSoundUsed;
+        m_data.frequency = result.frequency;
+        m_data.salinity = result.fireMessage.salinity;
+        m_data.data_size = result.dataSize;
+        m_data.ping_start_time = base::unknown<double>();
+        m_data.ping_id = result.pingId;
+        m_data.fire_message = result.fireMessage;
         image_offset = result.imageOffset;
     }
+    m_data.has_ping_id = true;
+    m_data.has_fire_message = true;
+    m_data.image_offset = image_offset;
+    m_data.message_type = messageSimplePingResult;
+    setView(buffer, buffer_size, size);
+}
+
+void checkHeaderSize(size_t header_size, size_t buffer_size)
+{
+    if (buffer_size < header_size) {
+        throw std::runtime_error("ping result is smaller than its header");
+    }
+}
+
+static DataSizeType dataSizeFromImage(uint32_t image_size, uint32_t sample_count)
+{
+    if (sample_count == 0) {
+        return dataSize8Bit;
+    }
+    switch (image_size / sample_count) {
+        case 1:
+            return dataSize8Bit;
+        case 2:
+            return dataSize16Bit;
+        case 3:
+            return dataSize24Bit;
+        case 4:
+            return dataSize32Bit;
+        default:
+            throw std::runtime_error(
+                "cannot determine the sample size of the ping result image");
+    }
+}
+
+void Protocol::handleMessagePingResult(uint8_t const* buffer, size_t buffer_size)
+{
+    OculusReturnFireMessage result;
+    uint32_t size = sizeof(OculusReturnFireMessage);
+    checkHeaderSize(size, buffer_size);
+    memcpy(&result, buffer, size);
+    if (result.ping_params.nRangeLinesBfm > UINT16_MAX) {
+        throw std::runtime_error("ping result has too many range lines");
+    }
+    m_data.image_size = result.ping_params.imageSize;
+    m_data.beam_count = result.ping.nBeams;
+    m_data.bin_count = result.ping_params.nRangeLinesBfm;
+    m_data.range = result.ping.range;
+    m_data.speed_of_sound = m_speed_of_sound;
+    m_data.frequency = base::unknown<double>();
+    m_data.salinity = m_salinity;
+    m_data.ping_start_time = base::unknown<double>();
+    m_data.has_ping_id = false;
+    m_data.has_fire_message = false;
+    m_data.data_size = dataSizeFromImage(m_data.image_size,
+        static_cast<uint32_t>(m_data.beam_count) * m_data.bin_count);
+    m_data.image_offset = result.ping_params.imageOffset;
+    m_data.message_type = messagePingResult;
+    setView(buffer, buffer_size, size);
+}
+
+void Protocol::setView(uint8_t const* buffer, size_t buffer_size, uint32_t bearings_offset)
+{
+    m_has_ping = false;
+    if (m_data.data_size == dataSize24Bit) {
+        throw std::runtime_error("24 bit ping result images are not supported");
+    }
+    if (m_data.image_size < static_cast<uint32_t>(m_data.beam_count) *
+                                m_data.bin_count * sampleSize(m_data.data_size)) {
+        throw std::runtime_error("ping result image is smaller than nBeams * nRanges");
+    }
+    uint64_t bearings_end =
+        bearings_offset + static_cast<uint64_t>(m_data.beam_count) * sizeof(short);
+    if (bearings_end > buffer_size) {
+        throw std::runtime_error("ping result bearings extend past the end of the packet");
+    }
+    if (static_cast<uint64_t>(m_data.image_offset) + m_data.image_size > buffer_size) {
+        throw std::runtime_error("ping result image extends past the end of the packet");
+    }
 
-    setImage(m_data, image_offset, buffer);
-    setBearings(m_data, size, buffer);
+    memcpy(&m_ping.header, buffer, sizeof(OculusMessageHeader));
+    m_ping.bearings = buffer + bearings_offset;
+    m_ping.beam_count = m_data.beam_count;
+    m_ping.image = buffer + m_data.image_offset;
+    m_ping.image_size = m_data.image_size;
+    m_has_ping = true;
 }
 
-void setImage(SonarData& sonar_data, uint32_t image_offset, uint8_t const* buffer)
+uint32_t Protocol::sampleSize(DataSizeType data_size)
 {
-    sonar_data.image.resize(sonar_data.image_size);
-    std::memcpy(sonar_data.image.data(), buffer + image_offset, sonar_data.image_size);
+    switch (data_size) {
+        case dataSize8Bit:
+            return 1;
+        case dataSize16Bit:
+            return 2;
+        case dataSize24Bit:
+            return 3;
+        case dataSize32Bit:
+            return 4;
+        default:
+            throw std::runtime_error("invalid ping result data size");
+    }
+}
+
+PingView const& Protocol::getPingView() const
+{
+    return m_ping;
 }
 
-void setBearings(SonarData& sonar_data, uint32_t size, uint8_t const* buffer)
+OculusMessageType Protocol::getPingMessageType() const
 {
-    sonar_data.bearings.resize(sonar_data.beam_count);
-    std::memcpy(sonar_data.bearings.data(),
-        buffer + size,
-        sonar_data.beam_count * sizeof(short));
+    return m_data.message_type;
 }
 
-std::vector<base::Angle> getBearingsAngles(std::vector<short> const& bearings,
-    uint16_t beam_count);
+double Protocol::getPingStartTime() const
+{
+    return m_data.ping_start_time;
+}
+
+std::optional<uint32_t> Protocol::getPingId() const
+{
+    if (!m_data.has_ping_id) {
+        return std::nullopt;
+    }
+    return m_data.ping_id;
+}
+
+std::optional<OculusSimpleFireMessage> Protocol::getFireMessage() const
+{
+    if (!m_data.has_fire_message) {
+        return std::nullopt;
+    }
+    return m_data.fire_message;
+}
+
+void Protocol::setSpeedOfSound(double speed_of_sound)
+{
+    m_speed_of_sound = speed_of_sound;
+}
+
+void Protocol::setSalinity(double salinity)
+{
+    m_salinity = salinity;
+}
 
 base::samples::Sonar Protocol::parseSonar(base::Angle const& beam_width,
     base::Angle const& beam_height)
 {
-    if (!m_simple_ping_result) {
-        throw std::runtime_error("OculusReturnFireMessage parse is not implemented");
+    base::samples::Sonar sonar;
+    parseSonar(sonar, beam_width, beam_height);
+    return sonar;
+}
+
+void Protocol::setDecodeRegion(DecodeRegion const& region)
+{
+    m_region = region;
+}
+
+DecodeRegion Protocol::getDecodeRegion() const
+{
+    return m_region;
+}
+
+void Protocol::setGainCompensation(GainCompensation const& compensation)
+{
+    m_gain_compensation = compensation;
+}
+
+GainCompensation Protocol::getGainCompensation() const
+{
+    return m_gain_compensation;
+}
+
+uint64_t Protocol::getGainTableBuilds() const
+{
+    return m_gain_table.getTableBuilds();
+}
+
+void Protocol::setIntensityLUT(IntensityLUT const& lut)
+{
+    m_intensity_lut = lut;
+}
+
+IntensityLUT const& Protocol::getIntensityLUT() const
+{
+    return m_intensity_lut;
+}
+
+float const* Protocol::windowGains(TransposeWindow const& window)
+{
+    if (!m_gain_compensation.enabled || m_data.bin_count == 0) {
+        return nullptr;
+    }
+    double range_resolution = m_data.range / m_data.bin_count * window.bin_step;
+    return m_gain_table.get(m_gain_compensation,
+        range_resolution,
+        window.outputBinCount(),
+        m_data.frequency,
+        m_data.salinity);
+}
+
+TransposeWindow Protocol::decodeWindow() const
+{
+    TransposeWindow window;
+    window.bin_end = m_data.bin_count;
+    window.beam_end = m_data.beam_count;
+    if (m_region.isFull()) {
+        return window;
+    }
+
+    if (m_data.bin_count != 0) {
+        // Keep the bins that start within [min_range, max_range). The
+        // tolerance avoids losing a bin to rounding when a range is given
+        // as a multiple of the bin length
+        static const double TOLERANCE = 1e-6;
+        double bin_length = m_data.range / m_data.bin_count;
+        if (m_region.min_range > 0) {
+            window.bin_begin = std::min<double>(
+                std::floor(m_region.min_range / bin_length + TOLERANCE),
+                m_data.bin_count);
+        }
+        if (!base::isUnknown(m_region.max_range)) {
+            window.bin_end = std::max<double>(0,
+                std::min<double>(std::ceil(m_region.max_range / bin_length - TOLERANCE),
+                    m_data.bin_count));
+        }
+    }
+    window.beam_begin = std::min(m_region.first_beam, m_data.beam_count);
+    if (m_region.beam_count != 0) {
+        window.beam_end = std::min<int>(window.beam_begin + m_region.beam_count,
+            m_data.beam_count);
+    }
+    window.bin_step = std::max<uint16_t>(m_region.range_decimation, 1);
+    window.beam_step = std::max<uint16_t>(m_region.beam_decimation, 1);
+    window.pooling = m_region.pooling;
+    return window;
+}
+
+void Protocol::windowBearings(std::vector<base::Angle>& bearings,
+    TransposeWindow const& window)
+{
+    auto const& all = *m_bearing_cache.get(m_ping);
+    bearings.resize(window.outputBeamCount());
+    for (size_t j = 0; j < bearings.size(); j++) {
+        int b0 = window.beam_begin + j * window.beam_step;
+        int b1 = std::min<int>(b0 + window.beam_step, window.beam_end);
+        double sum = 0;
+        for (int b = b0; b < b1; b++) {
+            sum += all[b].getRad();
+        }
+        bearings[j] = base::Angle::fromRad(sum / (b1 - b0));
+    }
+}
+
+template <typename Sample>
+void Protocol::parseMetadata(Sample& sonar,
+    base::Angle const& beam_width,
+    base::Angle const& beam_height,
+    TransposeWindow const& window)
+{
+    if (!m_has_ping) {
+        throw std::runtime_error("parseSonar called before any ping result was received");
+    }
+
+    sonar.time = base::Time::now();
+    sonar.bin_duration = binDuration(m_data.range * window.bin_step,
+        m_data.speed_of_sound,
+        m_data.bin_count);
+    sonar.beam_width = beam_width;
+    sonar.beam_height = beam_height;
+    sonar.speed_of_sound = m_data.speed_of_sound;
+    sonar.bin_count = window.outputBinCount();
+    sonar.beam_count = window.outputBeamCount();
+}
+
+template <typename Sample>
+static void convertImage(uint8_t const* image,
+    float* bins,
+    SonarData const& data,
+    TransposeWindow const* window,
+    float const* gains,
+    float const* table,
+    double factor);
+template <typename Sample>
+static void convertImage(uint8_t const* image,
+    uint8_t* bins,
+    SonarData const& data,
+    TransposeWindow const* window);
+
+void Protocol::parseSonar(base::samples::Sonar& sonar,
+    base::Angle const& beam_width,
+    base::Angle const& beam_height)
+{
+    TransposeWindow window = decodeWindow();
+    TransposeWindow const* region = m_region.isFull() ? nullptr : &window;
+    parseMetadata(sonar, beam_width, beam_height, window);
+    float const* gains = windowGains(window);
+    float const* table = m_intensity_lut.isLinear() ? nullptr : m_intensity_lut.data();
+    sonar.timestamps.clear();
+    sonar.bins.resize(sonar.beam_count * sonar.bin_count);
+    switch (m_data.data_size) {
+        case dataSize16Bit:
+            convertImage<uint16_t>(m_ping.image,
+                sonar.bins.data(),
+                m_data,
+                region,
+                gains,
+                table,
+                NORMALIZATION_FACTOR_16BIT);
+            break;
+        case dataSize32Bit:
+            convertImage<uint32_t>(m_ping.image,
+                sonar.bins.data(),
+                m_data,
+                region,
+                gains,
+                table,
+                NORMALIZATION_FACTOR_32BIT);
+            break;
+        default:
+            convertImage<uint8_t>(m_ping.image,
+                sonar.bins.data(),
+                m_data,
+                region,
+                gains,
+                table,
+                NORMALIZATION_FACTOR);
+    }
+    if (region) {
+        windowBearings(sonar.bearings, window);
+    }
+    else {
+        sonar.bearings = *m_bearing_cache.get(m_ping);
     }
+}
 
-    auto bin_duration =
-        binDuration(m_data.range, m_data.speed_of_sound, m_data.bin_count);
-    base::samples::Sonar sonar(base::Time::now(),
-        bin_duration,
-        m_data.bin_count,
-        beam_width,
-        beam_height,
-        m_data.beam_count,
-        false);
-    sonar.bins = toBeamMajor(m_data.image, m_data.beam_count, m_data.bin_count);
-    normalizeBins(sonar.bins);
-    sonar.bearings = getBearingsAngles(m_data.bearings, m_data.beam_count);
+void Protocol::parseSonar(CompactSonar& sonar,
+    base::Angle const& beam_width,
+    base::Angle const& beam_height)
+{
+    TransposeWindow window = decodeWindow();
+    TransposeWindow const* region = m_region.isFull() ? nullptr : &window;
+    parseMetadata(sonar, beam_width, beam_height, window);
+    float const* gains = windowGains(window);
+    if (gains) {
+        sonar.gains.assign(gains, gains + sonar.bin_count);
+    }
+    else {
+        sonar.gains.clear();
+    }
+    sonar.bins.resize(sonar.beam_count * sonar.bin_count);
+    switch (m_data.data_size) {
+        case dataSize16Bit:
+            convertImage<uint16_t>(m_ping.image, sonar.bins.data(), m_data, region);
+            sonar.scale = 256 * NORMALIZATION_FACTOR_16BIT;
+            break;
+        case dataSize32Bit:
+            convertImage<uint32_t>(m_ping.image, sonar.bins.data(), m_data, region);
+            sonar.scale = 16777216.0 * NORMALIZATION_FACTOR_32BIT;
+            break;
+        default:
+            convertImage<uint8_t>(m_ping.image, sonar.bins.data(), m_data, region);
+            sonar.scale = NORMALIZATION_FACTOR;
+    }
+    if (region) {
+        windowBearings(sonar.bearings, window);
+    }
+    else {
+        sonar.bearings = *m_bearing_cache.get(m_ping);
+    }
+}
 
-    return sonar;
+/**
+ * Convert the whole image, or only a window of it if one is given. The
+ * samples are mapped through the table if one is given, and normalized with
+ * the factor otherwise
+ */
+template <typename Sample>
+void convertImage(uint8_t const* image,
+    float* bins,
+    SonarData const& data,
+    TransposeWindow const* window,
+    float const* gains,
+    float const* table,
+    double factor)
+{
+    if (table && window) {
+        transposeWindowLookup<Sample>(image,
+            bins,
+            data.beam_count,
+            data.bin_count,
+            *window,
+            table,
+            gains);
+    }
+    else if (table) {
+        transposeLookup<Sample>(image,
+            bins,
+            data.beam_count,
+            data.bin_count,
+            table,
+            bestTransposeKernel(),
+            gains);
+    }
+    else if (window) {
+        transposeWindow<Sample>(image,
+            bins,
+            data.beam_count,
+            data.bin_count,
+            *window,
+            factor,
+            gains);
+    }
+    else {
+        transposeNormalize<Sample>(image,
+            bins,
+            data.beam_count,
+            data.bin_count,
+            factor,
+            bestTransposeKernel(),
+            gains);
+    }
+}
+
+template <typename Sample>
+void convertImage(uint8_t const* image,
+    uint8_t* bins,
+    SonarData const& data,
+    TransposeWindow const* window)
+{
+    if (window) {
+        transposeWindowBytes<Sample>(image, bins, data.beam_count, data.bin_count, *window);
+    }
+    else {
+        transposeBytes<Sample>(image, bins, data.beam_count, data.bin_count);
+    }
 }
 
 base::Time Protocol::binDuration(double range, double speed_of_sound, int bin_count)
@@ -124,13 +538,7 @@ void Protocol::normalizeBins(std::vector<float>& bins)
     }
 }
 
-std::vector<base::Angle> getBearingsAngles(std::vector<short> const& bearings,
-    uint16_t beam_count)
+BearingCacheStatistics Protocol::getBearingCacheStatistics() const
 {
-    std::vector<base::Angle> bearings_angles(beam_count);
-    for (size_t i = 0; i < beam_count; i++) {
-        bearings_angles[i] =
-            base::Angle::fromDeg(static_cast<double>(-bearings[i]) / 100);
-    }
-    return bearings_angles;
-}
\ No newline at end of file
+    return m_bearing_cache.getStatistics();
+}
@@ -2,16 +2,152 @@
 #define SONAR_OCULUS_M750D_PROTOCOL_HPP
 
 #include <base/samples/Sonar.hpp>
+#include <optional>
+#include <sonar_oculus_m750d/BearingCache.hpp>
+#include <sonar_oculus_m750d/CompactSonar.hpp>
+#include <sonar_oculus_m750d/DecodeRegion.hpp>
+#include <sonar_oculus_m750d/GainCompensation.hpp>
+#include <sonar_oculus_m750d/IntensityLUT.hpp>
+#include <sonar_oculus_m750d/Normalization.hpp>
+#include <sonar_oculus_m750d/PingView.hpp>
 #include <sonar_oculus_m750d/SonarData.hpp>
 #include <stdio.h>
 
 namespace sonar_oculus_m750d {
     class Protocol {
     public:
-        static constexpr double NORMALIZATION_FACTOR = 1.0 / 255;
-        bool handleBuffer(uint8_t const* buffer);
+        static constexpr double NORMALIZATION_FACTOR = NORMALIZATION_FACTOR_8BIT;
+        static constexpr double NORMALIZATION_FACTOR_16BIT = 1.0 / 65535;
+        static constexpr double NORMALIZATION_FACTOR_32BIT = 1.0 / 4294967295.0;
+        static constexpr double DEFAULT_SPEED_OF_SOUND = 1500;
+        /**
+         * @brief Decode a message
+         *
+         * Both the simple (messageSimplePingResult) and the full
+         * (messagePingResult) ping results are handled. They are not copied:
+         * the protocol keeps a view on the buffer, which must therefore stay
+         * valid and unchanged until parseSonar is called
+         *
+         * @param size the size of the message. The bearings and image of a
+         *   ping result must lie within it
+         * @return true if the message was a ping result
+         * @throw std::runtime_error if the message is inconsistent
+         */
+        bool handleBuffer(uint8_t const* buffer, size_t size);
         base::samples::Sonar parseSonar(base::Angle const& beam_width,
             base::Angle const& beam_height);
+        /**
+         * @brief Convert the last ping into a caller-owned sample
+         *
+         * The capacity already allocated in the sample is reused, so that
+         * converting pings of the same size does not allocate
+         *
+         * The sample is stamped with the current time. See
+         * Driver::processOne for timestamps based on the ping time.
+         */
+        void parseSonar(base::samples::Sonar& sonar,
+            base::Angle const& beam_width,
+            base::Angle const& beam_height);
+        /**
+         * @brief Convert the last ping into a compact, byte-per-bin sample
+         *
+         * The image is only transposed, not widened. 16 and 32 bit images are
+         * reduced to their most significant byte, with the scale set so that
+         * CompactSonar::toSonar gives values in the same 0 to 1 range than
+         * parseSonar.
+         */
+        void parseSonar(CompactSonar& sonar,
+            base::Angle const& beam_width,
+            base::Angle const& beam_height);
+        /**
+         * @brief The view on the last ping handled by handleBuffer
+         */
+        PingView const& getPingView() const;
+        /**
+         * @brief The message the last ping was decoded from
+         *
+         * Either messageSimplePingResult or messagePingResult
+         */
+        OculusMessageType getPingMessageType() const;
+        /**
+         * @brief The device time of the last ping, in seconds since power-up
+         *
+         * Unknown (NaN) if the message the ping was decoded from does not
+         * report it
+         */
+        double getPingStartTime() const;
+        /**
+         * @brief The ping counter of the last ping, if the message reports it
+         */
+        std::optional<uint32_t> getPingId() const;
+        /**
+         * @brief The fire message echoed by the last ping, if the message
+         * reports it
+         *
+         * This is the configuration the sonar used for the ping, which may
+         * lag behind the one last sent after a reconfiguration
+         */
+        std::optional<OculusSimpleFireMessage> getFireMessage() const;
+        /**
+         * @brief Set the speed of sound used to interpret full ping results
+         *
+         * Unlike the simple ping results, messagePingResult does not report
+         * the speed of sound used by the sonar. The driver sets it to the one
+         * it last configured. Defaults to DEFAULT_SPEED_OF_SOUND
+         */
+        void setSpeedOfSound(double speed_of_sound);
+        /**
+         * @brief Set the salinity used by the gain compensation of full ping
+         * results
+         *
+         * The simple ping results echo the salinity the sonar was configured
+         * with. The driver sets this to the one it last configured
+         */
+        void setSalinity(double salinity);
+        /**
+         * @brief Restrict parseSonar to a part of the pings, and decimate it
+         *
+         * The samples outside of the region are never converted. The bin
+         * duration and bearings of the output samples are adjusted to the
+         * decimation: a pooled beam has the mean bearing of the beams it
+         * pools.
+         */
+        void setDecodeRegion(DecodeRegion const& region);
+        DecodeRegion getDecodeRegion() const;
+        /**
+         * @brief Compensate the transmission loss while converting the pings
+         *
+         * The per-bin gains are applied within the conversion, after the
+         * decimation. They are computed from the range resolution, bin count,
+         * frequency and salinity of the pings, and only recomputed when one
+         * of them changes.
+         *
+         * Compact samples keep the raw bytes, and carry the gains for
+         * CompactSonar::toSonar to apply them
+         */
+        void setGainCompensation(GainCompensation const& compensation);
+        GainCompensation getGainCompensation() const;
+        /**
+         * @brief How many times the gains had to be computed
+         */
+        uint64_t getGainTableBuilds() const;
+        /**
+         * @brief Map the samples through an intensity curve while converting
+         * them
+         *
+         * The table replaces the normalization of parseSonar. With the
+         * default, linear, table, the conversion is unchanged. Images with
+         * wider samples are interpolated between the table entries.
+         *
+         * Compact samples keep the raw bytes
+         */
+        void setIntensityLUT(IntensityLUT const& lut);
+        IntensityLUT const& getIntensityLUT() const;
+        /**
+         * @brief How often parseSonar could reuse an already converted bearing
+         * table
+         */
+        BearingCacheStatistics getBearingCacheStatistics() const;
         /**
          * @brief Rearrange the sonar data in beam major order
          *
@@ -23,13 +159,46 @@ namespace sonar_oculus_m750d {
         static std::vector<float> toBeamMajor(std::vector<uint8_t> const& bin_first,
             uint16_t beam_count,
             uint16_t bin_count);
+        /**
+         * @brief Scale the bins by NORMALIZATION_FACTOR
+         *
+         * Together with toBeamMajor, this is the reference for the single pass
+         * conversion done by transposeNormalize
+         */
+        static void normalizeBins(std::vector<float>& bins);
         static base::Time binDuration(double range, double speed_of_sound, int bin_count);
+        /**
+         * @brief The size in bytes of one image sample
+         */
+        static uint32_t sampleSize(DataSizeType data_size);
 
     private:
-        void handleMessageSimplePingResult(uint8_t const* buffer, uint16_t version);
-        void normalizeBins(std::vector<float>& bins);
+        void handleMessageSimplePingResult(uint8_t const* buffer,
+            size_t buffer_size,
+            uint16_t version);
+        void handleMessagePingResult(uint8_t const* buffer, size_t buffer_size);
+        void setView(uint8_t const* buffer, size_t buffer_size, uint32_t bearings_offset);
+        TransposeWindow decodeWindow() const;
+        /** The gains of the output bins of the window, or null if the gain
+         * compensation is disabled */
+        float const* windowGains(TransposeWindow const& window);
+        void windowBearings(std::vector<base::Angle>& bearings,
+            TransposeWindow const& window);
+        template <typename Sample>
+        void parseMetadata(Sample& sonar,
+            base::Angle const& beam_width,
+            base::Angle const& beam_height,
+            TransposeWindow const& window);
         SonarData m_data;
-        bool m_simple_ping_result = false;
+        PingView m_ping;
+        BearingCache m_bearing_cache;
+        double m_speed_of_sound = DEFAULT_SPEED_OF_SOUND;
+        double m_salinity = base::unknown<double>();
+        DecodeRegion m_region;
+        GainCompensation m_gain_compensation;
+        GainTable m_gain_table;
+        IntensityLUT m_intensity_lut;
+        bool m_has_ping = false;
     };
 }
 
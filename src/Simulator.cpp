@@ -0,0 +1,425 @@
+#include "Simulator.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+
+/** How often the simulator checks whether it should stop */
+static const base::Time POLL_PERIOD = base::Time::fromMilliseconds(50);
+/** Aperture of the M750d, in hundredths of degree */
+static const int APERTURE = 13000;
+
+struct Simulator::Session {
+    int client;
+    OculusSimpleFireMessage2 fire_message;
+    bool fired = false;
+    uint32_t ping_id = 0;
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> packet;
+};
+
+Simulator::Simulator(SimulatorConfiguration const& configuration)
+    : m_configuration(configuration)
+    , m_random(configuration.seed)
+{
+}
+
+Simulator::~Simulator()
+{
+    stop();
+}
+
+void Simulator::start()
+{
+    if (m_running) {
+        return;
+    }
+
+    m_server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_server < 0) {
+        throw std::runtime_error(std::string("simulator: cannot create socket: ") +
+                                 strerror(errno));
+    }
+    int enable = 1;
+    setsockopt(m_server, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(m_configuration.port);
+    if (bind(m_server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(m_server, 1) != 0) {
+        std::string error = strerror(errno);
+        close(m_server);
+        m_server = -1;
+        throw std::runtime_error("simulator: cannot listen on port " +
+                                 std::to_string(m_configuration.port) + ": " + error);
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(m_server, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+    m_start_time = base::Time::now();
+    m_running = true;
+    m_thread = std::thread(&Simulator::run, this);
+}
+
+void Simulator::stop()
+{
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_server >= 0) {
+        close(m_server);
+        m_server = -1;
+    }
+}
+
+bool Simulator::isRunning() const
+{
+    return m_running;
+}
+
+uint16_t Simulator::getPort() const
+{
+    return m_port;
+}
+
+SimulatorStatistics Simulator::getStatistics() const
+{
+    SimulatorStatistics stats;
+    stats.connections = m_connections;
+    stats.fire_messages_received = m_fire_messages_received;
+    stats.pings_sent = m_pings_sent;
+    stats.bytes_sent = m_bytes_sent;
+    stats.corruptions = m_corruptions;
+    stats.stalls = m_stalls;
+    return stats;
+}
+
+void Simulator::run()
+{
+    while (m_running) {
+        pollfd fd{m_server, POLLIN, 0};
+        if (poll(&fd, 1, POLL_PERIOD.toMilliseconds()) <= 0) {
+            continue;
+        }
+        int client = accept4(m_server, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+        int enable = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        m_connections++;
+        serve(client);
+        close(client);
+    }
+}
+
+void Simulator::serve(int client)
+{
+    Session session;
+    session.client = client;
+    memset(&session.fire_message, 0, sizeof(session.fire_message));
+    session.fire_message.head.oculusId = OCULUS_CHECK_ID;
+    session.fire_message.head.msgId = messageSimpleFire;
+    session.fire_message.masterMode = 2;
+    session.fire_message.pingRate = pingRateNormal;
+    session.fire_message.flags = 0x01 | 0x08 | 0x40;
+    if (m_configuration.data_size == dataSize16Bit) {
+        session.fire_message.flags |= 0x02;
+    }
+    session.fire_message.range = m_configuration.range;
+    session.fire_message.speedOfSound = 1500;
+
+    base::Time next_ping = base::Time::now();
+    while (m_running) {
+        bool streaming = (session.fired || !m_configuration.wait_for_fire) &&
+                         session.fire_message.pingRate != pingRateStandby;
+        base::Time now = base::Time::now();
+        if (streaming && now >= next_ping) {
+            if (!sendPing(session)) {
+                return;
+            }
+            base::Time period = pingPeriod(session);
+            next_ping = next_ping + period;
+            now = base::Time::now();
+            if (next_ping < now) {
+                // Too late, do not try to catch up
+                next_ping = now + period;
+            }
+        }
+
+        base::Time wait = POLL_PERIOD;
+        if (streaming) {
+            wait = std::min(wait, std::max(next_ping - now, base::Time()));
+        }
+        pollfd fd{client, POLLIN, 0};
+        int ret = poll(&fd, 1, std::ceil(wait.toMicroseconds() / 1000.0));
+        if (ret > 0) {
+            if (!handleReceived(session)) {
+                return;
+            }
+            if (session.fired) {
+                next_ping = std::min(next_ping, base::Time::now());
+            }
+        }
+    }
+}
+
+bool Simulator::handleReceived(Session& session)
+{
+    uint8_t buffer[4096];
+    ssize_t size = recv(session.client, buffer, sizeof(buffer), 0);
+    if (size <= 0) {
+        return false;
+    }
+    session.received.insert(session.received.end(), buffer, buffer + size);
+
+    size_t offset = 0;
+    while (session.received.size() - offset >= sizeof(OculusMessageHeader)) {
+        OculusMessageHeader header;
+        memcpy(&header, session.received.data() + offset, sizeof(header));
+        if (header.oculusId != OCULUS_CHECK_ID) {
+            offset++;
+            continue;
+        }
+
+        // The driver sends fire messages with a zero payload size, the
+        // fire message fields follow the header nonetheless
+        size_t message_size = sizeof(header) + header.payloadSize;
+        if (header.msgId == messageSimpleFire) {
+            message_size = std::max(message_size, sizeof(OculusSimpleFireMessage));
+        }
+        if (session.received.size() - offset < message_size) {
+            break;
+        }
+        if (header.msgId == messageSimpleFire) {
+            size_t copy = std::min(message_size, sizeof(OculusSimpleFireMessage2));
+            memset(&session.fire_message, 0, sizeof(session.fire_message));
+            memcpy(&session.fire_message, session.received.data() + offset, copy);
+            session.fired = true;
+            m_fire_messages_received++;
+        }
+        offset += message_size;
+    }
+    session.received.erase(session.received.begin(), session.received.begin() + offset);
+    return true;
+}
+
+base::Time Simulator::pingPeriod(Session const& session) const
+{
+    if (m_configuration.ping_rate > 0) {
+        return base::Time::fromSeconds(1 / m_configuration.ping_rate);
+    }
+    switch (session.fire_message.pingRate) {
+        case pingRateHigh:
+            return base::Time::fromSeconds(1.0 / 15);
+        case pingRateHighest:
+            return base::Time::fromSeconds(1.0 / 40);
+        case pingRateLow:
+            return base::Time::fromSeconds(1.0 / 5);
+        case pingRateLowest:
+            return base::Time::fromSeconds(1.0 / 2);
+        default:
+            return base::Time::fromSeconds(1.0 / 10);
+    }
+}
+
+bool Simulator::sendPing(Session& session)
+{
+    auto const& fire = session.fire_message;
+    double range = fire.range > 0 ? fire.range : m_configuration.range;
+    uint16_t bin_count = std::max(1.0, std::round(range / m_configuration.range_resolution));
+    DataSizeType data_size = (fire.flags & 0x02) ? dataSize16Bit : m_configuration.data_size;
+    double ping_start_time = (base::Time::now() - m_start_time).toSeconds();
+
+    buildPing(session.packet,
+        fire,
+        m_configuration.beam_count,
+        bin_count,
+        m_configuration.range_resolution,
+        data_size,
+        session.ping_id++,
+        ping_start_time);
+    OculusMessageHeader header;
+    memcpy(&header, session.packet.data(), sizeof(header));
+    header.srcDeviceId = m_configuration.device_id;
+    memcpy(session.packet.data(), &header, sizeof(header));
+    if (!sendPacket(session.client, session.packet)) {
+        return false;
+    }
+    m_pings_sent++;
+    return true;
+}
+
+bool Simulator::sendPacket(int client, std::vector<uint8_t>& packet)
+{
+    std::uniform_real_distribution<double> probability(0, 1);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    if (probability(m_random) < m_configuration.corruption_probability) {
+        m_corruptions++;
+        if (probability(m_random) < 0.5) {
+            std::vector<uint8_t> garbage(
+                std::uniform_int_distribution<size_t>(1, 4096)(m_random));
+            for (auto& b : garbage) {
+                b = byte(m_random);
+            }
+            if (!sendBytes(client, garbage.data(), garbage.size())) {
+                return false;
+            }
+        }
+        else {
+            std::uniform_int_distribution<size_t> position(0, packet.size() - 1);
+            for (int i = 0; i < 8; i++) {
+                packet[position(m_random)] = byte(m_random);
+            }
+        }
+    }
+
+    size_t stall_at = packet.size();
+    if (probability(m_random) < m_configuration.stall_probability) {
+        stall_at = std::uniform_int_distribution<size_t>(0, packet.size() - 1)(m_random);
+    }
+
+    size_t fragment_size = m_configuration.max_fragment_size;
+    if (fragment_size == 0) {
+        fragment_size = packet.size();
+    }
+    size_t offset = 0;
+    while (offset < packet.size()) {
+        size_t size = std::uniform_int_distribution<size_t>(1, fragment_size)(m_random);
+        size = std::min(size, packet.size() - offset);
+        if (offset <= stall_at && stall_at < offset + size) {
+            size = stall_at - offset;
+            if (!sendBytes(client, packet.data() + offset, size)) {
+                return false;
+            }
+            offset += size;
+            m_stalls++;
+            usleep(m_configuration.stall_duration.toMicroseconds());
+            stall_at = packet.size();
+            continue;
+        }
+
+        if (!sendBytes(client, packet.data() + offset, size)) {
+            return false;
+        }
+        offset += size;
+        if (!m_configuration.fragment_delay.isNull() && offset < packet.size()) {
+            usleep(m_configuration.fragment_delay.toMicroseconds());
+        }
+    }
+    return true;
+}
+
+bool Simulator::sendBytes(int client, uint8_t const* data, size_t size)
+{
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t ret = send(client, data + sent, size - sent, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += ret;
+    }
+    m_bytes_sent += size;
+    return true;
+}
+
+static uint32_t sampleSize(DataSizeType data_size);
+
+void Simulator::buildPing(std::vector<uint8_t>& packet,
+    OculusSimpleFireMessage2 const& fire_message,
+    uint16_t beam_count,
+    uint16_t bin_count,
+    double range_resolution,
+    DataSizeType data_size,
+    uint32_t ping_id,
+    double ping_start_time)
+{
+    uint32_t sample_size = sampleSize(data_size);
+    uint32_t image_offset = sizeof(OculusSimplePingResult2) + beam_count * sizeof(short);
+    uint32_t image_size = static_cast<uint32_t>(beam_count) * bin_count * sample_size;
+    packet.resize(image_offset + image_size);
+
+    OculusSimplePingResult2 result;
+    memset(&result, 0, sizeof(result));
+    result.fireMessage = fire_message;
+    result.fireMessage.head.oculusId = OCULUS_CHECK_ID;
+    result.fireMessage.head.msgId = messageSimplePingResult;
+    result.fireMessage.head.msgVersion = 2;
+    result.fireMessage.head.partNumber = partNumberM750d;
+    result.fireMessage.head.payloadSize = packet.size() - sizeof(OculusMessageHeader);
+    result.pingId = ping_id;
+    result.frequency = fire_message.masterMode == 1 ? 750e3 : 1.2e6;
+    result.temperature = 15;
+    result.speedOfSoundUsed =
+        fire_message.speedOfSound > 0 ? fire_message.speedOfSound : 1500;
+    result.pingStartTime = ping_start_time;
+    result.dataSize = data_size;
+    result.rangeResolution = range_resolution;
+    result.nRanges = bin_count;
+    result.nBeams = beam_count;
+    result.imageOffset = image_offset;
+    result.imageSize = image_size;
+    result.messageSize = packet.size();
+    memcpy(packet.data(), &result, sizeof(result));
+
+    uint8_t* bearings = packet.data() + sizeof(OculusSimplePingResult2);
+    for (int beam = 0; beam < beam_count; beam++) {
+        short bearing = beam_count > 1
+                            ? -APERTURE / 2 + APERTURE * beam / (beam_count - 1)
+                            : 0;
+        memcpy(bearings + beam * sizeof(short), &bearing, sizeof(short));
+    }
+
+    // A bright arc that moves with the ping ID over a speckle-like texture,
+    // so that consecutive images differ
+    uint8_t* image = packet.data() + image_offset;
+    uint32_t max_value = sample_size == 1 ? 0xff : 0xffff;
+    uint16_t arc = bin_count > 0 ? (ping_id * 7) % bin_count : 0;
+    for (int bin = 0; bin < bin_count; bin++) {
+        for (int beam = 0; beam < beam_count; beam++) {
+            uint32_t value = ((bin * 131 + beam * 31 + ping_id) % 64) * max_value / 255;
+            if (bin == arc) {
+                value = max_value;
+            }
+            uint8_t* sample = image + (static_cast<size_t>(bin) * beam_count + beam) * sample_size;
+            if (sample_size == 1) {
+                *sample = value;
+            }
+            else {
+                uint16_t value16 = value;
+                memcpy(sample, &value16, sizeof(value16));
+            }
+        }
+    }
+}
+
+uint32_t sampleSize(DataSizeType data_size)
+{
+    switch (data_size) {
+        case dataSize8Bit:
+            return 1;
+        case dataSize16Bit:
+            return 2;
+        default:
+            throw std::invalid_argument("the simulator only generates 8 and 16 bit images");
+    }
+}
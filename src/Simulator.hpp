@@ -0,0 +1,160 @@
+#ifndef SONAR_OCULUS_M750D_SIMULATOR_HPP
+#define SONAR_OCULUS_M750D_SIMULATOR_HPP
+
+#include <atomic>
+#include <base/Time.hpp>
+#include <cstdint>
+#include <random>
+#include <sonar_oculus_m750d/Oculus.h>
+#include <thread>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    struct SimulatorConfiguration {
+        /**
+         * @brief The TCP port to listen on. Zero picks a free port, see
+         * Simulator::getPort
+         */
+        uint16_t port = 0;
+        /**
+         * @brief Number of beams, 256 or 512
+         */
+        uint16_t beam_count = 512;
+        /**
+         * @brief Range used until a fire message sets it, in meters
+         */
+        double range = 40;
+        /**
+         * @brief Size of a range line, in meters. It determines the bin count
+         */
+        double range_resolution = 0.08;
+        /**
+         * @brief Sample size, unless the fire message requests 16 bit data
+         */
+        DataSizeType data_size = dataSize8Bit;
+        /**
+         * @brief Ping rate in Hz. If zero, the rate requested by the fire
+         * message is used (10Hz until one is received)
+         *
+         * Unlike the rates of the device, it is not limited to 40Hz
+         */
+        double ping_rate = 0;
+        /**
+         * @brief Whether pings are only sent once a fire message was received
+         */
+        bool wait_for_fire = true;
+        /**
+         * @brief The source device ID stamped on the pings
+         */
+        uint16_t device_id = 0;
+
+        /**
+         * @brief If non-zero, packets are sent in fragments of at most this
+         * many bytes, each with its own send() call
+         */
+        size_t max_fragment_size = 0;
+        /**
+         * @brief Delay between two fragments
+         */
+        base::Time fragment_delay;
+        /**
+         * @brief Probability that a packet is corrupted
+         *
+         * A corrupted packet either has random bytes overwritten, or is
+         * preceded by random garbage
+         */
+        double corruption_probability = 0;
+        /**
+         * @brief Probability that the stream stalls in the middle of a packet
+         */
+        double stall_probability = 0;
+        base::Time stall_duration = base::Time::fromMilliseconds(500);
+        /**
+         * @brief Seed of the random generator behind fragmentation,
+         * corruption and stalls
+         */
+        uint32_t seed = 0;
+    };
+
+    struct SimulatorStatistics {
+        uint64_t connections = 0;
+        uint64_t fire_messages_received = 0;
+        uint64_t pings_sent = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t corruptions = 0;
+        uint64_t stalls = 0;
+    };
+
+    /**
+     * @brief Simulated Oculus M750d, for load and soak testing of the driver
+     *
+     * It listens on a local TCP port, accepts one client at a time, decodes
+     * its fire messages and streams synthetic OculusSimplePingResult2
+     * packets. It runs in its own thread.
+     */
+    class Simulator {
+    public:
+        explicit Simulator(SimulatorConfiguration const& configuration);
+        ~Simulator();
+        Simulator(Simulator const&) = delete;
+        Simulator& operator=(Simulator const&) = delete;
+
+        /**
+         * @brief Start listening, and serve clients in a background thread
+         */
+        void start();
+        void stop();
+        bool isRunning() const;
+        /**
+         * @brief The port the simulator listens on, valid after start()
+         */
+        uint16_t getPort() const;
+
+        SimulatorStatistics getStatistics() const;
+
+        /**
+         * @brief Build a ping result packet
+         *
+         * Exposed for the tests and benchmarks that need realistic packets
+         * without a socket
+         *
+         * @param packet the packet, resized as needed
+         */
+        static void buildPing(std::vector<uint8_t>& packet,
+            OculusSimpleFireMessage2 const& fire_message,
+            uint16_t beam_count,
+            uint16_t bin_count,
+            double range_resolution,
+            DataSizeType data_size,
+            uint32_t ping_id,
+            double ping_start_time);
+
+    private:
+        struct Session;
+
+        void run();
+        void serve(int client);
+        bool handleReceived(Session& session);
+        bool sendPing(Session& session);
+        bool sendPacket(int client, std::vector<uint8_t>& packet);
+        bool sendBytes(int client, uint8_t const* data, size_t size);
+        base::Time pingPeriod(Session const& session) const;
+
+        SimulatorConfiguration m_configuration;
+        int m_server = -1;
+        uint16_t m_port = 0;
+        std::atomic<bool> m_running{false};
+        std::thread m_thread;
+        std::mt19937 m_random;
+        base::Time m_start_time;
+
+        std::atomic<uint64_t> m_connections{0};
+        std::atomic<uint64_t> m_fire_messages_received{0};
+        std::atomic<uint64_t> m_pings_sent{0};
+        std::atomic<uint64_t> m_bytes_sent{0};
+        std::atomic<uint64_t> m_corruptions{0};
+        std::atomic<uint64_t> m_stalls{0};
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_SIMULATOR_HPP
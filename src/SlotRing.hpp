@@ -0,0 +1,196 @@
+#ifndef SONAR_OCULUS_M750D_SLOTRING_HPP
+#define SONAR_OCULUS_M750D_SLOTRING_HPP
+
+#include <base/Time.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief Bounded single-producer single-consumer queue of preallocated
+     * slots, dropping the oldest element when full
+     *
+     * Elements are never copied: the producer fills the slot it owns
+     * (writeSlot) and publishes it, the consumer acquires the oldest published
+     * slot, uses it in place and releases it. Slots are reused, so that their
+     * content (e.g. vector capacity) survives from one use to the next.
+     *
+     * The queue holds depth published slots, plus the one being filled by the
+     * producer and the one being used by the consumer. Only slot indices are
+     * exchanged under the lock.
+     */
+    template <typename T> class SlotRing {
+    public:
+        /**
+         * @throw std::runtime_error if depth is zero
+         */
+        explicit SlotRing(size_t depth)
+            : m_slots(depth + 2)
+            , m_ready(depth)
+        {
+            if (depth == 0) {
+                throw std::runtime_error("SlotRing: the depth must be at least 1");
+            }
+            m_free.reserve(m_slots.size());
+            for (size_t i = 1; i < m_slots.size(); i++) {
+                m_free.push_back(i);
+            }
+            m_producer_slot = 0;
+        }
+
+        size_t depth() const
+        {
+            return m_ready.size();
+        }
+
+        /**
+         * @brief Call f on every slot, e.g. to preallocate them
+         *
+         * Must be called before the producer and consumer start
+         */
+        template <typename F> void forEachSlot(F f)
+        {
+            for (auto& slot : m_slots) {
+                f(slot);
+            }
+        }
+
+        /**
+         * @brief The slot owned by the producer
+         */
+        T& writeSlot()
+        {
+            return m_slots[m_producer_slot];
+        }
+
+        /**
+         * @brief Queue the producer slot, and give the producer a new one
+         *
+         * @return false if the oldest queued element had to be dropped to make
+         *   room
+         */
+        bool publish()
+        {
+            bool dropped = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_ready_size == m_ready.size()) {
+                    m_free.push_back(m_ready[m_ready_front]);
+                    m_ready_front = (m_ready_front + 1) % m_ready.size();
+                    m_ready_size--;
+                    m_dropped++;
+                    dropped = true;
+                }
+                m_ready[(m_ready_front + m_ready_size) % m_ready.size()] =
+                    m_producer_slot;
+                m_ready_size++;
+                m_producer_slot = m_free.back();
+                m_free.pop_back();
+            }
+            m_condition.notify_one();
+            return !dropped;
+        }
+
+        /**
+         * @brief Take the oldest queued slot
+         *
+         * The slot is owned by the consumer until release() or the next call
+         * to acquire()
+         *
+         * @return the slot, or nullptr if the timeout expired or the ring was
+         *   closed
+         */
+        T* acquire(base::Time const& timeout)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            releaseLocked();
+            bool ready = m_condition.wait_for(lock,
+                std::chrono::microseconds(timeout.toMicroseconds()),
+                [this] { return m_ready_size > 0 || m_closed; });
+            if (!ready || m_ready_size == 0) {
+                return nullptr;
+            }
+            m_consumer_slot = m_ready[m_ready_front];
+            m_ready_front = (m_ready_front + 1) % m_ready.size();
+            m_ready_size--;
+            return &m_slots[m_consumer_slot];
+        }
+
+        /**
+         * @brief Give the slot returned by acquire() back to the producer
+         */
+        void release()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            releaseLocked();
+        }
+
+        /**
+         * @brief Wake up the consumer and make acquire() return immediately
+         * once the queue is empty
+         */
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_condition.notify_all();
+        }
+
+        /**
+         * @brief Re-open a closed ring, discarding its content
+         */
+        void reopen()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            releaseLocked();
+            while (m_ready_size > 0) {
+                m_free.push_back(m_ready[m_ready_front]);
+                m_ready_front = (m_ready_front + 1) % m_ready.size();
+                m_ready_size--;
+            }
+            m_closed = false;
+        }
+
+        /**
+         * @brief How many elements have been dropped because the queue was full
+         */
+        uint64_t dropped() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dropped;
+        }
+
+    private:
+        static const size_t NO_SLOT = static_cast<size_t>(-1);
+
+        void releaseLocked()
+        {
+            if (m_consumer_slot != NO_SLOT) {
+                m_free.push_back(m_consumer_slot);
+                m_consumer_slot = NO_SLOT;
+            }
+        }
+
+        std::vector<T> m_slots;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_condition;
+        /** Indexes of the published slots, a ring of depth elements */
+        std::vector<size_t> m_ready;
+        size_t m_ready_front = 0;
+        size_t m_ready_size = 0;
+        /** Indexes of the slots owned by nobody */
+        std::vector<size_t> m_free;
+        size_t m_producer_slot = NO_SLOT;
+        size_t m_consumer_slot = NO_SLOT;
+        bool m_closed = false;
+        uint64_t m_dropped = 0;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_SLOTRING_HPP
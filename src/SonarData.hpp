@@ -3,9 +3,14 @@
 
 #include <base/Float.hpp>
 #include <cstdint>
-#include <vector>
+#include <sonar_oculus_m750d/Oculus.h>
 
 namespace sonar_oculus_m750d {
+    /**
+     * @brief The ping metadata extracted from a ping result message
+     *
+     * The image and bearings themselves are not copied, see PingView
+     */
     struct SonarData {
         uint32_t image_size = 0;
         uint32_t image_offset = 0;
@@ -13,8 +18,41 @@ namespace sonar_oculus_m750d {
         uint16_t bin_count = 0;
         double range = base::unknown<double>();
         double speed_of_sound = base::unknown<double>();
-        std::vector<uint8_t> image;
-        std::vector<short> bearings;
+        /**
+         * @brief The acoustic frequency in Hz, only reported by the simple
+         * ping results
+         */
+        double frequency = base::unknown<double>();
+        /**
+         * @brief The salinity in ppt the sonar was configured with
+         */
+        double salinity = base::unknown<double>();
+        DataSizeType data_size = dataSize8Bit;
+        /**
+         * @brief Time of the ping in seconds since the sonar power-up
+         *
+         * Only reported by version 2 of the simple ping result
+         */
+        double ping_start_time = base::unknown<double>();
+        /**
+         * @brief The ping counter, only reported by the simple ping result
+         */
+        uint32_t ping_id = 0;
+        bool has_ping_id = false;
+        /**
+         * @brief The fire message the sonar echoes in the ping, i.e. the
+         * configuration it used for it
+         *
+         * Only reported by the simple ping results. The version 2 message
+         * echoes an OculusSimpleFireMessage2, of which only the common part
+         * is kept
+         */
+        OculusSimpleFireMessage fire_message;
+        bool has_fire_message = false;
+        /**
+         * @brief The message the ping was decoded from
+         */
+        OculusMessageType message_type = messageSimplePingResult;
     };
 }
 
@@ -0,0 +1,312 @@
+#include "SonarManager.hpp"
+#include "Driver.hpp"
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <iodrivers_base/Exceptions.hpp>
+#include <poll.h>
+#include <string.h>
+
+using namespace sonar_oculus_m750d;
+
+/** How often the poll loop checks whether it should stop */
+static const base::Time POLL_PERIOD = base::Time::fromMilliseconds(100);
+
+SonarManager::SonarManager(size_t worker_count, size_t queue_depth)
+    : m_worker_count(std::max<size_t>(worker_count, 1))
+    , m_queue_depth(std::max<size_t>(queue_depth, 1))
+{
+}
+
+SonarManager::~SonarManager()
+{
+    stop();
+}
+
+size_t SonarManager::addDevice(std::unique_ptr<Driver> driver)
+{
+    if (m_running) {
+        throw std::runtime_error("SonarManager: cannot add a device while running");
+    }
+    m_devices.emplace_back();
+    m_devices.back().driver = std::move(driver);
+    return m_devices.size() - 1;
+}
+
+size_t SonarManager::addDevice(std::string const& uri,
+    base::Angle const& beam_width,
+    base::Angle const& beam_height)
+{
+    std::unique_ptr<Driver> driver(new Driver(beam_width, beam_height));
+    driver->openURI(uri);
+    return addDevice(std::move(driver));
+}
+
+size_t SonarManager::getDeviceCount() const
+{
+    return m_devices.size();
+}
+
+Driver& SonarManager::getDriver(size_t device)
+{
+    return *m_devices.at(device).driver;
+}
+
+void SonarManager::configure(size_t device,
+    M750DConfiguration const& configuration,
+    UpdateRate update_rate)
+{
+    getDriver(device).fireSonar(configuration, update_rate);
+}
+
+void SonarManager::start()
+{
+    if (m_running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& device : m_devices) {
+            device.packets.clear();
+            device.scheduled = false;
+            device.failed = false;
+        }
+        m_ready.clear();
+        m_error = std::exception_ptr();
+        m_running = true;
+    }
+    m_poller = std::thread(&SonarManager::pollLoop, this);
+    for (size_t i = 0; i < m_worker_count; i++) {
+        m_workers.emplace_back(&SonarManager::workerLoop, this);
+    }
+}
+
+void SonarManager::stop()
+{
+    {
+        // Under the lock, so that no worker misses the notification
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_ready_signal.notify_all();
+    if (m_poller.joinable()) {
+        m_poller.join();
+    }
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+bool SonarManager::isRunning() const
+{
+    return m_running;
+}
+
+void SonarManager::pollLoop()
+{
+    std::vector<pollfd> fds;
+    std::vector<size_t> polled;
+    while (m_running) {
+        fds.clear();
+        polled.clear();
+        base::Time deadline = base::Time::now() + POLL_PERIOD;
+        for (size_t i = 0; i < m_devices.size(); i++) {
+            Device& device = m_devices[i];
+            if (device.failed) {
+                continue;
+            }
+            try {
+                device.driver->keepAlive();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                device.failed = true;
+                if (!m_error) {
+                    m_error = std::current_exception();
+                }
+                m_sample_signal.notify_all();
+                continue;
+            }
+            deadline = std::min(deadline, device.driver->nextKeepaliveDeadline());
+            pollfd fd;
+            fd.fd = device.driver->getFileDescriptor();
+            fd.events = POLLIN;
+            fd.revents = 0;
+            fds.push_back(fd);
+            polled.push_back(i);
+        }
+
+        int64_t timeout_us = (deadline - base::Time::now()).toMicroseconds();
+        int timeout_ms = std::max<int64_t>(0, (timeout_us + 999) / 1000);
+        int ret = poll(fds.data(), fds.size(), timeout_ms);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_error = std::make_exception_ptr(
+                std::runtime_error(std::string("SonarManager: poll failed: ") +
+                                   strerror(errno)));
+            m_sample_signal.notify_all();
+            break;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents) {
+                readDevice(polled[i]);
+            }
+        }
+    }
+}
+
+void SonarManager::readDevice(size_t index)
+{
+    Device& device = m_devices[index];
+    while (true) {
+        PacketBuffer packet;
+        try {
+            packet = device.driver->readPacketBuffer(base::Time());
+        }
+        catch (iodrivers_base::TimeoutError const&) {
+            return;
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            device.failed = true;
+            if (!m_error) {
+                m_error = std::current_exception();
+            }
+            m_sample_signal.notify_all();
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_statistics.packets_received++;
+        if (device.packets.size() >= m_queue_depth) {
+            device.packets.pop_front();
+            m_statistics.packets_dropped++;
+        }
+        device.packets.push_back(std::move(packet));
+        if (!device.scheduled) {
+            device.scheduled = true;
+            m_ready.push_back(index);
+            m_ready_signal.notify_one();
+        }
+    }
+}
+
+void SonarManager::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_ready_signal.wait(lock, [this] { return !m_running || !m_ready.empty(); });
+        if (!m_running) {
+            return;
+        }
+
+        size_t index = m_ready.front();
+        m_ready.pop_front();
+        Device& device = m_devices[index];
+        PacketBuffer packet = std::move(device.packets.front());
+        device.packets.pop_front();
+
+        lock.unlock();
+        decode(index, packet);
+        packet.reset();
+        lock.lock();
+
+        // The device stays scheduled while it has packets, so that no other
+        // worker decodes it in the meantime
+        if (device.packets.empty()) {
+            device.scheduled = false;
+        }
+        else {
+            m_ready.push_back(index);
+            m_ready_signal.notify_one();
+        }
+    }
+}
+
+void SonarManager::decode(size_t index, PacketBuffer const& packet)
+{
+    std::unique_ptr<DeviceSonar> sample;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free_samples.empty()) {
+            sample = std::move(m_free_samples.back());
+            m_free_samples.pop_back();
+        }
+    }
+    if (!sample) {
+        sample.reset(new DeviceSonar());
+    }
+
+    bool decoded = false;
+    bool failed = false;
+    try {
+        Driver& driver = *m_devices[index].driver;
+        decoded = driver.decodePacket(packet.data(),
+            packet.size(),
+            packet.receivedAt(),
+            sample->sonar);
+        sample->configuration_generation = driver.getPingGeneration();
+    }
+    catch (...) {
+        // Anything escaping here would terminate the worker thread
+        failed = true;
+    }
+
+    OculusMessageHeader header;
+    memcpy(&header, packet.data(), sizeof(OculusMessageHeader));
+    sample->device = index;
+    sample->device_id = header.srcDeviceId;
+    sample->part_number = header.partNumber;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!decoded) {
+        if (failed) {
+            m_statistics.decode_errors++;
+        }
+        m_free_samples.push_back(std::move(sample));
+        return;
+    }
+
+    m_statistics.samples_decoded++;
+    if (m_samples.size() >= m_queue_depth * m_devices.size()) {
+        m_free_samples.push_back(std::move(m_samples.front()));
+        m_samples.pop_front();
+        m_statistics.samples_dropped++;
+    }
+    m_samples.push_back(std::move(sample));
+    m_sample_signal.notify_one();
+}
+
+bool SonarManager::pop(DeviceSonar& sample, base::Time const& timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(timeout.toMicroseconds());
+    bool available = m_sample_signal.wait_until(lock, deadline, [this] {
+        return !m_samples.empty() || m_error;
+    });
+    if (!available) {
+        return false;
+    }
+    if (m_error) {
+        std::exception_ptr error = m_error;
+        m_error = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+
+    std::unique_ptr<DeviceSonar> next = std::move(m_samples.front());
+    m_samples.pop_front();
+    std::swap(sample, *next);
+    m_free_samples.push_back(std::move(next));
+    return true;
+}
+
+SonarManagerStatistics SonarManager::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
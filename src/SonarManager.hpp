@@ -0,0 +1,161 @@
+#ifndef SONAR_OCULUS_M750D_SONARMANAGER_HPP
+#define SONAR_OCULUS_M750D_SONARMANAGER_HPP
+
+#include <atomic>
+#include <base/samples/Sonar.hpp>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sonar_oculus_m750d/M750DConfiguration.hpp>
+#include <sonar_oculus_m750d/PacketPool.hpp>
+#include <sonar_oculus_m750d/UpdateRate.hpp>
+#include <thread>
+#include <vector>
+
+namespace sonar_oculus_m750d {
+    class Driver;
+
+    /**
+     * @brief A sample, along with the device it comes from
+     */
+    struct DeviceSonar {
+        /** The index of the device in the manager, see SonarManager::addDevice */
+        size_t device = 0;
+        /** The srcDeviceId of the ping message */
+        uint16_t device_id = 0;
+        /** The partNumber of the ping message, see OculusPartNumberType */
+        uint16_t part_number = 0;
+        /** The configuration the ping was made with, see
+         * Driver::getPingGeneration */
+        uint64_t configuration_generation = 0;
+        base::samples::Sonar sonar;
+    };
+
+    struct SonarManagerStatistics {
+        /** Packets read from all the devices */
+        uint64_t packets_received = 0;
+        /** Packets dropped because the workers were not keeping up */
+        uint64_t packets_dropped = 0;
+        /** Pings decoded into samples */
+        uint64_t samples_decoded = 0;
+        /** Samples dropped because the consumer was not keeping up */
+        uint64_t samples_dropped = 0;
+        /** Packets that failed to decode */
+        uint64_t decode_errors = 0;
+    };
+
+    /**
+     * @brief Acquisition from several sonars in one process
+     *
+     * A single thread waits on the sockets of all the devices with poll(),
+     * reads the packets that arrive and sends the keep-alives when they are
+     * due. The packets are decoded by a pool of worker threads shared by all
+     * devices, so that the CPU use follows the total ping rate rather than the
+     * number of heads. The packets of a given device are decoded in order, by
+     * one worker at a time.
+     *
+     * Each device has a queue of queue_depth packets, and the output queue
+     * holds queue_depth samples per device. Both drop the oldest element when
+     * full.
+     *
+     * Devices must be added before start(). While the manager runs, the
+     * drivers must not be read from other threads. They may be configured
+     * from any thread, with configure() or the driver's decode region, gain
+     * compensation and intensity curve setters: the drivers hand these over
+     * to the worker that decodes their next packet.
+     */
+    class SonarManager {
+    public:
+        static const size_t DEFAULT_QUEUE_DEPTH = 4;
+
+        explicit SonarManager(size_t worker_count = 1,
+            size_t queue_depth = DEFAULT_QUEUE_DEPTH);
+        ~SonarManager();
+
+        /**
+         * @brief Add a device, whose driver must already be connected
+         *
+         * @return the index of the device, used by the other methods and in
+         *   DeviceSonar
+         */
+        size_t addDevice(std::unique_ptr<Driver> driver);
+        /**
+         * @brief Create a driver, connect it and add it
+         */
+        size_t addDevice(std::string const& uri,
+            base::Angle const& beam_width,
+            base::Angle const& beam_height);
+        size_t getDeviceCount() const;
+        Driver& getDriver(size_t device);
+
+        /**
+         * @brief Configure a device and start its keep-alive
+         *
+         * See Driver::fireSonar
+         */
+        void configure(size_t device,
+            M750DConfiguration const& configuration,
+            UpdateRate update_rate);
+
+        void start();
+        void stop();
+        bool isRunning() const;
+
+        /**
+         * @brief Get the oldest decoded sample, from any device
+         *
+         * The sample is swapped with the one passed as argument, whose memory
+         * is then reused by the workers.
+         *
+         * If reading from a device failed, this rethrows the error once. The
+         * manager stops polling that device, and goes on with the others.
+         *
+         * @return true if a sample was available before the timeout
+         */
+        bool pop(DeviceSonar& sample, base::Time const& timeout);
+
+        SonarManagerStatistics getStatistics() const;
+
+    private:
+        struct Device {
+            std::unique_ptr<Driver> driver;
+            /** Packets waiting to be decoded, protected by m_mutex */
+            std::deque<PacketBuffer> packets;
+            /** Whether the device is in m_ready or being decoded */
+            bool scheduled = false;
+            /** Whether the poll loop gave up on the device after an error */
+            bool failed = false;
+        };
+
+        void pollLoop();
+        void workerLoop();
+        /** Read all the packets available on a device */
+        void readDevice(size_t device);
+        void decode(size_t device, PacketBuffer const& packet);
+
+        size_t m_worker_count;
+        size_t m_queue_depth;
+        std::vector<Device> m_devices;
+
+        std::atomic<bool> m_running{false};
+        std::thread m_poller;
+        std::vector<std::thread> m_workers;
+
+        mutable std::mutex m_mutex;
+        /** Signalled when a device is ready or the manager stops */
+        std::condition_variable m_ready_signal;
+        /** Devices with packets to decode, that no worker is decoding */
+        std::deque<size_t> m_ready;
+        /** Signalled when a sample is available */
+        std::condition_variable m_sample_signal;
+        std::deque<std::unique_ptr<DeviceSonar>> m_samples;
+        /** Samples whose memory is reused by the workers */
+        std::vector<std::unique_ptr<DeviceSonar>> m_free_samples;
+        SonarManagerStatistics m_statistics;
+        std::exception_ptr m_error;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_SONARMANAGER_HPP
@@ -0,0 +1,211 @@
+#include "StatusListener.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+
+DeviceLimits DeviceLimits::fromPartNumber(uint16_t part_number)
+{
+    OculusInfo const* info = &OculusSonarInfo[0];
+    for (OculusInfo const* it = OculusSonarInfo; it->partNumber != partNumberEnd; it++) {
+        if (it->partNumber == part_number) {
+            info = it;
+            break;
+        }
+    }
+
+    DeviceLimits limits;
+    limits.has_low_frequency = info->hasLF;
+    limits.max_low_frequency_range = info->hasLF ? info->maxLF : 0;
+    limits.has_high_frequency = info->hasHF;
+    limits.max_high_frequency_range = info->hasHF ? info->maxHF : 0;
+    return limits;
+}
+
+M750DConfiguration DeviceLimits::apply(M750DConfiguration const& configuration) const
+{
+    M750DConfiguration result = configuration;
+    if (result.mode == 1 && !has_low_frequency) {
+        result.mode = 2;
+    }
+    else if (result.mode == 2 && !has_high_frequency) {
+        result.mode = 1;
+    }
+
+    double max_range =
+        result.mode == 2 ? max_high_frequency_range : max_low_frequency_range;
+    if (!base::isUnknown(result.range) && result.range > max_range) {
+        result.range = max_range;
+    }
+    return result;
+}
+
+static std::string toDottedAddress(uint32_t address);
+
+std::string DeviceStatus::uri(uint16_t port) const
+{
+    return "tcp://" + ip_address + ":" + std::to_string(port);
+}
+
+StatusListener::StatusListener(uint16_t port)
+    : m_port(port)
+{
+}
+
+StatusListener::~StatusListener()
+{
+    close();
+}
+
+void StatusListener::open()
+{
+    close();
+    m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        throw std::runtime_error(std::string("status listener: cannot create socket: ") +
+                                 strerror(errno));
+    }
+    // Other programs, e.g. the Oculus ViewPoint software, may listen too
+    int enable = 1;
+    setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(m_fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(m_port);
+    if (bind(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::string error = strerror(errno);
+        close();
+        throw std::runtime_error("status listener: cannot bind port " +
+                                 std::to_string(m_port) + ": " + error);
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(m_fd, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+}
+
+void StatusListener::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool StatusListener::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+uint16_t StatusListener::getPort() const
+{
+    return m_port;
+}
+
+int StatusListener::getFileDescriptor() const
+{
+    return m_fd;
+}
+
+bool StatusListener::waitForStatus(DeviceStatus& status, base::Time const& timeout)
+{
+    if (m_fd < 0) {
+        throw std::runtime_error("status listener: not open");
+    }
+
+    base::Time deadline = base::Time::now() + timeout;
+    uint8_t buffer[1024];
+    while (true) {
+        int64_t remaining_us = (deadline - base::Time::now()).toMicroseconds();
+        pollfd fd;
+        fd.fd = m_fd;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        int ret = poll(&fd, 1, std::max<int64_t>(0, (remaining_us + 999) / 1000));
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("status listener: poll failed: ") +
+                                     strerror(errno));
+        }
+        if (ret == 0) {
+            return false;
+        }
+
+        sockaddr_in sender;
+        socklen_t sender_length = sizeof(sender);
+        ssize_t size = recvfrom(m_fd,
+            buffer,
+            sizeof(buffer),
+            0,
+            reinterpret_cast<sockaddr*>(&sender),
+            &sender_length);
+        if (size < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            throw std::runtime_error(std::string("status listener: recv failed: ") +
+                                     strerror(errno));
+        }
+        if (parseStatus(buffer, size, sender.sin_addr.s_addr, status)) {
+            status.time = base::Time::now();
+            return true;
+        }
+    }
+}
+
+bool StatusListener::parseStatus(uint8_t const* buffer,
+    size_t size,
+    uint32_t sender_address,
+    DeviceStatus& status)
+{
+    if (size < sizeof(OculusStatusMsg)) {
+        return false;
+    }
+    OculusStatusMsg msg;
+    memcpy(&msg, buffer, sizeof(msg));
+    if (msg.hdr.oculusId != OCULUS_CHECK_ID ||
+        msg.hdr.payloadSize + sizeof(OculusMessageHeader) < sizeof(OculusStatusMsg)) {
+        return false;
+    }
+
+    status.device_id = msg.deviceId;
+    status.part_number = msg.partNumber;
+    status.status = msg.status;
+    status.version = msg.versionInfo;
+    // The addresses are sent in network byte order
+    status.ip_address = toDottedAddress(msg.ipAddr ? msg.ipAddr : sender_address);
+    status.connected_ip_address =
+        msg.connectedIpAddr ? toDottedAddress(msg.connectedIpAddr) : std::string();
+    status.temperatures[0] = msg.temperature0;
+    status.temperatures[1] = msg.temperature1;
+    status.temperatures[2] = msg.temperature2;
+    status.temperatures[3] = msg.temperature3;
+    status.temperatures[4] = msg.temperature4;
+    status.temperatures[5] = msg.temperature5;
+    status.temperatures[6] = msg.temperature6;
+    status.temperatures[7] = msg.temperature7;
+    status.pressure = msg.pressure;
+    status.limits = DeviceLimits::fromPartNumber(msg.partNumber);
+    return true;
+}
+
+std::string toDottedAddress(uint32_t address)
+{
+    char text[INET_ADDRSTRLEN];
+    in_addr in;
+    in.s_addr = address;
+    inet_ntop(AF_INET, &in, text, sizeof(text));
+    return text;
+}
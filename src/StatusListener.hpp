@@ -0,0 +1,115 @@
+#ifndef SONAR_OCULUS_M750D_STATUSLISTENER_HPP
+#define SONAR_OCULUS_M750D_STATUSLISTENER_HPP
+
+#include <base/Time.hpp>
+#include <cstdint>
+#include <sonar_oculus_m750d/M750DConfiguration.hpp>
+#include <sonar_oculus_m750d/Oculus.h>
+#include <string>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief What a sonar model supports, from OculusSonarInfo
+     */
+    struct DeviceLimits {
+        bool has_low_frequency = true;
+        /** In meters */
+        double max_low_frequency_range = 120;
+        bool has_high_frequency = true;
+        /** In meters */
+        double max_high_frequency_range = 40;
+
+        /**
+         * @brief The limits of a part number
+         *
+         * Part numbers that are not listed in OculusSonarInfo get the limits
+         * of partNumberUndefined, as the Oculus SDK does
+         */
+        static DeviceLimits fromPartNumber(uint16_t part_number);
+
+        /**
+         * @brief Adapt a configuration to the device
+         *
+         * A frequency mode the device does not have is replaced by the one it
+         * has, and the range is clamped to the maximum range of the mode
+         */
+        M750DConfiguration apply(M750DConfiguration const& configuration) const;
+    };
+
+    /**
+     * @brief The content of the status message the sonars broadcast
+     */
+    struct DeviceStatus {
+        /** The reception time of the message */
+        base::Time time;
+        uint32_t device_id = 0;
+        uint16_t part_number = partNumberUndefined;
+        uint32_t status = 0;
+        OculusVersionInfo version = OculusVersionInfo();
+        /** The IP address of the sonar, in dotted notation */
+        std::string ip_address;
+        /** The address of the host connected to the sonar, if any */
+        std::string connected_ip_address;
+        double temperatures[8] = {};
+        double pressure = 0;
+        DeviceLimits limits;
+
+        /**
+         * @brief The iodrivers_base URI to connect to the sonar
+         */
+        std::string uri(uint16_t port = 52100) const;
+    };
+
+    /**
+     * @brief Listens for the status messages the sonars broadcast on UDP
+     *
+     * This allows to connect to a sonar as soon as it announces itself, with
+     * no prior knowledge of its address, and to pick its limits from its part
+     * number.
+     */
+    class StatusListener {
+    public:
+        static const uint16_t DEFAULT_PORT = 52102;
+
+        /**
+         * @param port the UDP port to listen on. Zero picks a free port, see
+         *   getPort
+         */
+        explicit StatusListener(uint16_t port = DEFAULT_PORT);
+        ~StatusListener();
+
+        void open();
+        void close();
+        bool isOpen() const;
+        uint16_t getPort() const;
+        int getFileDescriptor() const;
+
+        /**
+         * @brief Wait for the next valid status message
+         *
+         * Datagrams that are not status messages are ignored
+         *
+         * @return false if none arrived before the timeout
+         */
+        bool waitForStatus(DeviceStatus& status, base::Time const& timeout);
+
+        /**
+         * @brief Parse a status message
+         *
+         * @param sender_address the address the message was received from,
+         *   in network byte order. It is used if the message does not report
+         *   the sonar address
+         * @return false if the buffer does not hold a status message
+         */
+        static bool parseStatus(uint8_t const* buffer,
+            size_t size,
+            uint32_t sender_address,
+            DeviceStatus& status);
+
+    private:
+        uint16_t m_port;
+        int m_fd = -1;
+    };
+}
+
+#endif // SONAR_OCULUS_M750D_STATUSLISTENER_HPP
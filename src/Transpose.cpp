@@ -0,0 +1,842 @@
+#include "Transpose.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SONAR_OCULUS_M750D_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace sonar_oculus_m750d;
+
+/**
+ * Tile side, in samples. A 64x64 tile is at most 16 kB in and 16 kB out, which
+ * fits in L1
+ */
+static const int TILE_SIZE = 64;
+
+template <typename Sample> static inline Sample loadSample(uint8_t const* in)
+{
+    Sample sample;
+    memcpy(&sample, in, sizeof(Sample));
+    return sample;
+}
+
+template <typename Sample>
+static inline float normalize(uint8_t const* in, double factor)
+{
+    return static_cast<float>(static_cast<double>(loadSample<Sample>(in)) * factor);
+}
+
+/**
+ * Map an 8 bit sample through a 256 entry table
+ */
+static inline float lookup(uint8_t const* in, float const* table)
+{
+    return table[*in];
+}
+
+/**
+ * Map a value within [0, 255] through a 256 entry table, interpolating
+ * linearly between the entries. Integer values give the entries themselves
+ */
+static inline float interpolate(float const* table, double x)
+{
+    int i = std::min(static_cast<int>(x), 254);
+    double a = table[i];
+    double b = table[i + 1];
+    return static_cast<float>(a + (b - a) * (x - i));
+}
+
+/** The factor that maps the samples to [0, 255] */
+template <typename Sample> static inline double tableScale()
+{
+    return 255.0 / static_cast<Sample>(~Sample(0));
+}
+
+/**
+ * Map a wider sample through a 256 entry table
+ */
+template <typename Sample>
+static inline float lookupInterpolated(uint8_t const* in, float const* table)
+{
+    return interpolate(table, loadSample<Sample>(in) * tableScale<Sample>());
+}
+
+/**
+ * Scalar conversion of the [bin0, bin1) x [beam0, beam1) block. convert
+ * turns a pointer to an input sample into an output value
+ */
+template <typename Sample, typename Convert>
+static void transposeBlockScalar(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    int beam0,
+    int beam1,
+    int bin0,
+    int bin1,
+    Convert convert,
+    float const* gains)
+{
+    for (int b = beam0; b < beam1; b++) {
+        float* out = beam_major + b * bin_count;
+        for (int r = bin0; r < bin1; r++) {
+            float value = convert(bin_major + (r * beam_count + b) * sizeof(Sample));
+            out[r] = gains ? value * gains[r] : value;
+        }
+    }
+}
+
+/**
+ * Walk the image tile by tile, handing the part of each tile that is a multiple
+ * of the micro-kernel size to the micro-kernel and the borders to the scalar
+ * code. The micro-kernel is given the index of the first bin of its block
+ */
+template <typename Sample, int BLOCK, typename Convert, typename MicroKernel>
+static inline __attribute__((always_inline)) void transposeTiled(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    Convert convert,
+    float const* gains,
+    MicroKernel micro_kernel)
+{
+    for (int bin0 = 0; bin0 < bin_count; bin0 += TILE_SIZE) {
+        int bin1 = std::min(bin0 + TILE_SIZE, bin_count);
+        for (int beam0 = 0; beam0 < beam_count; beam0 += TILE_SIZE) {
+            int beam1 = std::min(beam0 + TILE_SIZE, beam_count);
+            int r = bin0;
+            for (; r + BLOCK <= bin1; r += BLOCK) {
+                int b = beam0;
+                for (; b + BLOCK <= beam1; b += BLOCK) {
+                    micro_kernel(bin_major + (r * beam_count + b) * sizeof(Sample),
+                        beam_major + b * bin_count + r,
+                        r);
+                }
+                transposeBlockScalar<Sample>(bin_major,
+                    beam_major,
+                    beam_count,
+                    bin_count,
+                    b,
+                    beam1,
+                    r,
+                    r + BLOCK,
+                    convert,
+                    gains);
+            }
+            transposeBlockScalar<Sample>(bin_major,
+                beam_major,
+                beam_count,
+                bin_count,
+                beam0,
+                beam1,
+                r,
+                bin1,
+                convert,
+                gains);
+        }
+    }
+}
+
+template <typename Sample, typename Convert>
+static void transposeScalar(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    Convert convert,
+    float const* gains)
+{
+    for (int bin0 = 0; bin0 < bin_count; bin0 += TILE_SIZE) {
+        int bin1 = std::min(bin0 + TILE_SIZE, bin_count);
+        for (int beam0 = 0; beam0 < beam_count; beam0 += TILE_SIZE) {
+            int beam1 = std::min(beam0 + TILE_SIZE, beam_count);
+            transposeBlockScalar<Sample>(bin_major,
+                beam_major,
+                beam_count,
+                bin_count,
+                beam0,
+                beam1,
+                bin0,
+                bin1,
+                convert,
+                gains);
+        }
+    }
+}
+
+#ifdef SONAR_OCULUS_M750D_X86
+
+// The conversions are done in double precision to get the exact same rounding
+// than the scalar code.
+//
+// The loaders widen the samples to 32 bit integers. The integer to double
+// conversion being signed, 32 bit samples are biased by -2^31 by the loader
+// and the bias is added back after the conversion
+
+template <typename Sample> struct SampleBias {
+    static constexpr double VALUE = 0;
+};
+template <> struct SampleBias<uint32_t> {
+    static constexpr double VALUE = 2147483648.0;
+};
+
+template <typename Sample> static inline __m128i load4(uint8_t const* in);
+
+template <>
+__attribute__((target("sse2"))) inline __m128i load4<uint8_t>(uint8_t const* in)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(loadSample<int32_t>(in)), zero);
+    return _mm_unpacklo_epi16(words, zero);
+}
+
+template <>
+__attribute__((target("sse2"))) inline __m128i load4<uint16_t>(uint8_t const* in)
+{
+    __m128i words = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(in));
+    return _mm_unpacklo_epi16(words, _mm_setzero_si128());
+}
+
+template <>
+__attribute__((target("sse2"))) inline __m128i load4<uint32_t>(uint8_t const* in)
+{
+    __m128i ints = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+    return _mm_xor_si128(ints, _mm_set1_epi32(0x80000000));
+}
+
+template <typename Sample>
+__attribute__((target("sse2"))) static inline __m128 loadNormalized4(uint8_t const* in,
+    double factor)
+{
+    __m128d factor2 = _mm_set1_pd(factor);
+    __m128d bias = _mm_set1_pd(SampleBias<Sample>::VALUE);
+    __m128i ints = load4<Sample>(in);
+    __m128d lo = _mm_mul_pd(_mm_add_pd(_mm_cvtepi32_pd(ints), bias), factor2);
+    __m128d hi = _mm_mul_pd(
+        _mm_add_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(ints, _MM_SHUFFLE(1, 0, 3, 2))),
+            bias),
+        factor2);
+    return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+/**
+ * Transpose with 4x4 blocks. load converts four consecutive samples of an
+ * input row, convert the single samples of the borders
+ */
+template <typename Sample, typename Load, typename Convert>
+__attribute__((target("sse2"))) static inline void transposeBlocks4(
+    uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    Load load,
+    Convert convert,
+    float const* gains)
+{
+    int stride = beam_count * sizeof(Sample);
+    auto micro_kernel = [=](uint8_t const* in, float* out, int bin)
+                            __attribute__((target("sse2"))) {
+        __m128 row0 = load(in);
+        __m128 row1 = load(in + stride);
+        __m128 row2 = load(in + 2 * stride);
+        __m128 row3 = load(in + 3 * stride);
+        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+        if (gains) {
+            // Once transposed, each row holds consecutive bins of one beam
+            __m128 gain = _mm_loadu_ps(gains + bin);
+            row0 = _mm_mul_ps(row0, gain);
+            row1 = _mm_mul_ps(row1, gain);
+            row2 = _mm_mul_ps(row2, gain);
+            row3 = _mm_mul_ps(row3, gain);
+        }
+        _mm_storeu_ps(out, row0);
+        _mm_storeu_ps(out + bin_count, row1);
+        _mm_storeu_ps(out + 2 * bin_count, row2);
+        _mm_storeu_ps(out + 3 * bin_count, row3);
+    };
+    transposeTiled<Sample, 4>(bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        convert,
+        gains,
+        micro_kernel);
+}
+
+template <typename Sample>
+__attribute__((target("sse2"))) static void transposeSSE2(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    double factor,
+    float const* gains)
+{
+    transposeBlocks4<Sample>(
+        bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        [factor](uint8_t const* in)
+            __attribute__((target("sse2"))) { return loadNormalized4<Sample>(in, factor); },
+        [factor](uint8_t const* in) { return normalize<Sample>(in, factor); },
+        gains);
+}
+
+/** SSE2 has no gather, the lookups are scalar and only the transpose is not */
+__attribute__((target("sse2"))) static void lookupSSE2(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    float const* table,
+    float const* gains)
+{
+    transposeBlocks4<uint8_t>(
+        bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        [table](uint8_t const* in) __attribute__((target("sse2"))) {
+            return _mm_setr_ps(table[in[0]], table[in[1]], table[in[2]], table[in[3]]);
+        },
+        [table](uint8_t const* in) { return lookup(in, table); },
+        gains);
+}
+
+template <typename Sample> static inline __m256i load8(uint8_t const* in);
+
+template <>
+__attribute__((target("avx2"))) inline __m256i load8<uint8_t>(uint8_t const* in)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(in)));
+}
+
+template <>
+__attribute__((target("avx2"))) inline __m256i load8<uint16_t>(uint8_t const* in)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in)));
+}
+
+template <>
+__attribute__((target("avx2"))) inline __m256i load8<uint32_t>(uint8_t const* in)
+{
+    __m256i ints = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(in));
+    return _mm256_xor_si256(ints, _mm256_set1_epi32(0x80000000));
+}
+
+template <typename Sample>
+__attribute__((target("avx2"))) static inline __m256 loadNormalized8(uint8_t const* in,
+    double factor)
+{
+    __m256d factor4 = _mm256_set1_pd(factor);
+    __m256d bias = _mm256_set1_pd(SampleBias<Sample>::VALUE);
+    __m256i ints = load8<Sample>(in);
+    __m256d lo = _mm256_mul_pd(
+        _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(ints)), bias),
+        factor4);
+    __m256d hi = _mm256_mul_pd(
+        _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(ints, 1)), bias),
+        factor4);
+    return _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo));
+}
+
+/**
+ * Transpose with 8x8 blocks. load converts eight consecutive samples of an
+ * input row, convert the single samples of the borders
+ */
+template <typename Sample, typename Load, typename Convert>
+__attribute__((target("avx2"))) static inline void transposeBlocks8(
+    uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    Load load,
+    Convert convert,
+    float const* gains)
+{
+    int stride = beam_count * sizeof(Sample);
+    auto micro_kernel = [=](uint8_t const* in, float* out, int bin)
+                            __attribute__((target("avx2"))) {
+        __m256 r[8];
+        for (int i = 0; i < 8; i++) {
+            r[i] = load(in + i * stride);
+        }
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+        __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 rows[8] = {_mm256_permute2f128_ps(s0, s4, 0x20),
+            _mm256_permute2f128_ps(s1, s5, 0x20),
+            _mm256_permute2f128_ps(s2, s6, 0x20),
+            _mm256_permute2f128_ps(s3, s7, 0x20),
+            _mm256_permute2f128_ps(s0, s4, 0x31),
+            _mm256_permute2f128_ps(s1, s5, 0x31),
+            _mm256_permute2f128_ps(s2, s6, 0x31),
+            _mm256_permute2f128_ps(s3, s7, 0x31)};
+        if (gains) {
+            __m256 gain = _mm256_loadu_ps(gains + bin);
+            for (int i = 0; i < 8; i++) {
+                rows[i] = _mm256_mul_ps(rows[i], gain);
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            _mm256_storeu_ps(out + i * bin_count, rows[i]);
+        }
+    };
+    transposeTiled<Sample, 8>(bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        convert,
+        gains,
+        micro_kernel);
+}
+
+template <typename Sample>
+__attribute__((target("avx2"))) static void transposeAVX2(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    double factor,
+    float const* gains)
+{
+    transposeBlocks8<Sample>(
+        bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        [factor](uint8_t const* in)
+            __attribute__((target("avx2"))) { return loadNormalized8<Sample>(in, factor); },
+        [factor](uint8_t const* in) { return normalize<Sample>(in, factor); },
+        gains);
+}
+
+__attribute__((target("avx2"))) static void lookupAVX2(uint8_t const* bin_major,
+    float* beam_major,
+    int beam_count,
+    int bin_count,
+    float const* table,
+    float const* gains)
+{
+    transposeBlocks8<uint8_t>(
+        bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        [table](uint8_t const* in) __attribute__((target("avx2"))) {
+            return _mm256_i32gather_ps(table, load8<uint8_t>(in), sizeof(float));
+        },
+        [table](uint8_t const* in) { return lookup(in, table); },
+        gains);
+}
+
+#endif
+
+bool sonar_oculus_m750d::isTransposeKernelSupported(TransposeKernel kernel)
+{
+    switch (kernel) {
+        case TRANSPOSE_KERNEL_SCALAR:
+            return true;
+#ifdef SONAR_OCULUS_M750D_X86
+        case TRANSPOSE_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case TRANSPOSE_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static TransposeKernel probeTransposeKernel()
+{
+    if (isTransposeKernelSupported(TRANSPOSE_KERNEL_AVX2)) {
+        return TRANSPOSE_KERNEL_AVX2;
+    }
+    else if (isTransposeKernelSupported(TRANSPOSE_KERNEL_SSE2)) {
+        return TRANSPOSE_KERNEL_SSE2;
+    }
+    return TRANSPOSE_KERNEL_SCALAR;
+}
+
+TransposeKernel sonar_oculus_m750d::bestTransposeKernel()
+{
+    static const TransposeKernel kernel = probeTransposeKernel();
+    return kernel;
+}
+
+template <typename Sample>
+void sonar_oculus_m750d::transposeNormalize(uint8_t const* bin_major,
+    float* beam_major,
+    uint16_t beam_count,
+    uint16_t bin_count,
+    double factor,
+    TransposeKernel kernel,
+    float const* gains)
+{
+    switch (kernel) {
+        case TRANSPOSE_KERNEL_SCALAR:
+            transposeScalar<Sample>(
+                bin_major,
+                beam_major,
+                beam_count,
+                bin_count,
+                [factor](uint8_t const* in) { return normalize<Sample>(in, factor); },
+                gains);
+            return;
+#ifdef SONAR_OCULUS_M750D_X86
+        case TRANSPOSE_KERNEL_SSE2:
+            transposeSSE2<Sample>(bin_major,
+                beam_major,
+                beam_count,
+                bin_count,
+                factor,
+                gains);
+            return;
+        case TRANSPOSE_KERNEL_AVX2:
+            transposeAVX2<Sample>(bin_major,
+                beam_major,
+                beam_count,
+                bin_count,
+                factor,
+                gains);
+            return;
+#endif
+        default:
+            throw std::invalid_argument("transpose kernel not supported on this CPU");
+    }
+}
+
+template void sonar_oculus_m750d::transposeNormalize<uint8_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    double,
+    TransposeKernel,
+    float const*);
+template void sonar_oculus_m750d::transposeNormalize<uint16_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    double,
+    TransposeKernel,
+    float const*);
+template void sonar_oculus_m750d::transposeNormalize<uint32_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    double,
+    TransposeKernel,
+    float const*);
+
+template <typename Sample>
+void sonar_oculus_m750d::transposeLookup(uint8_t const* bin_major,
+    float* beam_major,
+    uint16_t beam_count,
+    uint16_t bin_count,
+    float const* table,
+    TransposeKernel kernel,
+    float const* gains)
+{
+    if (sizeof(Sample) != 1) {
+        transposeScalar<Sample>(
+            bin_major,
+            beam_major,
+            beam_count,
+            bin_count,
+            [table](uint8_t const* in) { return lookupInterpolated<Sample>(in, table); },
+            gains);
+        return;
+    }
+
+    switch (kernel) {
+        case TRANSPOSE_KERNEL_SCALAR:
+            transposeScalar<uint8_t>(
+                bin_major,
+                beam_major,
+                beam_count,
+                bin_count,
+                [table](uint8_t const* in) { return lookup(in, table); },
+                gains);
+            return;
+#ifdef SONAR_OCULUS_M750D_X86
+        case TRANSPOSE_KERNEL_SSE2:
+            lookupSSE2(bin_major, beam_major, beam_count, bin_count, table, gains);
+            return;
+        case TRANSPOSE_KERNEL_AVX2:
+            lookupAVX2(bin_major, beam_major, beam_count, bin_count, table, gains);
+            return;
+#endif
+        default:
+            throw std::invalid_argument("transpose kernel not supported on this CPU");
+    }
+}
+
+template void sonar_oculus_m750d::transposeLookup<uint8_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    float const*,
+    TransposeKernel,
+    float const*);
+template void sonar_oculus_m750d::transposeLookup<uint16_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    float const*,
+    TransposeKernel,
+    float const*);
+template void sonar_oculus_m750d::transposeLookup<uint32_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    float const*,
+    TransposeKernel,
+    float const*);
+
+template <typename Sample>
+void sonar_oculus_m750d::transposeBytes(uint8_t const* bin_major,
+    uint8_t* beam_major,
+    uint16_t beam_count,
+    uint16_t bin_count)
+{
+    // Offset of the most significant byte in a little-endian sample
+    int const msb = sizeof(Sample) - 1;
+    for (int bin0 = 0; bin0 < bin_count; bin0 += TILE_SIZE) {
+        int bin1 = std::min(bin0 + TILE_SIZE, static_cast<int>(bin_count));
+        for (int beam0 = 0; beam0 < beam_count; beam0 += TILE_SIZE) {
+            int beam1 = std::min(beam0 + TILE_SIZE, static_cast<int>(beam_count));
+            for (int b = beam0; b < beam1; b++) {
+                uint8_t* out = beam_major + b * bin_count;
+                uint8_t const* in = bin_major + b * sizeof(Sample) + msb;
+                for (int r = bin0; r < bin1; r++) {
+                    out[r] = in[r * beam_count * sizeof(Sample)];
+                }
+            }
+        }
+    }
+}
+
+template void sonar_oculus_m750d::transposeBytes<uint8_t>(uint8_t const*,
+    uint8_t*,
+    uint16_t,
+    uint16_t);
+template void sonar_oculus_m750d::transposeBytes<uint16_t>(uint8_t const*,
+    uint8_t*,
+    uint16_t,
+    uint16_t);
+template void sonar_oculus_m750d::transposeBytes<uint32_t>(uint8_t const*,
+    uint8_t*,
+    uint16_t,
+    uint16_t);
+
+uint16_t TransposeWindow::outputBinCount() const
+{
+    return (bin_end + bin_step - 1) / bin_step;
+}
+
+uint16_t TransposeWindow::outputBeamCount() const
+{
+    if (beam_end <= beam_begin) {
+        return 0;
+    }
+    return (beam_end - beam_begin + beam_step - 1) / beam_step;
+}
+
+/**
+ * Walk the output image tile by tile. For each output tile, the input rows
+ * are read sequentially and pooled in a tile-sized accumulator, which is then
+ * written out transposed. store converts a pooled value and the gain of its
+ * output bin into an output sample. Output bins that pool no input are set to
+ * zero without going through store
+ */
+template <typename Sample, typename Output, typename Store>
+static void transposeWindowTiled(uint8_t const* bin_major,
+    Output* beam_major,
+    int beam_count,
+    int bin_count,
+    TransposeWindow const& window,
+    float const* gains,
+    Store store)
+{
+    int const out_bins = window.outputBinCount();
+    int const out_beams = window.outputBeamCount();
+    int const bin_step = std::max<int>(window.bin_step, 1);
+    int const beam_step = std::max<int>(window.beam_step, 1);
+    int const bin_begin = window.bin_begin;
+    int const bin_end = std::min<int>(window.bin_end, bin_count);
+    int const beam_end = std::min<int>(window.beam_end, beam_count);
+    bool const mean = window.pooling == POOLING_MEAN;
+
+    double acc[TILE_SIZE * TILE_SIZE];
+    bool empty[TILE_SIZE];
+    for (int i0 = 0; i0 < out_bins; i0 += TILE_SIZE) {
+        int i1 = std::min(i0 + TILE_SIZE, out_bins);
+        for (int j0 = 0; j0 < out_beams; j0 += TILE_SIZE) {
+            int j1 = std::min(j0 + TILE_SIZE, out_beams);
+            for (int i = i0; i < i1; i++) {
+                double* acc_row = acc + (i - i0) * TILE_SIZE;
+                int r0 = std::max(i * bin_step, bin_begin);
+                int r1 = std::min((i + 1) * bin_step, bin_end);
+                empty[i - i0] = r1 <= r0;
+                for (int j = j0; j < j1; j++) {
+                    int b0 = window.beam_begin + j * beam_step;
+                    int b1 = std::min(b0 + beam_step, beam_end);
+                    double value = 0;
+                    for (int r = r0; r < r1; r++) {
+                        uint8_t const* in =
+                            bin_major + (r * beam_count + b0) * sizeof(Sample);
+                        for (int b = b0; b < b1; b++, in += sizeof(Sample)) {
+                            double sample = loadSample<Sample>(in);
+                            value = mean ? value + sample : std::max(value, sample);
+                        }
+                    }
+                    if (mean && r1 > r0) {
+                        value /= (r1 - r0) * (b1 - b0);
+                    }
+                    acc_row[j - j0] = value;
+                }
+            }
+            for (int j = j0; j < j1; j++) {
+                Output* out = beam_major + j * out_bins;
+                for (int i = i0; i < i1; i++) {
+                    if (empty[i - i0]) {
+                        out[i] = Output();
+                        continue;
+                    }
+                    out[i] = store(acc[(i - i0) * TILE_SIZE + j - j0],
+                        gains ? gains[i] : 1.0f);
+                }
+            }
+        }
+    }
+}
+
+template <typename Sample>
+void sonar_oculus_m750d::transposeWindow(uint8_t const* bin_major,
+    float* beam_major,
+    uint16_t beam_count,
+    uint16_t bin_count,
+    TransposeWindow const& window,
+    double factor,
+    float const* gains)
+{
+    transposeWindowTiled<Sample>(bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        window,
+        gains,
+        [factor](double value, float gain) {
+            return static_cast<float>(value * factor) * gain;
+        });
+}
+
+template <typename Sample>
+void sonar_oculus_m750d::transposeWindowLookup(uint8_t const* bin_major,
+    float* beam_major,
+    uint16_t beam_count,
+    uint16_t bin_count,
+    TransposeWindow const& window,
+    float const* table,
+    float const* gains)
+{
+    double const scale = tableScale<Sample>();
+    transposeWindowTiled<Sample>(bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        window,
+        gains,
+        [table, scale](double value, float gain) {
+            return interpolate(table, value * scale) * gain;
+        });
+}
+
+template <typename Sample>
+void sonar_oculus_m750d::transposeWindowBytes(uint8_t const* bin_major,
+    uint8_t* beam_major,
+    uint16_t beam_count,
+    uint16_t bin_count,
+    TransposeWindow const& window)
+{
+    double const divisor = 1ull << (8 * (sizeof(Sample) - 1));
+    transposeWindowTiled<Sample>(bin_major,
+        beam_major,
+        beam_count,
+        bin_count,
+        window,
+        nullptr,
+        [divisor](double value, float) { return static_cast<uint8_t>(value / divisor); });
+}
+
+template void sonar_oculus_m750d::transposeWindow<uint8_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&,
+    double,
+    float const*);
+template void sonar_oculus_m750d::transposeWindow<uint16_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&,
+    double,
+    float const*);
+template void sonar_oculus_m750d::transposeWindow<uint32_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&,
+    double,
+    float const*);
+template void sonar_oculus_m750d::transposeWindowLookup<uint8_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&,
+    float const*,
+    float const*);
+template void sonar_oculus_m750d::transposeWindowBytes<uint8_t>(uint8_t const*,
+    uint8_t*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&);
+template void sonar_oculus_m750d::transposeWindowLookup<uint16_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&,
+    float const*,
+    float const*);
+template void sonar_oculus_m750d::transposeWindowBytes<uint16_t>(uint8_t const*,
+    uint8_t*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&);
+template void sonar_oculus_m750d::transposeWindowLookup<uint32_t>(uint8_t const*,
+    float*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&,
+    float const*,
+    float const*);
+template void sonar_oculus_m750d::transposeWindowBytes<uint32_t>(uint8_t const*,
+    uint8_t*,
+    uint16_t,
+    uint16_t,
+    TransposeWindow const&);
@@ -0,0 +1,188 @@
+#ifndef SONAR_OCULUS_M750D_TRANSPOSE_HPP
+#define SONAR_OCULUS_M750D_TRANSPOSE_HPP
+
+#include <cstdint>
+
+namespace sonar_oculus_m750d {
+    /**
+     * @brief The implementations available for the bin-major to beam-major
+     * conversion
+     */
+    enum TransposeKernel : uint8_t {
+        TRANSPOSE_KERNEL_SCALAR = 0x00, // portable implementation
+        TRANSPOSE_KERNEL_SSE2 = 0x01,   // 4x4 blocks, x86 only
+        TRANSPOSE_KERNEL_AVX2 = 0x02    // 8x8 blocks, x86 only
+    };
+
+    /**
+     * @brief How transposeWindow combines the samples it decimates
+     */
+    enum PoolingMode : uint8_t {
+        POOLING_MAX = 0x00, // keep the strongest echo
+        POOLING_MEAN = 0x01 // average the echoes
+    };
+
+    /**
+     * @brief The part of a bin-major image converted by transposeWindow
+     *
+     * Output bin i pools the input bins [i * bin_step, (i + 1) * bin_step)
+     * that are within [bin_begin, bin_end). Output bins that contain none of
+     * them are set to zero. Output beam j pools the input beams
+     * [beam_begin + j * beam_step, beam_begin + (j + 1) * beam_step) that are
+     * before beam_end
+     */
+    struct TransposeWindow {
+        uint16_t bin_begin = 0;
+        uint16_t bin_end = 0;
+        uint16_t beam_begin = 0;
+        uint16_t beam_end = 0;
+        uint16_t bin_step = 1;
+        uint16_t beam_step = 1;
+        PoolingMode pooling = POOLING_MAX;
+
+        uint16_t outputBinCount() const;
+        uint16_t outputBeamCount() const;
+    };
+
+    /**
+     * @brief Whether the given kernel can run on this CPU
+     */
+    bool isTransposeKernelSupported(TransposeKernel kernel);
+
+    /**
+     * @brief The fastest kernel supported by this CPU
+     *
+     * The CPU is probed only once, the result is cached
+     */
+    TransposeKernel bestTransposeKernel();
+
+    /**
+     * @brief Convert a bin-major image into a normalized beam-major float image
+     * in a single pass
+     *
+     * The input is indexed as [bin * beam_count + beam] and the output as
+     * [beam * bin_count + bin]. Each sample is converted with
+     * static_cast<float>(sample * factor), so that for 8 bit images the result
+     * is bit for bit identical to Protocol::toBeamMajor followed by
+     * Protocol::normalizeBins, whichever kernel is used.
+     *
+     * The image is processed in tiles small enough to stay in L1 cache, so
+     * that neither the strided reads nor the strided writes thrash it.
+     *
+     * When gains are given, each converted sample is then multiplied by the
+     * gain of its bin, in single precision. The result does not depend on
+     * the kernel either.
+     *
+     * @tparam Sample the type of the image samples, one of uint8_t, uint16_t or
+     *   uint32_t. The image does not need to be aligned on the sample size.
+     * @param bin_major the input image, beam_count * bin_count samples
+     * @param beam_major the output image, beam_count * bin_count floats
+     * @param factor the normalization factor applied to every sample
+     * @param kernel the implementation to use. It must be supported by the CPU
+     * @param gains if non-null, bin_count per-bin gains, see GainTable
+     */
+    template <typename Sample = uint8_t>
+    void transposeNormalize(uint8_t const* bin_major,
+        float* beam_major,
+        uint16_t beam_count,
+        uint16_t bin_count,
+        double factor,
+        TransposeKernel kernel = bestTransposeKernel(),
+        float const* gains = nullptr);
+
+    /**
+     * @brief Convert a bin-major image into a beam-major float image through
+     * a 256 entry table
+     *
+     * Same layout as transposeNormalize. 8 bit samples are replaced by their
+     * entry in the table, so that a table holding
+     * static_cast<float>(i * factor) gives the exact same result than
+     * transposeNormalize. Wider samples are scaled to [0, 255] and
+     * interpolated linearly between the entries, with the scalar code
+     * whatever the kernel.
+     *
+     * @param table 256 floats, see IntensityLUT
+     * @param gains if non-null, bin_count per-bin gains applied after the
+     *   lookup
+     */
+    template <typename Sample = uint8_t>
+    void transposeLookup(uint8_t const* bin_major,
+        float* beam_major,
+        uint16_t beam_count,
+        uint16_t bin_count,
+        float const* table,
+        TransposeKernel kernel = bestTransposeKernel(),
+        float const* gains = nullptr);
+
+    /**
+     * @brief Convert a bin-major image into a beam-major byte image, without
+     * widening the samples
+     *
+     * Same layout as transposeNormalize. 8 bit samples are copied as-is. Wider
+     * samples are reduced to their most significant byte.
+     *
+     * @tparam Sample the type of the image samples, one of uint8_t, uint16_t or
+     *   uint32_t
+     * @param bin_major the input image, beam_count * bin_count samples
+     * @param beam_major the output image, beam_count * bin_count bytes
+     */
+    template <typename Sample = uint8_t>
+    void transposeBytes(uint8_t const* bin_major,
+        uint8_t* beam_major,
+        uint16_t beam_count,
+        uint16_t bin_count);
+
+    /**
+     * @brief Convert a window of a bin-major image into a normalized,
+     * decimated, beam-major float image
+     *
+     * Only the samples within the window are read. Without decimation, the
+     * samples are converted exactly as transposeNormalize does.
+     *
+     * @param bin_major the input image, beam_count * bin_count samples
+     * @param beam_major the output image, window.outputBeamCount() *
+     *   window.outputBinCount() floats
+     * @param gains if non-null, window.outputBinCount() gains applied to the
+     *   pooled output bins
+     */
+    template <typename Sample = uint8_t>
+    void transposeWindow(uint8_t const* bin_major,
+        float* beam_major,
+        uint16_t beam_count,
+        uint16_t bin_count,
+        TransposeWindow const& window,
+        double factor,
+        float const* gains = nullptr);
+
+    /**
+     * @brief Convert a window of a bin-major image into a decimated,
+     * beam-major float image through a 256 entry table
+     *
+     * The table is applied to the pooled values, interpolating linearly
+     * between its entries. See transposeLookup
+     */
+    template <typename Sample = uint8_t>
+    void transposeWindowLookup(uint8_t const* bin_major,
+        float* beam_major,
+        uint16_t beam_count,
+        uint16_t bin_count,
+        TransposeWindow const& window,
+        float const* table,
+        float const* gains = nullptr);
+
+    /**
+     * @brief Convert a window of a bin-major image into a decimated,
+     * beam-major byte image
+     *
+     * The pooled samples are reduced to their most significant byte, as in
+     * transposeBytes. Means are truncated.
+     */
+    template <typename Sample = uint8_t>
+    void transposeWindowBytes(uint8_t const* bin_major,
+        uint8_t* beam_major,
+        uint16_t beam_count,
+        uint16_t bin_count,
+        TransposeWindow const& window);
+}
+
+#endif // SONAR_OCULUS_M750D_TRANSPOSE_HPP
@@ -0,0 +1,108 @@
+#ifndef SONAR_OCULUS_M750D_TEST_HELPERS_HPP
+#define SONAR_OCULUS_M750D_TEST_HELPERS_HPP
+
+#include <sonar_oculus_m750d/Oculus.h>
+#include <string.h>
+#include <vector>
+
+namespace test_helpers {
+    inline std::vector<uint8_t> message(OculusMessageType msg_id,
+        std::vector<uint8_t> const& payload = std::vector<uint8_t>())
+    {
+        OculusMessageHeader header;
+        memset(&header, 0, sizeof(header));
+        header.oculusId = OCULUS_CHECK_ID;
+        header.msgId = msg_id;
+        header.payloadSize = payload.size();
+
+        std::vector<uint8_t> buffer(sizeof(header) + payload.size());
+        memcpy(buffer.data(), &header, sizeof(header));
+        memcpy(buffer.data() + sizeof(header), payload.data(), payload.size());
+        return buffer;
+    }
+
+    inline std::vector<uint8_t> simplePingResult2(std::vector<short> const& bearings,
+        std::vector<uint8_t> const& image,
+        uint16_t bin_count,
+        DataSizeType data_size = dataSize8Bit)
+    {
+        OculusSimplePingResult2 result;
+        memset(&result, 0, sizeof(result));
+        auto image_offset = sizeof(result) + bearings.size() * sizeof(short);
+        result.fireMessage.head.oculusId = OCULUS_CHECK_ID;
+        result.fireMessage.head.msgId = messageSimplePingResult;
+        result.fireMessage.head.msgVersion = 2;
+        result.fireMessage.head.payloadSize =
+            image_offset + image.size() - sizeof(OculusMessageHeader);
+        result.speedOfSoundUsed = 1500;
+        result.dataSize = data_size;
+        result.rangeResolution = 0.1;
+        result.nRanges = bin_count;
+        result.nBeams = bearings.size();
+        result.imageOffset = image_offset;
+        result.imageSize = image.size();
+        result.messageSize = image_offset + image.size();
+
+        std::vector<uint8_t> buffer(result.messageSize);
+        memcpy(buffer.data(), &result, sizeof(result));
+        memcpy(buffer.data() + sizeof(result),
+            bearings.data(),
+            bearings.size() * sizeof(short));
+        memcpy(buffer.data() + image_offset, image.data(), image.size());
+        return buffer;
+    }
+
+    inline std::vector<uint8_t> pingResult(std::vector<short> const& bearings,
+        std::vector<uint8_t> const& image,
+        uint16_t bin_count)
+    {
+        OculusReturnFireMessage result;
+        memset(&result, 0, sizeof(result));
+        auto image_offset = sizeof(result) + bearings.size() * sizeof(short);
+        result.head.oculusId = OCULUS_CHECK_ID;
+        result.head.msgId = messagePingResult;
+        result.head.payloadSize =
+            image_offset + image.size() - sizeof(OculusMessageHeader);
+        result.ping.range = 10;
+        result.ping.nBeams = bearings.size();
+        result.ping_params.nRangeLinesBfm = bin_count;
+        result.ping_params.imageOffset = image_offset;
+        result.ping_params.imageSize = image.size();
+        result.ping_params.messageSize = image_offset + image.size();
+
+        std::vector<uint8_t> buffer(image_offset + image.size());
+        memcpy(buffer.data(), &result, sizeof(result));
+        memcpy(buffer.data() + sizeof(result),
+            bearings.data(),
+            bearings.size() * sizeof(short));
+        memcpy(buffer.data() + image_offset, image.data(), image.size());
+        return buffer;
+    }
+
+    /**
+     * A status message, as broadcast by the sonars. The address is in network
+     * byte order
+     */
+    inline std::vector<uint8_t> statusMessage(OculusPartNumberType part_number,
+        uint32_t ip_address,
+        uint32_t device_id = 1)
+    {
+        OculusStatusMsg status;
+        memset(&status, 0, sizeof(status));
+        status.hdr.oculusId = OCULUS_CHECK_ID;
+        status.hdr.msgId = 1;
+        status.hdr.partNumber = part_number;
+        status.hdr.payloadSize = sizeof(status) - sizeof(OculusMessageHeader);
+        status.deviceId = device_id;
+        status.deviceType = deviceTypeImagingSonar;
+        status.partNumber = part_number;
+        status.ipAddr = ip_address;
+        status.temperature0 = 21.5;
+
+        std::vector<uint8_t> buffer(sizeof(status));
+        memcpy(buffer.data(), &status, sizeof(status));
+        return buffer;
+    }
+}
+
+#endif
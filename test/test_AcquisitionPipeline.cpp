@@ -0,0 +1,102 @@
+#include "Helpers.hpp"
+#include <gtest/gtest.h>
+#include <iodrivers_base/TestStream.hpp>
+#include <sonar_oculus_m750d/AcquisitionPipeline.hpp>
+#include <sonar_oculus_m750d/Driver.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+using namespace test_helpers;
+
+struct AcquisitionPipelineTest : public ::testing::Test {
+    Driver driver = Driver(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+
+    AcquisitionPipelineTest()
+    {
+        driver.openURI("test://");
+    }
+
+    void pushDataToDriver(vector<uint8_t> const& data)
+    {
+        dynamic_cast<iodrivers_base::TestStream*>(driver.getMainStream())
+            ->pushDataToDriver(data);
+    }
+};
+
+TEST_F(AcquisitionPipelineTest, it_decodes_the_received_pings_in_order)
+{
+    for (uint8_t i = 0; i < 3; i++) {
+        pushDataToDriver(simplePingResult2({100, -50, -200}, {i, 0, 0, 0, 0, 0}, 2));
+    }
+
+    AcquisitionPipeline pipeline(driver, 4);
+    pipeline.start();
+    base::samples::Sonar sonar;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(pipeline.pop(sonar, base::Time::fromSeconds(1)));
+        ASSERT_FLOAT_EQ(i / 255.0, sonar.bins[0]);
+    }
+    ASSERT_FALSE(pipeline.pop(sonar, base::Time::fromMilliseconds(10)));
+    pipeline.stop();
+
+    auto stats = pipeline.getStatistics();
+    ASSERT_EQ(3, stats.packets_received);
+    ASSERT_EQ(3, stats.samples_decoded);
+    ASSERT_EQ(3, stats.total.count);
+    ASSERT_EQ(3, stats.decode.count);
+}
+
+TEST_F(AcquisitionPipelineTest, it_queues_at_least_one_element)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 0, 0, 0, 0, 0}, 2));
+
+    AcquisitionPipeline pipeline(driver, 0);
+    pipeline.start();
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(pipeline.pop(sonar, base::Time::fromSeconds(1)));
+    ASSERT_FLOAT_EQ(1 / 255.0, sonar.bins[0]);
+}
+
+TEST_F(AcquisitionPipelineTest, it_counts_decode_errors_and_keeps_going)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {0, 0, 0, 0, 0, 0}, 3));
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 0, 0, 0, 0, 0}, 2));
+
+    AcquisitionPipeline pipeline(driver, 4);
+    pipeline.start();
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(pipeline.pop(sonar, base::Time::fromSeconds(1)));
+    ASSERT_FLOAT_EQ(1 / 255.0, sonar.bins[0]);
+    pipeline.stop();
+    ASSERT_EQ(1, pipeline.getStatistics().decode_errors);
+}
+
+TEST_F(AcquisitionPipelineTest, it_applies_fire_messages_sent_while_decoding)
+{
+    for (int i = 0; i < 200; i++) {
+        pushDataToDriver(pingResult({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    }
+
+    AcquisitionPipeline pipeline(driver, 4);
+    pipeline.start();
+    M750DConfiguration config;
+    base::samples::Sonar sonar;
+    int decoded = 0;
+    for (int i = 0; i < 200; i++) {
+        config.speed_of_sound = (i % 2) ? 1400 : 1600;
+        config.salinity = i % 35;
+        driver.fireSonar(config, UPDATE_10HZ_MAX);
+        while (pipeline.pop(sonar, base::Time())) {
+            ASSERT_TRUE(sonar.speed_of_sound == 1500 ||
+                        sonar.speed_of_sound == 1400 || sonar.speed_of_sound == 1600);
+            decoded++;
+        }
+    }
+    while (pipeline.pop(sonar, base::Time::fromMilliseconds(100))) {
+        decoded++;
+    }
+    pipeline.stop();
+
+    ASSERT_EQ(decoded, pipeline.getStatistics().samples_decoded -
+                           pipeline.getStatistics().samples_dropped);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/BearingCache.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct BearingCacheTest : public ::testing::Test {
+    BearingCache cache = BearingCache(2);
+
+    PingView view(vector<short> const& bearings)
+    {
+        PingView ping;
+        ping.bearings = reinterpret_cast<uint8_t const*>(bearings.data());
+        ping.beam_count = bearings.size();
+        return ping;
+    }
+};
+
+TEST_F(BearingCacheTest, it_converts_the_bearings_in_hundredths_of_degrees)
+{
+    vector<short> bearings = {100, -50, -200};
+    auto angles = cache.get(view(bearings));
+    ASSERT_EQ(3, angles->size());
+    ASSERT_FLOAT_EQ(-1, (*angles)[0].getDeg());
+    ASSERT_FLOAT_EQ(0.5, (*angles)[1].getDeg());
+    ASSERT_FLOAT_EQ(2, (*angles)[2].getDeg());
+}
+
+TEST_F(BearingCacheTest, it_returns_the_same_table_for_the_same_bearings)
+{
+    vector<short> bearings = {100, -50, -200};
+    vector<short> copy = bearings;
+    auto first = cache.get(view(bearings));
+    auto second = cache.get(view(copy));
+    ASSERT_EQ(first, second);
+
+    auto stats = cache.getStatistics();
+    ASSERT_EQ(1, stats.hits);
+    ASSERT_EQ(1, stats.misses);
+}
+
+TEST_F(BearingCacheTest, it_converts_again_when_the_bearings_change)
+{
+    vector<short> bearings = {100, -50, -200};
+    vector<short> other = {100, -50, -300};
+    vector<short> fewer = {100, -50};
+    auto first = cache.get(view(bearings));
+    auto second = cache.get(view(other));
+    auto third = cache.get(view(fewer));
+    ASSERT_NE(first, second);
+    ASSERT_FLOAT_EQ(3, (*second)[2].getDeg());
+    ASSERT_EQ(2, third->size());
+    ASSERT_EQ(3, cache.getStatistics().misses);
+}
+
+TEST_F(BearingCacheTest, it_keeps_the_most_recently_used_tables)
+{
+    vector<short> a = {1, 2};
+    vector<short> b = {3, 4};
+    vector<short> c = {5, 6};
+    auto table_a = cache.get(view(a));
+    cache.get(view(b));
+    ASSERT_EQ(table_a, cache.get(view(a)));
+    cache.get(view(c));
+    ASSERT_EQ(table_a, cache.get(view(a)));
+    cache.get(view(b));
+    ASSERT_EQ(2, cache.getStatistics().hits);
+    ASSERT_EQ(4, cache.getStatistics().misses);
+}
+
+TEST_F(BearingCacheTest, it_resets_the_statistics)
+{
+    vector<short> bearings = {100, -50, -200};
+    cache.get(view(bearings));
+    cache.resetStatistics();
+    ASSERT_EQ(0, cache.getStatistics().misses);
+    ASSERT_EQ(0, cache.getStatistics().hits);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/ClockEstimator.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct ClockEstimatorTest : public ::testing::Test {
+    ClockEstimator estimator = ClockEstimator(base::Time::fromSeconds(10),
+        base::Time::fromSeconds(1));
+    base::Time boot = base::Time::fromSeconds(1000);
+
+    base::Time received(double device_time, double latency)
+    {
+        return boot + base::Time::fromSeconds(device_time + latency);
+    }
+};
+
+TEST_F(ClockEstimatorTest, it_estimates_the_offset_as_the_minimum_difference)
+{
+    double latencies[] = {0.030, 0.012, 0.050, 0.010, 0.020};
+    for (int i = 0; i < 5; i++) {
+        estimator.update(i * 0.025, received(i * 0.025, latencies[i]));
+    }
+    auto stats = estimator.getStatistics();
+    ASSERT_EQ(boot + base::Time::fromMilliseconds(10), stats.offset);
+    ASSERT_EQ(5, stats.samples);
+}
+
+TEST_F(ClockEstimatorTest, it_stamps_a_ping_with_the_estimated_ping_time)
+{
+    estimator.update(1, received(1, 0.010));
+    estimator.update(1.025, received(1.025, 0.040));
+    auto time = estimator.update(1.050, received(1.050, 0.030));
+    ASSERT_EQ(boot + base::Time::fromSeconds(1.060), time);
+}
+
+TEST_F(ClockEstimatorTest, it_forgets_samples_older_than_the_window)
+{
+    estimator.update(0, received(0, 0.001));
+    estimator.update(5, received(5, 0.020));
+    estimator.update(10.5, received(10.5, 0.030));
+    ASSERT_EQ(boot + base::Time::fromMilliseconds(20), estimator.getStatistics().offset);
+}
+
+TEST_F(ClockEstimatorTest, it_detects_a_device_clock_reset)
+{
+    estimator.update(100, received(100, 0.010));
+    estimator.update(100.1, received(100.1, 0.010));
+
+    base::Time new_boot = boot + base::Time::fromSeconds(130);
+    auto time = estimator.update(0.5, new_boot + base::Time::fromSeconds(0.52));
+    ASSERT_EQ(new_boot + base::Time::fromSeconds(0.52), time);
+    ASSERT_EQ(1, estimator.getStatistics().resets);
+}
+
+TEST_F(ClockEstimatorTest, it_detects_a_device_clock_jumping_ahead)
+{
+    estimator.update(100, received(100, 0.010));
+    estimator.update(200, received(100.1, 0.010));
+    ASSERT_EQ(1, estimator.getStatistics().resets);
+}
+
+TEST_F(ClockEstimatorTest, it_does_not_reset_on_a_transport_stall)
+{
+    estimator.update(100, received(100, 0.010));
+    estimator.update(100.1, received(100.1, 3));
+    ASSERT_EQ(0, estimator.getStatistics().resets);
+    ASSERT_EQ(boot + base::Time::fromMilliseconds(10), estimator.getStatistics().offset);
+}
+
+TEST_F(ClockEstimatorTest, it_reports_the_latency_jitter)
+{
+    for (int i = 0; i < 100; i++) {
+        estimator.update(i * 0.025, received(i * 0.025, (i % 2) ? 0.010 : 0.030));
+    }
+    auto stats = estimator.getStatistics();
+    ASSERT_NEAR(0.010, stats.latency.toSeconds(), 2e-3);
+    ASSERT_NEAR(0.010, stats.jitter.toSeconds(), 2e-3);
+}
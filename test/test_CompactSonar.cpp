@@ -0,0 +1,111 @@
+#include "Helpers.hpp"
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/Protocol.hpp>
+#include <sonar_oculus_m750d/Transpose.hpp>
+
+#include <random>
+#include <string.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+using namespace test_helpers;
+
+struct CompactSonarTest : public ::testing::Test {
+    Protocol protocol;
+
+    static vector<short> bearings(uint16_t beam_count)
+    {
+        vector<short> bearings(beam_count);
+        for (uint16_t i = 0; i < beam_count; i++) {
+            bearings[i] = -6500 + 13000 * i / beam_count;
+        }
+        return bearings;
+    }
+
+    static vector<uint8_t> randomImage(size_t size)
+    {
+        mt19937 rng(size);
+        uniform_int_distribution<int> dist(0, 255);
+        vector<uint8_t> image(size);
+        for (auto& sample : image) {
+            sample = dist(rng);
+        }
+        return image;
+    }
+};
+
+TEST_F(CompactSonarTest, it_keeps_the_bytes_in_beam_major_order)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    ASSERT_TRUE(protocol.handleBuffer(buffer.data(), buffer.size()));
+
+    CompactSonar sonar;
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(3u, sonar.beam_count);
+    ASSERT_EQ(2u, sonar.bin_count);
+    ASSERT_EQ(vector<uint8_t>({0, 102, 51, 153, 255, 204}), sonar.bins);
+    ASSERT_EQ(Protocol::NORMALIZATION_FACTOR, sonar.scale);
+    ASSERT_FLOAT_EQ(-1, sonar.bearings[0].getDeg());
+    ASSERT_FLOAT_EQ(2, sonar.bearings[2].getDeg());
+}
+
+TEST_F(CompactSonarTest, it_converts_to_the_same_sample_than_parseSonar)
+{
+    uint16_t beam_count = 256;
+    uint16_t bin_count = 123;
+    auto buffer =
+        simplePingResult2(bearings(beam_count), randomImage(beam_count * bin_count), bin_count);
+    ASSERT_TRUE(protocol.handleBuffer(buffer.data(), buffer.size()));
+
+    base::samples::Sonar expected;
+    protocol.parseSonar(expected, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    CompactSonar compact;
+    protocol.parseSonar(compact, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(expected.bins.size(), compact.bins.size());
+
+    base::samples::Sonar sonar = compact.toSonar();
+    ASSERT_EQ(expected.bin_duration, sonar.bin_duration);
+    ASSERT_EQ(expected.beam_width, sonar.beam_width);
+    ASSERT_EQ(expected.beam_height, sonar.beam_height);
+    ASSERT_EQ(expected.speed_of_sound, sonar.speed_of_sound);
+    ASSERT_EQ(expected.bin_count, sonar.bin_count);
+    ASSERT_EQ(expected.beam_count, sonar.beam_count);
+    ASSERT_EQ(expected.bearings, sonar.bearings);
+    ASSERT_EQ(0,
+        memcmp(expected.bins.data(),
+            sonar.bins.data(),
+            expected.bins.size() * sizeof(float)));
+}
+
+TEST_F(CompactSonarTest, it_keeps_the_most_significant_byte_of_16_bit_samples)
+{
+    vector<uint16_t> samples = {0, 0x1234, 0xffff, 0x80ff, 0x0100, 0x00ff};
+    vector<uint8_t> image(samples.size() * 2);
+    memcpy(image.data(), samples.data(), image.size());
+    auto buffer = simplePingResult2({100, -50, -200}, image, 2, dataSize16Bit);
+    ASSERT_TRUE(protocol.handleBuffer(buffer.data(), buffer.size()));
+
+    CompactSonar compact;
+    protocol.parseSonar(compact, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(vector<uint8_t>({0, 0x80, 0x12, 0x01, 0xff, 0x00}), compact.bins);
+
+    base::samples::Sonar expected;
+    protocol.parseSonar(expected, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    auto sonar = compact.toSonar();
+    for (size_t i = 0; i < expected.bins.size(); i++) {
+        ASSERT_NEAR(expected.bins[i], sonar.bins[i], 1.0 / 256) << i;
+    }
+}
+
+TEST_F(CompactSonarTest, it_transposes_bytes_like_the_float_conversion)
+{
+    uint16_t beam_count = 131;
+    uint16_t bin_count = 77;
+    auto image = randomImage(beam_count * bin_count);
+    vector<uint8_t> bytes(image.size());
+    transposeBytes(image.data(), bytes.data(), beam_count, bin_count);
+    auto expected = Protocol::toBeamMajor(image, beam_count, bin_count);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        ASSERT_EQ(expected[i], bytes[i]) << i;
+    }
+}
@@ -0,0 +1,587 @@
+#include "Helpers.hpp"
+#include <gtest/gtest.h>
+#include <iodrivers_base/Exceptions.hpp>
+#include <iodrivers_base/TestStream.hpp>
+#include <sonar_oculus_m750d/Driver.hpp>
+#include <cstddef>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+using namespace test_helpers;
+
+struct DriverTest : public ::testing::Test {
+    Driver driver = Driver(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+
+    DriverTest()
+    {
+        driver.openURI("test://");
+    }
+
+    void pushDataToDriver(vector<uint8_t> const& data)
+    {
+        dynamic_cast<iodrivers_base::TestStream*>(driver.getMainStream())
+            ->pushDataToDriver(data);
+    }
+};
+
+TEST_F(DriverTest, it_computes_the_size_of_the_largest_packet_for_a_ping)
+{
+    ASSERT_GE(Driver::maxPacketSize(512, 1000),
+        sizeof(OculusSimplePingResult2) + 512 * 2 + 512 * 1000);
+    ASSERT_GE(Driver::maxPacketSize(512, 1000, dataSize16Bit),
+        sizeof(OculusSimplePingResult2) + 512 * 2 + 512 * 1000 * 2);
+}
+
+TEST_F(DriverTest, it_allocates_its_packet_buffers_with_the_max_packet_size)
+{
+    Driver small(base::Angle::fromDeg(1),
+        base::Angle::fromDeg(20),
+        Driver::maxPacketSize(3, 2));
+    ASSERT_EQ(small.getMaxPacketSize(), small.getPacketPool().acquire().capacity());
+}
+
+TEST_F(DriverTest, it_reuses_the_same_packet_buffer_from_one_ping_to_the_next)
+{
+    auto packet = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+    pushDataToDriver(packet);
+    pushDataToDriver(packet);
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_TRUE(driver.processOne(sonar));
+    auto stats = driver.getPacketPool().getStatistics();
+    ASSERT_EQ(1, stats.allocations);
+    ASSERT_EQ(1, stats.reuses);
+}
+
+TEST_F(DriverTest, it_hands_off_the_last_packet_without_copying_it)
+{
+    auto first = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+    auto second = simplePingResult2({100, -50, -200}, {7, 8, 9, 10, 11, 12}, 2);
+    pushDataToDriver(first);
+    pushDataToDriver(second);
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    PacketBuffer kept = driver.getLastPacket();
+    ASSERT_EQ(driver.getLastPacket().data(), kept.data());
+    ASSERT_TRUE(driver.processOne(sonar));
+
+    ASSERT_EQ(first.size(), kept.size());
+    ASSERT_EQ(first, vector<uint8_t>(kept.data(), kept.data() + kept.size()));
+    ASSERT_EQ(2, driver.getPacketPool().getStatistics().allocations);
+}
+
+TEST_F(DriverTest, tryProcess_returns_no_samples_if_there_is_no_data)
+{
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(0, driver.tryProcess(samples));
+}
+
+TEST_F(DriverTest, tryProcess_returns_all_the_pings_available)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    pushDataToDriver(message(messageUserConfig));
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {7, 8, 9, 10, 11, 12}, 2));
+
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(2, driver.tryProcess(samples));
+    ASSERT_FLOAT_EQ(1 / 255.0, samples[0].bins[0]);
+    ASSERT_FLOAT_EQ(7 / 255.0, samples[1].bins[0]);
+    ASSERT_EQ(0, driver.tryProcess(samples));
+}
+
+TEST_F(DriverTest, processAvailable_returns_all_the_pings_received_together)
+{
+    vector<uint8_t> data;
+    for (uint8_t i = 0; i < 3; i++) {
+        auto ping = simplePingResult2({100, -50, -200}, {i, 2, 3, 4, 5, 6}, 2);
+        data.insert(data.end(), ping.begin(), ping.end());
+        auto status = message(messageUserConfig);
+        data.insert(data.end(), status.begin(), status.end());
+    }
+    pushDataToDriver(data);
+
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(3, driver.processAvailable(samples));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_FLOAT_EQ(i / 255.0, samples[i].bins[0]);
+    }
+    ASSERT_EQ(6u, driver.getStatistics().packets_received);
+}
+
+TEST_F(DriverTest, tryProcess_skips_the_pings_that_fail_to_decode)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    // Claims more bins than the image holds
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {0, 0, 0, 0, 0, 0}, 3));
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {7, 8, 9, 10, 11, 12}, 2));
+
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(2, driver.tryProcess(samples));
+    ASSERT_FLOAT_EQ(1 / 255.0, samples[0].bins[0]);
+    ASSERT_FLOAT_EQ(7 / 255.0, samples[1].bins[0]);
+    ASSERT_EQ(1u, driver.getStatistics().decode_errors);
+}
+
+TEST_F(DriverTest, processAvailable_skips_a_first_ping_that_fails_to_decode)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {0, 0, 0, 0, 0, 0}, 3));
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {7, 8, 9, 10, 11, 12}, 2));
+
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(1, driver.processAvailable(samples));
+    ASSERT_FLOAT_EQ(7 / 255.0, samples[0].bins[0]);
+    ASSERT_EQ(1u, driver.getStatistics().decode_errors);
+}
+
+TEST_F(DriverTest, processAvailable_returns_zero_if_only_other_messages_were_received)
+{
+    pushDataToDriver(message(messageUserConfig));
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(0, driver.processAvailable(samples));
+}
+
+TEST_F(DriverTest, processAvailable_times_out_if_nothing_arrives)
+{
+    driver.setReadTimeout(base::Time::fromMilliseconds(10));
+    vector<base::samples::Sonar> samples;
+    ASSERT_THROW(driver.processAvailable(samples), iodrivers_base::TimeoutError);
+}
+
+TEST_F(DriverTest, it_outputs_compact_samples)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {7, 8, 9, 10, 11, 12}, 2));
+
+    CompactSonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(vector<uint8_t>({1, 4, 2, 5, 3, 6}), sonar.bins);
+    ASSERT_FALSE(sonar.time.isNull());
+
+    vector<CompactSonar> samples;
+    ASSERT_EQ(1, driver.tryProcess(samples));
+    ASSERT_EQ(vector<uint8_t>({7, 10, 8, 11, 9, 12}), samples[0].bins);
+    ASSERT_EQ(2u, driver.getStatistics().pings_decoded);
+}
+
+TEST_F(DriverTest, tryProcess_reuses_the_samples_it_is_given)
+{
+    vector<base::samples::Sonar> samples(2);
+    samples[0].bins.reserve(6);
+    float const* bins = samples[0].bins.data();
+
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    ASSERT_EQ(1, driver.tryProcess(samples));
+    ASSERT_EQ(2, samples.size());
+    ASSERT_EQ(bins, samples[0].bins.data());
+}
+
+TEST_F(DriverTest, it_has_no_keepalive_deadline_until_the_sonar_is_fired)
+{
+    ASSERT_EQ(base::Time::max(), driver.nextKeepaliveDeadline());
+}
+
+TEST_F(DriverTest, the_keepalive_deadline_is_one_period_after_the_last_fire)
+{
+    driver.setKeepalivePeriod(base::Time::fromMilliseconds(500));
+    base::Time before = base::Time::now();
+    driver.fireSonar(M750DConfiguration(), UPDATE_10HZ_MAX);
+    base::Time after = base::Time::now();
+
+    base::Time deadline = driver.nextKeepaliveDeadline();
+    ASSERT_LE(before + base::Time::fromMilliseconds(500), deadline);
+    ASSERT_GE(after + base::Time::fromMilliseconds(500), deadline);
+}
+
+struct KeepaliveTest : public DriverTest {
+    M750DConfiguration config;
+
+    KeepaliveTest()
+    {
+        config.mode = 1;
+        config.range = 50;
+        config.gain = 0.5;
+    }
+
+    vector<uint8_t> readDataFromDriver()
+    {
+        return dynamic_cast<iodrivers_base::TestStream*>(driver.getMainStream())
+            ->readDataFromDriver();
+    }
+};
+
+TEST_F(KeepaliveTest, configurations_with_the_same_unknown_fields_compare_equal)
+{
+    M750DConfiguration other = config;
+    ASSERT_TRUE(config == other);
+    other.gain = 0.6;
+    ASSERT_TRUE(config != other);
+}
+
+TEST_F(KeepaliveTest, it_rebuilds_the_fire_message_only_when_the_configuration_changes)
+{
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto first = readDataFromDriver();
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    ASSERT_EQ(first, readDataFromDriver());
+    ASSERT_EQ(1, driver.getKeepaliveStatistics().message_rebuilds);
+
+    driver.fireSonar(config, UPDATE_15HZ_MAX);
+    ASSERT_NE(first, readDataFromDriver());
+    config.range = 40;
+    driver.fireSonar(config, UPDATE_15HZ_MAX);
+    auto stats = driver.getKeepaliveStatistics();
+    ASSERT_EQ(3, stats.message_rebuilds);
+    ASSERT_EQ(4, stats.fire_messages_sent);
+}
+
+TEST_F(KeepaliveTest, it_does_not_send_anything_before_the_sonar_is_fired)
+{
+    driver.setKeepalivePeriod(base::Time::fromMicroseconds(1));
+    ASSERT_FALSE(driver.keepAlive());
+    ASSERT_TRUE(readDataFromDriver().empty());
+}
+
+TEST_F(KeepaliveTest, it_does_not_send_the_keepalive_before_the_deadline)
+{
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    readDataFromDriver();
+    ASSERT_FALSE(driver.keepAlive());
+    ASSERT_TRUE(readDataFromDriver().empty());
+}
+
+TEST_F(KeepaliveTest, it_resends_the_last_fire_message_once_the_deadline_passed)
+{
+    driver.setKeepalivePeriod(base::Time::fromMilliseconds(10));
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto fire_message = readDataFromDriver();
+    usleep(12000);
+    ASSERT_TRUE(driver.keepAlive());
+    ASSERT_EQ(fire_message, readDataFromDriver());
+    auto stats = driver.getKeepaliveStatistics();
+    ASSERT_EQ(1, stats.keepalives_sent);
+    ASSERT_EQ(0, stats.keepalives_missed);
+    ASSERT_EQ(1, stats.message_rebuilds);
+}
+
+TEST_F(KeepaliveTest, it_counts_the_periods_missed)
+{
+    driver.setKeepalivePeriod(base::Time::fromMilliseconds(10));
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    usleep(35000);
+    ASSERT_TRUE(driver.keepAlive());
+    ASSERT_LE(2, driver.getKeepaliveStatistics().keepalives_missed);
+}
+
+TEST_F(KeepaliveTest, it_can_be_disabled)
+{
+    driver.setKeepalivePeriod(base::Time());
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    ASSERT_EQ(base::Time::max(), driver.nextKeepaliveDeadline());
+    ASSERT_FALSE(driver.keepAlive());
+}
+
+TEST_F(KeepaliveTest, processOne_sends_the_keepalive_when_it_is_due)
+{
+    driver.setKeepalivePeriod(base::Time::fromMilliseconds(1));
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto fire_message = readDataFromDriver();
+    usleep(2000);
+
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(fire_message, readDataFromDriver());
+}
+
+TEST_F(DriverTest, it_skips_garbage_up_to_the_next_message_in_one_step)
+{
+    vector<uint8_t> garbage(1000, 0x42);
+    garbage[10] = 0x53;
+    pushDataToDriver(garbage);
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_FLOAT_EQ(1 / 255.0, sonar.bins[0]);
+    auto stats = driver.getResyncStatistics();
+    ASSERT_EQ(1000, stats.bytes_skipped);
+    ASSERT_EQ(1, stats.resync_events);
+}
+
+TEST_F(DriverTest, it_skips_headers_with_an_invalid_message_id)
+{
+    auto invalid = message(messageUserConfig);
+    invalid[6] = 0x01;
+    invalid[7] = 0x01;
+    pushDataToDriver(invalid);
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    auto stats = driver.getResyncStatistics();
+    ASSERT_EQ(invalid.size(), stats.bytes_skipped);
+    ASSERT_EQ(1, stats.rejected_packets);
+}
+
+TEST_F(DriverTest, it_skips_headers_announcing_a_packet_larger_than_its_buffers)
+{
+    Driver small(base::Angle::fromDeg(1),
+        base::Angle::fromDeg(20),
+        Driver::maxPacketSize(3, 2));
+    small.openURI("test://");
+    auto huge = message(messageUserConfig);
+    uint32_t payload_size = small.getMaxPacketSize();
+    memcpy(&huge[10], &payload_size, 4);
+    auto ping = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+    auto stream = dynamic_cast<iodrivers_base::TestStream*>(small.getMainStream());
+    stream->pushDataToDriver(huge);
+    stream->pushDataToDriver(ping);
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(small.processOne(sonar));
+    ASSERT_EQ(1, small.getResyncStatistics().rejected_packets);
+}
+
+TEST_F(DriverTest, it_skips_pings_whose_message_size_does_not_match_the_payload)
+{
+    auto truncated = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+    uint32_t message_size = truncated.size() + 10;
+    memcpy(&truncated[offsetof(OculusSimplePingResult2, messageSize)], &message_size, 4);
+    pushDataToDriver(truncated);
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {7, 2, 3, 4, 5, 6}, 2));
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_FLOAT_EQ(7 / 255.0, sonar.bins[0]);
+    ASSERT_EQ(1, driver.getResyncStatistics().rejected_packets);
+}
+
+TEST_F(DriverTest, it_skips_pings_whose_image_is_outside_the_packet)
+{
+    auto invalid = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+    uint32_t image_offset = invalid.size() - 2;
+    memcpy(&invalid[offsetof(OculusSimplePingResult2, imageOffset)], &image_offset, 4);
+    pushDataToDriver(invalid);
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {7, 2, 3, 4, 5, 6}, 2));
+
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_FLOAT_EQ(7 / 255.0, sonar.bins[0]);
+    ASSERT_EQ(1, driver.getResyncStatistics().rejected_packets);
+}
+
+static vector<uint8_t> pingWithId(uint32_t ping_id)
+{
+    auto ping = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+    memcpy(&ping[offsetof(OculusSimplePingResult2, pingId)], &ping_id, 4);
+    return ping;
+}
+
+TEST_F(DriverTest, it_counts_the_packets_and_pings_it_processes)
+{
+    auto ping = pingWithId(1);
+    pushDataToDriver(ping);
+    pushDataToDriver(message(messageUserConfig));
+    pushDataToDriver(ping);
+
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(2, driver.tryProcess(samples));
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(3, stats.packets_received);
+    ASSERT_EQ(2 * ping.size() + sizeof(OculusMessageHeader), stats.bytes_received);
+    ASSERT_EQ(2, stats.packets_by_msg_id[messageSimplePingResult]);
+    ASSERT_EQ(1, stats.packets_by_msg_id[messageUserConfig]);
+    ASSERT_EQ(0, stats.unknown_messages);
+    ASSERT_EQ(2, stats.pings_decoded);
+    ASSERT_EQ(3, stats.read.count);
+    ASSERT_EQ(2, stats.decode.count);
+    ASSERT_EQ(2, stats.transpose.count);
+    ASSERT_EQ(2, stats.total.count);
+}
+
+TEST_F(DriverTest, it_counts_the_gaps_in_the_ping_ids)
+{
+    pushDataToDriver(pingWithId(10));
+    pushDataToDriver(pingWithId(11));
+    pushDataToDriver(pingWithId(14));
+    pushDataToDriver(pingWithId(15));
+
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(4, driver.tryProcess(samples));
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(1, stats.ping_id_gaps);
+    ASSERT_EQ(2, stats.pings_lost);
+}
+
+TEST_F(DriverTest, it_counts_decode_errors)
+{
+    pushDataToDriver(simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 3));
+    base::samples::Sonar sonar;
+    ASSERT_THROW(driver.processOne(sonar), std::runtime_error);
+    ASSERT_EQ(1, driver.getStatistics().decode_errors);
+}
+
+TEST_F(DriverTest, it_resets_its_statistics)
+{
+    pushDataToDriver(pingWithId(1));
+    base::samples::Sonar sonar;
+    driver.processOne(sonar);
+    driver.resetStatistics();
+
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(0, stats.packets_received);
+    ASSERT_EQ(0, stats.pings_decoded);
+    ASSERT_EQ(0, stats.total.count);
+}
+
+struct ReconfigurationTest : public KeepaliveTest {
+    /** A ping echoing the given fire message, as sent by the driver */
+    vector<uint8_t> pingEchoing(vector<uint8_t> const& fire_message)
+    {
+        auto ping = simplePingResult2({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2);
+        size_t header_size = sizeof(OculusMessageHeader);
+        memcpy(ping.data() + header_size,
+            fire_message.data() + header_size,
+            sizeof(OculusSimpleFireMessage) - header_size);
+        return ping;
+    }
+
+    /** A ping echoing the given fire message, as modified by the firmware */
+    template <typename F>
+    vector<uint8_t> pingEchoing(vector<uint8_t> const& fire_message, F modify)
+    {
+        auto ping = pingEchoing(fire_message);
+        OculusSimplePingResult2 result;
+        memcpy(&result, ping.data(), sizeof(result));
+        modify(result.fireMessage);
+        memcpy(ping.data(), &result, sizeof(result));
+        return ping;
+    }
+};
+
+TEST_F(ReconfigurationTest, it_increments_the_generation_when_the_configuration_changes)
+{
+    ASSERT_EQ(0, driver.getConfigurationGeneration());
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    ASSERT_EQ(1, driver.getConfigurationGeneration());
+    config.range = 40;
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    ASSERT_EQ(2, driver.getConfigurationGeneration());
+}
+
+TEST_F(ReconfigurationTest, it_tags_the_pings_with_the_configuration_they_echo)
+{
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto first = readDataFromDriver();
+    pushDataToDriver(pingEchoing(first));
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(1, driver.getPingGeneration());
+
+    config.range = 40;
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto second = readDataFromDriver();
+    pushDataToDriver(pingEchoing(first));
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(1, driver.getPingGeneration());
+    pushDataToDriver(pingEchoing(second));
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(2, driver.getPingGeneration());
+
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(1, stats.stale_pings);
+    ASSERT_EQ(0, stats.stale_pings_dropped);
+    ASSERT_EQ(2, stats.configuration_apply.count);
+}
+
+TEST_F(ReconfigurationTest, it_optionally_drops_the_stale_pings)
+{
+    driver.setDropStalePings(true);
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto first = readDataFromDriver();
+    config.range = 40;
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto second = readDataFromDriver();
+
+    pushDataToDriver(pingEchoing(first));
+    pushDataToDriver(pingEchoing(second));
+    vector<base::samples::Sonar> samples;
+    ASSERT_EQ(1, driver.tryProcess(samples));
+    ASSERT_EQ(2, driver.getPingGeneration());
+
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(1, stats.stale_pings);
+    ASSERT_EQ(1, stats.stale_pings_dropped);
+    ASSERT_EQ(1, stats.pings_decoded);
+}
+
+TEST_F(ReconfigurationTest, it_measures_the_time_until_the_configuration_is_applied)
+{
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto fire_message = readDataFromDriver();
+    usleep(10000);
+    pushDataToDriver(pingEchoing(fire_message));
+    base::samples::Sonar sonar;
+    driver.processOne(sonar);
+
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(1, stats.configuration_apply.count);
+    ASSERT_LE(base::Time::fromMilliseconds(10), stats.configuration_apply.max);
+}
+
+TEST_F(ReconfigurationTest, it_ignores_the_echoed_fields_that_do_not_change_the_image)
+{
+    driver.setDropStalePings(true);
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto fire_message = readDataFromDriver();
+    pushDataToDriver(pingEchoing(fire_message, [](OculusSimpleFireMessage2& echo) {
+        echo.flags |= 0x04;
+        echo.range += 1e-6;
+        echo.gainPercent = 50.2;
+        echo.speedOfSound = 1500;
+        echo.salinity = 0;
+    }));
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(1, driver.getPingGeneration());
+    ASSERT_EQ(0, driver.getStatistics().stale_pings);
+}
+
+TEST_F(ReconfigurationTest, it_assumes_the_configuration_is_applied_after_the_timeout)
+{
+    driver.setDropStalePings(true);
+    driver.setConfigurationTimeout(base::Time::fromMilliseconds(20));
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    auto fire_message = readDataFromDriver();
+    auto clamped = [](OculusSimpleFireMessage2& echo) { echo.range = 40; };
+
+    pushDataToDriver(pingEchoing(fire_message, clamped));
+    base::samples::Sonar sonar;
+    ASSERT_FALSE(driver.processOne(sonar));
+    ASSERT_EQ(0, driver.getPingGeneration());
+    usleep(30000);
+    pushDataToDriver(pingEchoing(fire_message, clamped));
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(1, driver.getPingGeneration());
+    pushDataToDriver(pingEchoing(fire_message, clamped));
+    ASSERT_TRUE(driver.processOne(sonar));
+
+    auto stats = driver.getStatistics();
+    ASSERT_EQ(1, stats.stale_pings_dropped);
+    ASSERT_EQ(1, stats.configurations_assumed);
+    ASSERT_EQ(0, stats.configuration_apply.count);
+}
+
+TEST_F(ReconfigurationTest, it_assumes_full_ping_results_use_the_last_configuration)
+{
+    driver.setDropStalePings(true);
+    driver.fireSonar(config, UPDATE_10HZ_MAX);
+    pushDataToDriver(pingResult({100, -50, -200}, {1, 2, 3, 4, 5, 6}, 2));
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_EQ(1, driver.getPingGeneration());
+}
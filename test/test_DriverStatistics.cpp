@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/DriverStatistics.hpp>
+#include <sonar_oculus_m750d/Oculus.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+TEST(LatencyHistogram, it_uses_power_of_two_buckets_in_microseconds)
+{
+    ASSERT_EQ(0, LatencyHistogram::bucketOf(base::Time()));
+    ASSERT_EQ(1, LatencyHistogram::bucketOf(base::Time::fromMicroseconds(1)));
+    ASSERT_EQ(2, LatencyHistogram::bucketOf(base::Time::fromMicroseconds(2)));
+    ASSERT_EQ(2, LatencyHistogram::bucketOf(base::Time::fromMicroseconds(3)));
+    ASSERT_EQ(11, LatencyHistogram::bucketOf(base::Time::fromMicroseconds(1500)));
+    ASSERT_EQ(base::Time::fromMicroseconds(2048), LatencyHistogram::bucketUpperBound(11));
+}
+
+TEST(LatencyHistogram, it_puts_everything_above_the_last_bound_in_the_last_bucket)
+{
+    int last = LatencyHistogram::BUCKET_COUNT - 1;
+    ASSERT_EQ(last, LatencyHistogram::bucketOf(base::Time::fromSeconds(3600)));
+    ASSERT_EQ(base::Time::max(), LatencyHistogram::bucketUpperBound(last));
+}
+
+TEST(AtomicLatencyHistogram, it_accumulates_latencies)
+{
+    AtomicLatencyHistogram accumulator;
+    accumulator.add(base::Time::fromMicroseconds(100));
+    accumulator.add(base::Time::fromMicroseconds(300));
+    accumulator.add(base::Time::fromMicroseconds(5000));
+
+    auto histogram = accumulator.snapshot();
+    ASSERT_EQ(3, histogram.count);
+    ASSERT_EQ(1, histogram.buckets[7]);
+    ASSERT_EQ(1, histogram.buckets[9]);
+    ASSERT_EQ(1, histogram.buckets[13]);
+    ASSERT_EQ(base::Time::fromMicroseconds(1800), histogram.mean());
+    ASSERT_EQ(base::Time::fromMicroseconds(5000), histogram.max);
+    ASSERT_EQ(base::Time::fromMicroseconds(512), histogram.quantile(0.5));
+    ASSERT_EQ(base::Time::fromMicroseconds(5000), histogram.quantile(1));
+}
+
+TEST(AtomicLatencyHistogram, it_can_be_reset)
+{
+    AtomicLatencyHistogram accumulator;
+    accumulator.add(base::Time::fromMicroseconds(100));
+    accumulator.reset();
+    auto histogram = accumulator.snapshot();
+    ASSERT_EQ(0, histogram.count);
+    ASSERT_EQ(0, histogram.buckets[7]);
+    ASSERT_EQ(base::Time(), histogram.max);
+}
+
+TEST(DriverCounters, it_counts_packets_by_message_id)
+{
+    DriverCounters counters;
+    counters.packetReceived(messageSimplePingResult, 100);
+    counters.packetReceived(messageSimplePingResult, 200);
+    counters.packetReceived(0x42, 10);
+
+    DriverStatistics stats;
+    counters.snapshot(stats);
+    ASSERT_EQ(3, stats.packets_received);
+    ASSERT_EQ(310, stats.bytes_received);
+    ASSERT_EQ(2, stats.packets_by_msg_id[messageSimplePingResult]);
+    ASSERT_EQ(1, stats.packets_by_msg_id[0x42]);
+    ASSERT_EQ(1, stats.unknown_messages);
+}
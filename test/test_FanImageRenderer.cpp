@@ -0,0 +1,247 @@
+#include "Helpers.hpp"
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/FanImageRenderer.hpp>
+#include <sonar_oculus_m750d/Protocol.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+using namespace test_helpers;
+
+struct FanImageRendererTest : public ::testing::Test {
+    /** A 130 degrees wide, 15 m long fan */
+    static base::samples::Sonar makeSonar(uint16_t beam_count, uint16_t bin_count)
+    {
+        base::samples::Sonar sonar;
+        sonar.speed_of_sound = 1500;
+        sonar.bin_duration = Protocol::binDuration(15, 1500, bin_count);
+        sonar.beam_width = base::Angle::fromDeg(1);
+        sonar.beam_height = base::Angle::fromDeg(20);
+        sonar.resize(bin_count, beam_count, false);
+        fill(sonar.bins.begin(), sonar.bins.end(), 0);
+        for (uint16_t b = 0; b < beam_count; b++) {
+            sonar.bearings[b] =
+                base::Angle::fromDeg(-65 + 130.0 * b / (beam_count - 1));
+        }
+        return sonar;
+    }
+};
+
+TEST_F(FanImageRendererTest, it_computes_the_range_of_the_sample)
+{
+    auto sonar = makeSonar(16, 100);
+    ASSERT_NEAR(15, FanImageRenderer::sampleRange(sonar), 1e-9);
+}
+
+TEST_F(FanImageRendererTest, it_renders_the_decoded_pings_at_their_range)
+{
+    // 100 bins of 15 cm, over 120 degrees. The resolution is chosen so that
+    // the bin duration is a whole number of microseconds
+    vector<uint8_t> bins(3 * 100, 255);
+    auto buffer = simplePingResult2({-6000, 0, 6000}, bins, 100);
+    OculusSimplePingResult2 result;
+    memcpy(&result, buffer.data(), sizeof(result));
+    result.rangeResolution = 0.15;
+    memcpy(buffer.data(), &result, sizeof(result));
+    Protocol protocol;
+    ASSERT_TRUE(protocol.handleBuffer(buffer.data(), buffer.size()));
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_NEAR(15, FanImageRenderer::sampleRange(sonar), 1e-9);
+
+    FanImageRenderer renderer(200, 200);
+    vector<float> image;
+    renderer.render(sonar, image);
+    ASSERT_NEAR(2 * 15 * sin(60 * M_PI / 180) / 200, renderer.getMetersPerPixel(), 1e-9);
+    // Straight ahead, the rows are centered at 14.87 m and 15.00 m
+    ASSERT_FLOAT_EQ(1, image[85 * 200 + 100]);
+    ASSERT_EQ(0, image[84 * 200 + 100]);
+}
+
+TEST_F(FanImageRendererTest, it_fits_the_fan_in_the_image)
+{
+    auto sonar = makeSonar(16, 100);
+    FanImageRenderer renderer(200, 200);
+    vector<float> image;
+    renderer.render(sonar, image);
+    ASSERT_EQ(200u * 200u, image.size());
+    // 130 degrees wide, the fan is wider than it is high
+    ASSERT_NEAR(2 * 15 * sin(65 * M_PI / 180) / 200, renderer.getMetersPerPixel(), 1e-9);
+
+    FanImageRenderer wide(400, 100);
+    wide.render(sonar, image);
+    ASSERT_NEAR(0.15, wide.getMetersPerPixel(), 1e-9);
+}
+
+TEST_F(FanImageRendererTest, it_leaves_the_pixels_outside_of_the_fan_to_zero)
+{
+    auto sonar = makeSonar(16, 100);
+    fill(sonar.bins.begin(), sonar.bins.end(), 1);
+    FanImageRenderer renderer(200, 200);
+    vector<float> image;
+    renderer.render(sonar, image);
+
+    // Bottom corners are outside of the 130 degrees fan, top corners beyond
+    // the range
+    ASSERT_EQ(0, image[199 * 200]);
+    ASSERT_EQ(0, image[199 * 200 + 199]);
+    ASSERT_EQ(0, image[0]);
+    ASSERT_EQ(0, image[199]);
+    // Straight ahead, half the range
+    ASSERT_FLOAT_EQ(1, image[150 * 200 + 100]);
+}
+
+TEST_F(FanImageRendererTest, it_interpolates_along_the_range)
+{
+    auto sonar = makeSonar(16, 100);
+    for (uint16_t b = 0; b < 16; b++) {
+        for (uint16_t r = 0; r < 100; r++) {
+            sonar.bins[b * 100 + r] = r / 100.0;
+        }
+    }
+    FanImageRenderer renderer(300, 100);
+    vector<float> image;
+    renderer.render(sonar, image);
+
+    double mpp = renderer.getMetersPerPixel();
+    double bin_size = 0.15;
+    // Column 150 is centered 0.5 pixel right of the axis
+    for (uint32_t v = 10; v < 100; v += 10) {
+        double forward = (100 - v - 0.5) * mpp;
+        double right = 0.5 * mpp;
+        double expected = (hypot(forward, right) / bin_size - 0.5) / 100;
+        ASSERT_NEAR(expected, image[v * 300 + 150], 1e-5) << v;
+    }
+}
+
+TEST_F(FanImageRendererTest, it_interpolates_across_the_beams)
+{
+    auto sonar = makeSonar(3, 100);
+    // Beams at -65, 0, 65 degrees. Bearings are counter-clockwise, i.e. the
+    // first beam is on the right of the image
+    fill(sonar.bins.begin(), sonar.bins.begin() + 100, 1);
+    FanImageRenderer renderer(200, 100);
+    vector<float> image;
+    renderer.render(sonar, image);
+
+    double mpp = renderer.getMetersPerPixel();
+    uint32_t v = 60;
+    for (uint32_t u = 100; u < 190; u += 10) {
+        double forward = (100 - v - 0.5) * mpp;
+        double right = (u + 0.5 - 100) * mpp;
+        if (hypot(forward, right) >= 15) {
+            continue;
+        }
+        double bearing = atan2(-right, forward) * 180 / M_PI;
+        ASSERT_NEAR(-bearing / 65, image[v * 200 + u], 1e-5) << u;
+        ASSERT_EQ(0, image[v * 200 + 199 - u]) << u;
+    }
+}
+
+TEST_F(FanImageRendererTest, it_handles_bearings_in_decreasing_order)
+{
+    auto increasing = makeSonar(3, 100);
+    fill(increasing.bins.begin(), increasing.bins.begin() + 100, 1);
+    auto decreasing = increasing;
+    reverse(decreasing.bearings.begin(), decreasing.bearings.end());
+    fill(decreasing.bins.begin(), decreasing.bins.end(), 0);
+    fill(decreasing.bins.begin() + 200, decreasing.bins.end(), 1);
+
+    FanImageRenderer renderer(200, 100);
+    vector<float> expected;
+    renderer.render(increasing, expected);
+    vector<float> image;
+    renderer.render(decreasing, image);
+    for (size_t i = 0; i < image.size(); i++) {
+        ASSERT_NEAR(expected[i], image[i], 1e-5) << i;
+    }
+}
+
+TEST_F(FanImageRendererTest, it_scales_the_bins_to_bytes)
+{
+    auto sonar = makeSonar(16, 100);
+    fill(sonar.bins.begin(), sonar.bins.end(), 0.5);
+    FanImageRenderer renderer(100, 100);
+    vector<uint8_t> image;
+    renderer.render(sonar, image);
+    ASSERT_EQ(128, image[70 * 100 + 50]);
+    ASSERT_EQ(0, image[0]);
+
+    fill(sonar.bins.begin(), sonar.bins.end(), 2);
+    renderer.render(sonar, image);
+    ASSERT_EQ(255, image[70 * 100 + 50]);
+}
+
+TEST_F(FanImageRendererTest, it_reuses_the_table_while_the_geometry_does_not_change)
+{
+    auto sonar = makeSonar(16, 100);
+    FanImageRenderer renderer(100, 100);
+    vector<float> image;
+    renderer.render(sonar, image);
+    sonar.bins[0] = 1;
+    renderer.render(sonar, image);
+    ASSERT_EQ(1u, renderer.getTableBuilds());
+
+    sonar.bin_duration = sonar.bin_duration * 2;
+    renderer.render(sonar, image);
+    ASSERT_EQ(2u, renderer.getTableBuilds());
+
+    sonar.bearings[0] = base::Angle::fromDeg(-64);
+    renderer.render(sonar, image);
+    ASSERT_EQ(3u, renderer.getTableBuilds());
+
+    auto other = makeSonar(16, 200);
+    other.bin_duration = sonar.bin_duration * 0.5;
+    renderer.render(other, image);
+    ASSERT_EQ(4u, renderer.getTableBuilds());
+}
+
+TEST_F(FanImageRendererTest, it_renders_the_same_image_on_multiple_threads)
+{
+    auto sonar = makeSonar(256, 500);
+    for (size_t i = 0; i < sonar.bins.size(); i++) {
+        sonar.bins[i] = (i % 251) / 250.0;
+    }
+    FanImageRenderer renderer(320, 240);
+    vector<uint8_t> expected;
+    renderer.render(sonar, expected);
+
+    renderer.setThreadCount(4);
+    vector<uint8_t> image;
+    renderer.render(sonar, image);
+    ASSERT_EQ(expected, image);
+}
+
+TEST_F(FanImageRendererTest, it_renders_samples_with_a_single_bin)
+{
+    auto sonar = makeSonar(16, 1);
+    fill(sonar.bins.begin(), sonar.bins.end(), 1);
+    FanImageRenderer renderer(101, 101);
+    vector<float> image;
+    renderer.render(sonar, image);
+    // Just above the sonar, in the middle of the fan
+    ASSERT_EQ(1, image[99 * 101 + 50]);
+}
+
+TEST_F(FanImageRendererTest, it_renders_samples_with_a_single_beam)
+{
+    auto sonar = makeSonar(2, 10);
+    sonar.resize(10, 1, false);
+    fill(sonar.bins.begin(), sonar.bins.end(), 1);
+    sonar.bearings[0] = base::Angle::fromRad(0);
+    FanImageRenderer renderer(101, 101);
+    vector<float> image;
+    renderer.render(sonar, image);
+    // Only the column along the beam is within the fan
+    for (int v = 0; v < 101; v++) {
+        ASSERT_EQ(1, image[v * 101 + 50]) << v;
+    }
+    ASSERT_EQ(0, image[50 * 101 + 49]);
+}
+
+TEST_F(FanImageRendererTest, it_rejects_inconsistent_samples)
+{
+    auto sonar = makeSonar(16, 100);
+    sonar.bins.resize(10);
+    FanImageRenderer renderer(100, 100);
+    vector<float> image;
+    ASSERT_THROW(renderer.render(sonar, image), std::invalid_argument);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/GainCompensation.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct GainCompensationTest : public ::testing::Test {
+    GainCompensation compensation;
+
+    GainCompensationTest()
+    {
+        compensation.enabled = true;
+    }
+};
+
+TEST_F(GainCompensationTest, it_is_disabled_by_default)
+{
+    ASSERT_FALSE(GainCompensation().enabled);
+}
+
+TEST_F(GainCompensationTest, it_compensates_the_spreading_loss)
+{
+    compensation.absorption = 0;
+    vector<float> gains;
+    // Bin centers at 2, 6, 10 and 14 m
+    compensation.computeGains(gains, 4, 4, 750e3, 35);
+    ASSERT_EQ(4u, gains.size());
+    ASSERT_FLOAT_EQ(4, gains[0]);
+    ASSERT_FLOAT_EQ(100, gains[2]);
+}
+
+TEST_F(GainCompensationTest, it_compensates_the_absorption_both_ways)
+{
+    compensation.spreading = 0;
+    compensation.absorption = 0.5;
+    vector<float> gains;
+    compensation.computeGains(gains, 2, 6, 750e3, 35);
+    // 2 * 0.5 dB/m * (11 - 1) m
+    ASSERT_FLOAT_EQ(std::pow(10, 10.0 / 20), gains[5]);
+}
+
+TEST_F(GainCompensationTest, it_leaves_the_bins_before_the_reference_range_untouched)
+{
+    compensation.reference_range = 5;
+    vector<float> gains;
+    compensation.computeGains(gains, 1, 10, 750e3, 35);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(1, gains[i]);
+    }
+    ASSERT_GT(gains[5], 1);
+}
+
+TEST_F(GainCompensationTest, it_clamps_the_gain)
+{
+    compensation.max_gain = 20;
+    vector<float> gains;
+    compensation.computeGains(gains, 1, 200, 1.2e6, 35);
+    ASSERT_FLOAT_EQ(10, gains[199]);
+}
+
+TEST_F(GainCompensationTest, it_only_compensates_the_spreading_if_the_frequency_is_unknown)
+{
+    vector<float> gains;
+    compensation.computeGains(gains, 4, 4, base::unknown<double>(), 35);
+    ASSERT_FLOAT_EQ(100, gains[2]);
+}
+
+TEST_F(GainCompensationTest, it_computes_a_sea_water_absorption_that_grows_with_frequency)
+{
+    double low = GainCompensation::absorptionCoefficient(750e3, 35, 10);
+    double high = GainCompensation::absorptionCoefficient(1.2e6, 35, 10);
+    ASSERT_GT(low, 0.15);
+    ASSERT_LT(low, 0.35);
+    ASSERT_GT(high, low);
+    ASSERT_LT(GainCompensation::absorptionCoefficient(750e3, 0, 10), low);
+}
+
+TEST_F(GainCompensationTest, it_only_keeps_the_pure_water_absorption_in_fresh_water)
+{
+    // Neither the boric acid nor the magnesium sulphate relaxations remain
+    double f = 750;
+    double expected = 0.00049 * f * f * std::exp(-10.0 / 27) / 1e3;
+    ASSERT_DOUBLE_EQ(expected, GainCompensation::absorptionCoefficient(750e3, 0, 10));
+}
+
+TEST_F(GainCompensationTest, the_table_is_only_rebuilt_when_its_inputs_change)
+{
+    GainTable table;
+    double unknown = base::unknown<double>();
+    table.get(compensation, 0.1, 100, unknown, 35);
+    table.get(compensation, 0.1, 100, unknown, 35);
+    ASSERT_EQ(1, table.getTableBuilds());
+
+    table.get(compensation, 0.1, 100, 750e3, 35);
+    table.get(compensation, 0.1, 100, 750e3, 30);
+    table.get(compensation, 0.1, 120, 750e3, 30);
+    table.get(compensation, 0.2, 120, 750e3, 30);
+    compensation.spreading = 30;
+    table.get(compensation, 0.2, 120, 750e3, 30);
+    ASSERT_EQ(6, table.getTableBuilds());
+}
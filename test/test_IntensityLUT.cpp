@@ -0,0 +1,57 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/IntensityLUT.hpp>
+#include <sonar_oculus_m750d/Protocol.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+TEST(IntensityLUTTest, it_is_linear_by_default)
+{
+    IntensityLUT lut;
+    ASSERT_TRUE(lut.isLinear());
+    ASSERT_EQ(INTENSITY_LINEAR, lut.getCurve());
+    for (int i = 0; i < IntensityLUT::SIZE; i++) {
+        ASSERT_EQ(static_cast<float>(i * Protocol::NORMALIZATION_FACTOR), lut[i]);
+    }
+}
+
+TEST(IntensityLUTTest, it_builds_a_gamma_curve)
+{
+    auto lut = IntensityLUT::gamma(0.5);
+    ASSERT_EQ(INTENSITY_GAMMA, lut.getCurve());
+    ASSERT_FALSE(lut.isLinear());
+    ASSERT_EQ(0, lut[0]);
+    ASSERT_FLOAT_EQ(1, lut[255]);
+    ASSERT_FLOAT_EQ(std::sqrt(64 / 255.0), lut[64]);
+}
+
+TEST(IntensityLUTTest, it_builds_a_logarithmic_curve)
+{
+    auto lut = IntensityLUT::logarithmic(100);
+    ASSERT_EQ(INTENSITY_LOG, lut.getCurve());
+    ASSERT_EQ(0, lut[0]);
+    ASSERT_FLOAT_EQ(1, lut[255]);
+    ASSERT_FLOAT_EQ(std::log(1 + 100 * 51 / 255.0) / std::log(101), lut[51]);
+    ASSERT_THROW(IntensityLUT::logarithmic(0), std::runtime_error);
+}
+
+TEST(IntensityLUTTest, it_builds_a_user_curve)
+{
+    auto lut = IntensityLUT::fromCurve([](double x) { return 1 - x; });
+    ASSERT_EQ(INTENSITY_USER, lut.getCurve());
+    ASSERT_FLOAT_EQ(1, lut[0]);
+    ASSERT_FLOAT_EQ(0, lut[255]);
+}
+
+TEST(IntensityLUTTest, it_accepts_a_user_table_of_256_entries)
+{
+    vector<float> table(256);
+    for (int i = 0; i < 256; i++) {
+        table[i] = i * 2;
+    }
+    auto lut = IntensityLUT::fromTable(table);
+    ASSERT_EQ(INTENSITY_USER, lut.getCurve());
+    ASSERT_EQ(20, lut[10]);
+    ASSERT_THROW(IntensityLUT::fromTable(vector<float>(255)), std::runtime_error);
+}
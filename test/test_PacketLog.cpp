@@ -0,0 +1,219 @@
+#include "Helpers.hpp"
+#include <gtest/gtest.h>
+#include <iodrivers_base/TestStream.hpp>
+#include <sonar_oculus_m750d/Driver.hpp>
+#include <sonar_oculus_m750d/PacketLogReader.hpp>
+#include <sonar_oculus_m750d/PacketLogWriter.hpp>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+using namespace test_helpers;
+
+struct PacketLogTest : public ::testing::Test {
+    string path;
+
+    PacketLogTest()
+    {
+        char path_template[] = "/tmp/sonar_oculus_m750d_logXXXXXX";
+        int fd = mkstemp(path_template);
+        close(fd);
+        path = path_template;
+    }
+
+    ~PacketLogTest()
+    {
+        unlink(path.c_str());
+    }
+
+    static vector<uint8_t> ping(uint8_t value)
+    {
+        return simplePingResult2({100, -50, -200}, {value, 0, 0, 0, 0, 0}, 2);
+    }
+
+    static void write(PacketLogWriter& writer, vector<uint8_t> const& packet, int64_t time_ms)
+    {
+        writer.write(packet.data(), packet.size(), base::Time::fromMilliseconds(time_ms));
+    }
+
+    static vector<uint8_t> toVector(LoggedPacket const& packet)
+    {
+        return vector<uint8_t>(packet.data, packet.data + packet.size);
+    }
+
+    void writeLog()
+    {
+        PacketLogWriter writer(path);
+        write(writer, ping(1), 1000);
+        write(writer, message(messageUserConfig), 1010);
+        write(writer, ping(2), 1020);
+        write(writer, ping(3), 1040);
+        writer.close();
+    }
+};
+
+TEST_F(PacketLogTest, it_reads_back_the_recorded_packets_in_order)
+{
+    writeLog();
+
+    PacketLogReader reader(path);
+    ASSERT_TRUE(reader.hasIndex());
+    ASSERT_EQ(4, reader.getPacketCount());
+    ASSERT_EQ(3, reader.getPingCount());
+
+    LoggedPacket packet;
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_EQ(ping(1), toVector(packet));
+    ASSERT_EQ(base::Time::fromMilliseconds(1000), packet.time);
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_EQ(message(messageUserConfig), toVector(packet));
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_EQ(ping(3), toVector(packet));
+    ASSERT_FALSE(reader.next(packet));
+}
+
+TEST_F(PacketLogTest, it_gives_random_access_to_the_pings)
+{
+    writeLog();
+
+    PacketLogReader reader(path);
+    ASSERT_EQ(ping(2), toVector(reader.ping(1)));
+    ASSERT_EQ(base::Time::fromMilliseconds(1020), reader.ping(1).time);
+    ASSERT_THROW(reader.ping(3), std::out_of_range);
+
+    reader.seekToPing(2);
+    LoggedPacket packet;
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_EQ(ping(3), toVector(packet));
+    ASSERT_FALSE(reader.next(packet));
+}
+
+TEST_F(PacketLogTest, it_does_not_copy_the_packets)
+{
+    writeLog();
+
+    PacketLogReader reader(path);
+    LoggedPacket first;
+    reader.next(first);
+    ASSERT_EQ(reader.ping(0).data, first.data);
+}
+
+TEST_F(PacketLogTest, it_rebuilds_the_index_of_an_interrupted_recording)
+{
+    writeLog();
+    // Remove the index and footer, and truncate the last record
+    auto recordSize = [](size_t size) { return 16 + (size + 7) / 8 * 8; };
+    size_t complete = 16 + recordSize(ping(1).size()) * 2 +
+                      recordSize(message(messageUserConfig).size());
+    ASSERT_EQ(0, truncate(path.c_str(), complete + 16 + 10));
+
+    PacketLogReader reader(path);
+    ASSERT_FALSE(reader.hasIndex());
+    ASSERT_EQ(3, reader.getPacketCount());
+    ASSERT_EQ(2, reader.getPingCount());
+    ASSERT_EQ(ping(2), toVector(reader.ping(1)));
+}
+
+TEST_F(PacketLogTest, it_rebuilds_an_index_that_points_outside_of_the_records)
+{
+    // The index has one entry per ping, just before the 32 bytes footer
+    auto corruptIndex = [this](int entry, uint64_t offset) {
+        FILE* file = fopen(path.c_str(), "r+");
+        ASSERT_EQ(0, fseek(file, -32 - 8 * (3 - entry), SEEK_END));
+        ASSERT_EQ(1u, fwrite(&offset, sizeof(offset), 1, file));
+        fclose(file);
+    };
+
+    writeLog();
+    corruptIndex(0, 1ull << 40);
+    PacketLogReader beyond_the_file(path);
+    ASSERT_FALSE(beyond_the_file.hasIndex());
+    ASSERT_EQ(3, beyond_the_file.getPingCount());
+    ASSERT_EQ(ping(1), toVector(beyond_the_file.ping(0)));
+
+    writeLog();
+    struct stat info;
+    ASSERT_EQ(0, stat(path.c_str(), &info));
+    corruptIndex(2, info.st_size - 32 - 24);
+    PacketLogReader into_the_index(path);
+    ASSERT_FALSE(into_the_index.hasIndex());
+    ASSERT_EQ(4, into_the_index.getPacketCount());
+    ASSERT_EQ(ping(3), toVector(into_the_index.ping(2)));
+}
+
+TEST_F(PacketLogTest, it_skips_the_records_that_are_not_valid_packets)
+{
+    writeLog();
+    // Point the image of the second ping beyond the end of its record
+    auto recordSize = [](size_t size) { return 16 + (size + 7) / 8 * 8; };
+    long offset = 16 + recordSize(ping(1).size()) +
+                  recordSize(message(messageUserConfig).size()) + 16 +
+                  offsetof(OculusSimplePingResult2, imageOffset);
+    uint32_t image_offset = ping(2).size();
+    FILE* file = fopen(path.c_str(), "r+");
+    ASSERT_EQ(0, fseek(file, offset, SEEK_SET));
+    ASSERT_EQ(1u, fwrite(&image_offset, sizeof(image_offset), 1, file));
+    fclose(file);
+
+    PacketLogReader reader(path);
+    ASSERT_THROW(reader.ping(1), std::runtime_error);
+    ASSERT_EQ(ping(3), toVector(reader.ping(2)));
+
+    vector<vector<uint8_t>> packets;
+    LoggedPacket packet;
+    while (reader.next(packet)) {
+        packets.push_back(toVector(packet));
+    }
+    ASSERT_EQ(3u, packets.size());
+    ASSERT_EQ(ping(1), packets[0]);
+    ASSERT_EQ(ping(3), packets[2]);
+    ASSERT_EQ(1u, reader.getRejectedRecordCount());
+}
+
+TEST_F(PacketLogTest, it_replays_at_the_recorded_speed)
+{
+    writeLog();
+
+    PacketLogReader reader(path);
+    reader.setReplaySpeed(REPLAY_RECORDED_SPEED);
+    base::Time start = base::Time::now();
+    LoggedPacket packet;
+    while (reader.next(packet)) {
+    }
+    ASSERT_LE(base::Time::fromMilliseconds(40), base::Time::now() - start);
+}
+
+TEST_F(PacketLogTest, it_rejects_files_that_are_not_packet_logs)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    fputs("this is not a packet log", file);
+    fclose(file);
+    ASSERT_THROW(PacketLogReader reader(path), std::runtime_error);
+}
+
+TEST_F(PacketLogTest, the_driver_records_and_the_replay_decodes_the_packets)
+{
+    Driver driver(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    driver.openURI("test://");
+    driver.startRecording(path);
+    auto stream = dynamic_cast<iodrivers_base::TestStream*>(driver.getMainStream());
+    stream->pushDataToDriver(ping(1));
+    stream->pushDataToDriver(ping(2));
+    base::samples::Sonar sonar;
+    ASSERT_TRUE(driver.processOne(sonar));
+    ASSERT_TRUE(driver.processOne(sonar));
+    driver.stopRecording();
+
+    PacketLogReader reader(path);
+    Driver replay(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    LoggedPacket packet;
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_TRUE(replay.decodePacket(packet.data, packet.size, packet.time, sonar));
+    ASSERT_FLOAT_EQ(1 / 255.0, sonar.bins[0]);
+    ASSERT_TRUE(reader.next(packet));
+    ASSERT_TRUE(replay.decodePacket(packet.data, packet.size, packet.time, sonar));
+    ASSERT_FLOAT_EQ(2 / 255.0, sonar.bins[0]);
+}
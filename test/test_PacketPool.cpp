@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/PacketPool.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+TEST(PacketPool, it_allocates_buffers_of_the_configured_size)
+{
+    PacketPool pool(128);
+    PacketBuffer buffer = pool.acquire();
+    ASSERT_TRUE(buffer.valid());
+    ASSERT_EQ(128, buffer.capacity());
+    ASSERT_EQ(0, buffer.size());
+    ASSERT_EQ(1, pool.getStatistics().allocations);
+    ASSERT_EQ(1, pool.getStatistics().in_use);
+}
+
+TEST(PacketPool, it_reuses_released_buffers)
+{
+    PacketPool pool(128);
+    uint8_t* data = nullptr;
+    {
+        PacketBuffer buffer = pool.acquire();
+        data = buffer.data();
+        buffer.resize(10);
+    }
+    ASSERT_EQ(1, pool.getStatistics().idle);
+
+    PacketBuffer buffer = pool.acquire();
+    ASSERT_EQ(data, buffer.data());
+    ASSERT_EQ(0, buffer.size());
+    auto stats = pool.getStatistics();
+    ASSERT_EQ(1, stats.allocations);
+    ASSERT_EQ(1, stats.reuses);
+    ASSERT_EQ(0, stats.idle);
+}
+
+TEST(PacketPool, it_shares_the_buffer_between_copies_of_a_handle)
+{
+    PacketPool pool(128);
+    PacketBuffer buffer = pool.acquire();
+    PacketBuffer copy = buffer;
+    ASSERT_EQ(buffer.data(), copy.data());
+    ASSERT_EQ(2, buffer.useCount());
+
+    buffer.reset();
+    ASSERT_FALSE(buffer.valid());
+    ASSERT_EQ(1, pool.getStatistics().in_use);
+    copy.reset();
+    ASSERT_EQ(0, pool.getStatistics().in_use);
+    ASSERT_EQ(1, pool.getStatistics().idle);
+}
+
+TEST(PacketPool, it_does_not_keep_more_than_max_idle_buffers)
+{
+    PacketPool pool(128, 2);
+    {
+        PacketBuffer a = pool.acquire();
+        PacketBuffer b = pool.acquire();
+        PacketBuffer c = pool.acquire();
+    }
+    ASSERT_EQ(2, pool.getStatistics().idle);
+}
+
+TEST(PacketPool, it_frees_buffers_of_the_old_size_when_resized)
+{
+    PacketPool pool(128);
+    PacketBuffer in_use = pool.acquire();
+    pool.acquire();
+    ASSERT_EQ(1, pool.getStatistics().idle);
+
+    pool.setBufferSize(256);
+    ASSERT_EQ(0, pool.getStatistics().idle);
+    in_use.reset();
+    ASSERT_EQ(0, pool.getStatistics().idle);
+    ASSERT_EQ(256, pool.acquire().capacity());
+}
+
+TEST(PacketPool, it_throws_if_resized_beyond_the_capacity)
+{
+    PacketPool pool(128);
+    PacketBuffer buffer = pool.acquire();
+    ASSERT_THROW(buffer.resize(129), std::length_error);
+}
+
+TEST(PacketPool, buffers_can_outlive_their_pool)
+{
+    PacketBuffer buffer;
+    {
+        PacketPool pool(128);
+        buffer = pool.acquire();
+    }
+    buffer.data()[127] = 42;
+    ASSERT_EQ(42, buffer.data()[127]);
+    buffer.reset();
+}
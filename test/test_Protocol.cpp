@@ -1,10 +1,14 @@
+#include "Helpers.hpp"
 #include <gtest/gtest.h>
+#include <sonar_oculus_m750d/Oculus.h>
 #include <sonar_oculus_m750d/Protocol.hpp>
 
 #include <iostream>
+#include <string.h>
 
 using namespace sonar_oculus_m750d;
 using namespace std;
+using namespace test_helpers;
 
 struct ProtocolTest : public ::testing::Test {
     Protocol protocol = Protocol();
@@ -29,3 +33,316 @@ TEST_F(ProtocolTest, it_calculates_the_bin_duration)
     auto expected_bin_duration = base::Time::fromSeconds(5e-4);
     ASSERT_EQ(expected_bin_duration, bin_duration);
 }
+
+TEST_F(ProtocolTest, it_decodes_a_simple_ping_result_from_the_packet_bytes)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    ASSERT_TRUE(protocol.handleBuffer(buffer.data(), buffer.size()));
+
+    auto const& ping = protocol.getPingView();
+    ASSERT_EQ(buffer.data() + buffer.size() - 6, ping.image);
+    ASSERT_EQ(3, ping.beam_count);
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(3, sonar.beam_count);
+    ASSERT_EQ(2, sonar.bin_count);
+    std::vector<float> expected_bins = {0, 0.4, 0.2, 0.6, 1, 0.8};
+    for (size_t i = 0; i < expected_bins.size(); i++) {
+        ASSERT_FLOAT_EQ(expected_bins[i], sonar.bins[i]);
+    }
+    ASSERT_FLOAT_EQ(-1, sonar.bearings[0].getDeg());
+    ASSERT_FLOAT_EQ(0.5, sonar.bearings[1].getDeg());
+    ASSERT_FLOAT_EQ(2, sonar.bearings[2].getDeg());
+}
+
+TEST_F(ProtocolTest, it_rejects_a_ping_whose_image_is_too_small)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 3);
+    ASSERT_THROW(protocol.handleBuffer(buffer.data(), buffer.size()), std::runtime_error);
+}
+
+TEST_F(ProtocolTest, it_reuses_the_memory_of_a_caller_owned_sample)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    base::samples::Sonar sonar;
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    auto const* bins = sonar.bins.data();
+    auto const* bearings = sonar.bearings.data();
+
+    buffer.back() = 0;
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(bins, sonar.bins.data());
+    ASSERT_EQ(bearings, sonar.bearings.data());
+    ASSERT_FLOAT_EQ(0, sonar.bins[5]);
+}
+
+TEST_F(ProtocolTest, it_updates_the_bearings_when_the_bearing_table_changes)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    base::samples::Sonar sonar;
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+
+    buffer = simplePingResult2({300, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_FLOAT_EQ(-3, sonar.bearings[0].getDeg());
+}
+
+TEST_F(ProtocolTest, it_converts_the_bearing_table_only_once_for_consecutive_pings)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    base::samples::Sonar sonar;
+    for (int i = 0; i < 3; i++) {
+        protocol.handleBuffer(buffer.data(), buffer.size());
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    }
+    auto stats = protocol.getBearingCacheStatistics();
+    ASSERT_EQ(1, stats.misses);
+    ASSERT_EQ(2, stats.hits);
+}
+
+TEST_F(ProtocolTest, it_decodes_16_bit_images)
+{
+    vector<uint16_t> samples = {0, 13107, 65535, 26214, 39321, 52428};
+    vector<uint8_t> image(samples.size() * 2);
+    memcpy(image.data(), samples.data(), image.size());
+    auto buffer = simplePingResult2({100, -50, -200}, image, 2, dataSize16Bit);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    std::vector<float> expected_bins = {0, 0.4, 0.2, 0.6, 1, 0.8};
+    ASSERT_EQ(6, sonar.bins.size());
+    for (size_t i = 0; i < expected_bins.size(); i++) {
+        ASSERT_FLOAT_EQ(expected_bins[i], sonar.bins[i]);
+    }
+}
+
+TEST_F(ProtocolTest, it_rejects_a_ping_that_extends_past_the_buffer)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    // The image, then the bearings, then the header are cut
+    ASSERT_THROW(protocol.handleBuffer(buffer.data(), buffer.size() - 1), std::runtime_error);
+    ASSERT_THROW(protocol.handleBuffer(buffer.data(), sizeof(OculusSimplePingResult2) + 4),
+        std::runtime_error);
+    ASSERT_THROW(protocol.handleBuffer(buffer.data(), sizeof(OculusSimplePingResult2) - 1),
+        std::runtime_error);
+    ASSERT_THROW(protocol.handleBuffer(buffer.data(), 4), std::runtime_error);
+
+    auto full = pingResult({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    ASSERT_THROW(protocol.handleBuffer(full.data(), full.size() - 1), std::runtime_error);
+    ASSERT_TRUE(protocol.handleBuffer(full.data(), full.size()));
+}
+
+TEST_F(ProtocolTest, it_rejects_a_16_bit_ping_whose_image_only_holds_8_bit_samples)
+{
+    auto buffer =
+        simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2, dataSize16Bit);
+    ASSERT_THROW(protocol.handleBuffer(buffer.data(), buffer.size()), std::runtime_error);
+}
+
+TEST_F(ProtocolTest, it_decodes_a_full_ping_result)
+{
+    auto buffer = pingResult({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    protocol.setSpeedOfSound(1000);
+    ASSERT_TRUE(protocol.handleBuffer(buffer.data(), buffer.size()));
+    ASSERT_EQ(messagePingResult, protocol.getPingMessageType());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(3, sonar.beam_count);
+    ASSERT_EQ(2, sonar.bin_count);
+    ASSERT_EQ(base::Time::fromSeconds(5e-3), sonar.bin_duration);
+    std::vector<float> expected_bins = {0, 0.4, 0.2, 0.6, 1, 0.8};
+    for (size_t i = 0; i < expected_bins.size(); i++) {
+        ASSERT_FLOAT_EQ(expected_bins[i], sonar.bins[i]);
+    }
+    ASSERT_FLOAT_EQ(-1, sonar.bearings[0].getDeg());
+}
+
+TEST_F(ProtocolTest, it_reports_the_message_type_of_simple_ping_results)
+{
+    auto buffer = simplePingResult2({100, -50, -200}, {0, 51, 255, 102, 153, 204}, 2);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    ASSERT_EQ(messageSimplePingResult, protocol.getPingMessageType());
+}
+
+TEST_F(ProtocolTest, it_refuses_to_parse_before_a_ping_was_received)
+{
+    ASSERT_THROW(protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20)),
+        std::runtime_error);
+}
+
+struct ProtocolRegionTest : public ProtocolTest {
+    /** 4 beams at 3, 1, -1 and -3 degrees, 6 bins of 10 cm */
+    vector<uint8_t> buffer = simplePingResult2({-300, -100, 100, 300},
+        {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24},
+        6);
+
+    /** The value of the sample at the given bin and beam */
+    static float sample(int bin, int beam)
+    {
+        return (bin * 4 + beam + 1) / 255.0;
+    }
+};
+
+TEST_F(ProtocolRegionTest, it_crops_the_ping)
+{
+    DecodeRegion region;
+    region.min_range = 0.2;
+    region.max_range = 0.45;
+    region.first_beam = 1;
+    region.beam_count = 2;
+    protocol.setDecodeRegion(region);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(2, sonar.beam_count);
+    ASSERT_EQ(5, sonar.bin_count);
+    ASSERT_EQ(Protocol::binDuration(0.6, 1500, 6), sonar.bin_duration);
+    ASSERT_FLOAT_EQ(1, sonar.bearings[0].getDeg());
+    ASSERT_FLOAT_EQ(-1, sonar.bearings[1].getDeg());
+    for (int j = 0; j < 2; j++) {
+        ASSERT_EQ(0, sonar.bins[j * 5]);
+        ASSERT_EQ(0, sonar.bins[j * 5 + 1]);
+        for (int i = 2; i < 5; i++) {
+            ASSERT_FLOAT_EQ(sample(i, j + 1), sonar.bins[j * 5 + i]);
+        }
+    }
+}
+
+TEST_F(ProtocolRegionTest, it_decimates_the_ping)
+{
+    DecodeRegion region;
+    region.range_decimation = 2;
+    region.beam_decimation = 2;
+    region.pooling = POOLING_MEAN;
+    protocol.setDecodeRegion(region);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(2, sonar.beam_count);
+    ASSERT_EQ(3, sonar.bin_count);
+    ASSERT_EQ(Protocol::binDuration(1.2, 1500, 6), sonar.bin_duration);
+    ASSERT_FLOAT_EQ(2, sonar.bearings[0].getDeg());
+    ASSERT_FLOAT_EQ(-2, sonar.bearings[1].getDeg());
+    ASSERT_FLOAT_EQ(3.5 / 255, sonar.bins[0]);
+    ASSERT_FLOAT_EQ(21.5 / 255, sonar.bins[5]);
+
+    region.pooling = POOLING_MAX;
+    protocol.setDecodeRegion(region);
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_FLOAT_EQ(6 / 255.0, sonar.bins[0]);
+    ASSERT_FLOAT_EQ(24 / 255.0, sonar.bins[5]);
+}
+
+TEST_F(ProtocolRegionTest, it_applies_the_region_to_compact_samples)
+{
+    DecodeRegion region;
+    region.max_range = 0.3;
+    region.beam_decimation = 4;
+    protocol.setDecodeRegion(region);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    CompactSonar sonar;
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(1u, sonar.beam_count);
+    ASSERT_EQ(3u, sonar.bin_count);
+    ASSERT_EQ(vector<uint8_t>({4, 8, 12}), sonar.bins);
+    ASSERT_NEAR(0, sonar.bearings[0].getDeg(), 1e-9);
+}
+
+TEST_F(ProtocolRegionTest, it_converts_the_whole_ping_with_the_default_region)
+{
+    protocol.setDecodeRegion(DecodeRegion());
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(4, sonar.beam_count);
+    ASSERT_EQ(6, sonar.bin_count);
+    ASSERT_FLOAT_EQ(sample(5, 3), sonar.bins[3 * 6 + 5]);
+}
+
+TEST_F(ProtocolRegionTest, it_compensates_the_transmission_loss)
+{
+    GainCompensation compensation;
+    compensation.enabled = true;
+    compensation.spreading = 20;
+    compensation.absorption = 0;
+    compensation.reference_range = 0.05;
+    protocol.setGainCompensation(compensation);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    // Bin i covers [0.1 i, 0.1 (i + 1)), its gain is range / reference_range
+    for (int i = 0; i < 6; i++) {
+        float gain = (i + 0.5) * 0.1 / 0.05;
+        ASSERT_FLOAT_EQ(sample(i, 2) * gain, sonar.bins[2 * 6 + i]) << i;
+    }
+
+    // Compact samples keep the raw bytes, and toSonar applies the gains
+    CompactSonar compact;
+    protocol.parseSonar(compact, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(7, compact.bins[2 * 6 + 1]);
+    ASSERT_EQ(6u, compact.gains.size());
+    ASSERT_EQ(sonar.bins, compact.toSonar().bins);
+}
+
+TEST_F(ProtocolRegionTest, it_computes_the_gains_only_when_the_pings_change)
+{
+    GainCompensation compensation;
+    compensation.enabled = true;
+    protocol.setGainCompensation(compensation);
+    base::samples::Sonar sonar;
+    for (int i = 0; i < 3; i++) {
+        protocol.handleBuffer(buffer.data(), buffer.size());
+        protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    }
+    ASSERT_EQ(1, protocol.getGainTableBuilds());
+
+    DecodeRegion region;
+    region.range_decimation = 2;
+    protocol.setDecodeRegion(region);
+    protocol.parseSonar(sonar, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(2, protocol.getGainTableBuilds());
+}
+
+TEST_F(ProtocolRegionTest, it_does_not_compensate_by_default)
+{
+    protocol.handleBuffer(buffer.data(), buffer.size());
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_FLOAT_EQ(sample(5, 3), sonar.bins[3 * 6 + 5]);
+    ASSERT_EQ(0, protocol.getGainTableBuilds());
+}
+
+TEST_F(ProtocolRegionTest, it_maps_the_samples_through_the_intensity_table)
+{
+    auto lut = IntensityLUT::gamma(0.5);
+    protocol.setIntensityLUT(lut);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 6; i++) {
+            ASSERT_EQ(lut[i * 4 + j + 1], sonar.bins[j * 6 + i]);
+        }
+    }
+
+    CompactSonar compact;
+    protocol.parseSonar(compact, base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(2 * 4 + 3 + 1, compact.bins[3 * 6 + 2]);
+}
+
+TEST_F(ProtocolRegionTest, it_maps_decimated_pings_through_the_intensity_table)
+{
+    auto lut = IntensityLUT::gamma(0.5);
+    protocol.setIntensityLUT(lut);
+    DecodeRegion region;
+    region.range_decimation = 2;
+    protocol.setDecodeRegion(region);
+    protocol.handleBuffer(buffer.data(), buffer.size());
+
+    auto sonar = protocol.parseSonar(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    ASSERT_EQ(lut[5], sonar.bins[0]);
+    ASSERT_EQ(lut[24], sonar.bins[3 * 3 + 2]);
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/Driver.hpp>
+#include <sonar_oculus_m750d/Simulator.hpp>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct SimulatorTest : public ::testing::Test {
+    SimulatorConfiguration config;
+    unique_ptr<Simulator> simulator;
+    unique_ptr<Driver> driver;
+
+    SimulatorTest()
+    {
+        config.beam_count = 256;
+        config.range = 10;
+        config.range_resolution = 0.05;
+        config.ping_rate = 100;
+    }
+
+    ~SimulatorTest()
+    {
+        driver.reset();
+        if (simulator) {
+            simulator->stop();
+        }
+    }
+
+    void connect()
+    {
+        simulator.reset(new Simulator(config));
+        simulator->start();
+        driver.reset(new Driver(base::Angle::fromDeg(1),
+            base::Angle::fromDeg(20),
+            Driver::maxPacketSize(512, 2000, dataSize16Bit)));
+        driver->setReadTimeout(base::Time::fromSeconds(2));
+        driver->openURI("tcp://127.0.0.1:" + to_string(simulator->getPort()));
+    }
+
+    M750DConfiguration fireConfiguration()
+    {
+        M750DConfiguration conf;
+        conf.mode = 1;
+        conf.range = 10;
+        conf.gain = 0.5;
+        conf.speed_of_sound = 1500;
+        return conf;
+    }
+
+    base::samples::Sonar nextPing()
+    {
+        base::samples::Sonar sonar;
+        for (int i = 0; i < 100; i++) {
+            if (driver->processOne(sonar)) {
+                return sonar;
+            }
+        }
+        throw std::runtime_error("no ping received");
+    }
+};
+
+TEST_F(SimulatorTest, it_streams_pings_once_fired)
+{
+    connect();
+    driver->fireSonar(fireConfiguration(), UPDATE_40HZ_MAX);
+
+    auto sonar = nextPing();
+    ASSERT_EQ(256, sonar.beam_count);
+    ASSERT_EQ(200, sonar.bin_count);
+    ASSERT_EQ(256 * 200, sonar.bins.size());
+    ASSERT_NEAR(65, sonar.bearings.front().getDeg(), 1e-6);
+    ASSERT_EQ(1, simulator->getStatistics().fire_messages_received);
+}
+
+TEST_F(SimulatorTest, it_follows_the_range_and_data_size_requested_by_the_fire_message)
+{
+    config.beam_count = 512;
+    connect();
+    auto conf = fireConfiguration();
+    conf.range = 20;
+    conf.data_16bit = true;
+    driver->fireSonar(conf, UPDATE_40HZ_MAX);
+
+    auto sonar = nextPing();
+    ASSERT_EQ(512, sonar.beam_count);
+    ASSERT_EQ(400, sonar.bin_count);
+}
+
+TEST_F(SimulatorTest, it_sends_pings_faster_than_40Hz)
+{
+    config.ping_rate = 200;
+    connect();
+    driver->fireSonar(fireConfiguration(), UPDATE_40HZ_MAX);
+
+    nextPing();
+    base::Time start = base::Time::now();
+    for (int i = 0; i < 20; i++) {
+        nextPing();
+    }
+    ASSERT_GT(base::Time::fromMilliseconds(500), base::Time::now() - start);
+    ASSERT_EQ(0, driver->getStatistics().ping_id_gaps);
+}
+
+TEST_F(SimulatorTest, the_driver_reassembles_fragmented_packets)
+{
+    config.max_fragment_size = 512;
+    connect();
+    driver->fireSonar(fireConfiguration(), UPDATE_40HZ_MAX);
+
+    for (int i = 0; i < 5; i++) {
+        nextPing();
+    }
+    ASSERT_EQ(0, driver->getResyncStatistics().resync_events);
+}
+
+TEST_F(SimulatorTest, the_driver_recovers_from_corrupted_packets)
+{
+    config.corruption_probability = 0.5;
+    config.seed = 42;
+    connect();
+    driver->fireSonar(fireConfiguration(), UPDATE_40HZ_MAX);
+
+    int pings = 0;
+    base::samples::Sonar sonar;
+    while (pings < 20) {
+        try {
+            if (driver->processOne(sonar)) {
+                pings++;
+            }
+        }
+        catch (std::runtime_error const&) {
+            // Corrupted ping content, the driver must go on with the next one
+        }
+    }
+    ASSERT_LT(0, simulator->getStatistics().corruptions);
+    ASSERT_LT(0, driver->getResyncStatistics().resync_events);
+}
+
+TEST_F(SimulatorTest, the_driver_waits_through_stalls)
+{
+    config.stall_probability = 1;
+    config.stall_duration = base::Time::fromMilliseconds(20);
+    connect();
+    driver->fireSonar(fireConfiguration(), UPDATE_40HZ_MAX);
+
+    nextPing();
+    nextPing();
+    ASSERT_LE(2, simulator->getStatistics().stalls);
+}
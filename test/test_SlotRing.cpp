@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/SlotRing.hpp>
+
+#include <thread>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct SlotRingTest : public ::testing::Test {
+    SlotRing<int> ring = SlotRing<int>(2);
+
+    void push(int value)
+    {
+        ring.writeSlot() = value;
+        ring.publish();
+    }
+
+    int pop()
+    {
+        int* value = ring.acquire(base::Time());
+        if (!value) {
+            throw std::runtime_error("empty ring");
+        }
+        int result = *value;
+        ring.release();
+        return result;
+    }
+};
+
+TEST_F(SlotRingTest, it_returns_the_elements_in_order)
+{
+    push(1);
+    push(2);
+    ASSERT_EQ(1, pop());
+    ASSERT_EQ(2, pop());
+}
+
+TEST_F(SlotRingTest, it_drops_the_oldest_element_when_full)
+{
+    push(1);
+    push(2);
+    ring.writeSlot() = 3;
+    ASSERT_FALSE(ring.publish());
+    ASSERT_EQ(2, pop());
+    ASSERT_EQ(3, pop());
+    ASSERT_EQ(1, ring.dropped());
+}
+
+TEST_F(SlotRingTest, it_does_not_hand_out_the_slot_held_by_the_consumer)
+{
+    push(1);
+    int* held = ring.acquire(base::Time());
+    for (int i = 0; i < 10; i++) {
+        push(i + 2);
+    }
+    ASSERT_EQ(1, *held);
+}
+
+TEST_F(SlotRingTest, it_times_out_when_empty)
+{
+    ASSERT_EQ(nullptr, ring.acquire(base::Time::fromMilliseconds(10)));
+}
+
+TEST_F(SlotRingTest, it_wakes_up_the_consumer_on_close)
+{
+    std::thread closer([this] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ring.close();
+    });
+    ASSERT_EQ(nullptr, ring.acquire(base::Time::fromSeconds(10)));
+    closer.join();
+}
+
+TEST_F(SlotRingTest, it_passes_elements_between_threads)
+{
+    SlotRing<int> ring(1000);
+    std::thread producer([&ring] {
+        for (int i = 0; i < 1000; i++) {
+            ring.writeSlot() = i;
+            ring.publish();
+        }
+    });
+    for (int i = 0; i < 1000; i++) {
+        int* value = ring.acquire(base::Time::fromSeconds(1));
+        ASSERT_NE(nullptr, value);
+        ASSERT_EQ(i, *value);
+    }
+    producer.join();
+}
+
+TEST(SlotRingDepthTest, it_refuses_a_null_depth)
+{
+    ASSERT_THROW(SlotRing<int>(0), std::runtime_error);
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/Driver.hpp>
+#include <sonar_oculus_m750d/Simulator.hpp>
+#include <sonar_oculus_m750d/SonarManager.hpp>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct SonarManagerTest : public ::testing::Test {
+    vector<unique_ptr<Simulator>> simulators;
+    unique_ptr<SonarManager> manager;
+
+    ~SonarManagerTest()
+    {
+        manager.reset();
+        for (auto& simulator : simulators) {
+            simulator->stop();
+        }
+    }
+
+    void startDevices(size_t count, size_t workers = 2)
+    {
+        manager.reset(new SonarManager(workers));
+        for (size_t i = 0; i < count; i++) {
+            SimulatorConfiguration config;
+            config.beam_count = 256;
+            config.range_resolution = 0.05;
+            config.ping_rate = 100;
+            config.device_id = 10 + i;
+            simulators.emplace_back(new Simulator(config));
+            simulators.back()->start();
+            manager->addDevice(
+                "tcp://127.0.0.1:" + to_string(simulators.back()->getPort()),
+                base::Angle::fromDeg(1),
+                base::Angle::fromDeg(20));
+        }
+    }
+
+    static M750DConfiguration fireConfiguration(double range)
+    {
+        M750DConfiguration conf;
+        conf.mode = 1;
+        conf.range = range;
+        conf.gain = 0.5;
+        conf.speed_of_sound = 1500;
+        return conf;
+    }
+};
+
+TEST_F(SonarManagerTest, it_tags_the_samples_with_the_device_they_come_from)
+{
+    startDevices(2);
+    manager->configure(0, fireConfiguration(5), UPDATE_40HZ_MAX);
+    manager->configure(1, fireConfiguration(10), UPDATE_40HZ_MAX);
+    manager->start();
+
+    vector<int> counts(2);
+    DeviceSonar sample;
+    for (int i = 0; i < 40; i++) {
+        ASSERT_TRUE(manager->pop(sample, base::Time::fromSeconds(2)));
+        ASSERT_LT(sample.device, 2u);
+        counts[sample.device]++;
+        ASSERT_EQ(10 + sample.device, sample.device_id);
+        ASSERT_EQ(partNumberM750d, sample.part_number);
+        // Each device pings with its own range
+        ASSERT_EQ(sample.device == 0 ? 100 : 200, sample.sonar.bin_count);
+    }
+    ASSERT_GT(counts[0], 0);
+    ASSERT_GT(counts[1], 0);
+
+    auto stats = manager->getStatistics();
+    ASSERT_GE(stats.samples_decoded, 40u);
+    ASSERT_EQ(0u, stats.decode_errors);
+}
+
+TEST_F(SonarManagerTest, it_decodes_the_pings_of_a_device_in_order)
+{
+    startDevices(1, 4);
+    manager->configure(0, fireConfiguration(5), UPDATE_40HZ_MAX);
+    manager->start();
+
+    DeviceSonar sample;
+    base::Time last;
+    for (int i = 0; i < 30; i++) {
+        ASSERT_TRUE(manager->pop(sample, base::Time::fromSeconds(2)));
+        ASSERT_LT(last, sample.sonar.time);
+        last = sample.sonar.time;
+    }
+    ASSERT_EQ(0u, manager->getDriver(0).getStatistics().ping_id_gaps);
+}
+
+TEST_F(SonarManagerTest, it_keeps_each_device_alive)
+{
+    startDevices(2);
+    for (size_t i = 0; i < 2; i++) {
+        manager->getDriver(i).setKeepalivePeriod(base::Time::fromMilliseconds(50));
+        manager->configure(i, fireConfiguration(5), UPDATE_40HZ_MAX);
+    }
+    manager->start();
+    usleep(500000);
+    manager->stop();
+
+    for (size_t i = 0; i < 2; i++) {
+        ASSERT_GE(simulators[i]->getStatistics().fire_messages_received, 3u);
+        ASSERT_GE(manager->getDriver(i).getKeepaliveStatistics().keepalives_sent, 3u);
+    }
+}
+
+TEST_F(SonarManagerTest, it_reports_a_device_failure_once_and_goes_on_with_the_others)
+{
+    startDevices(2);
+    manager->configure(0, fireConfiguration(5), UPDATE_40HZ_MAX);
+    manager->configure(1, fireConfiguration(5), UPDATE_40HZ_MAX);
+    manager->start();
+    simulators[0]->stop();
+
+    DeviceSonar sample;
+    bool thrown = false;
+    for (int i = 0; i < 100 && !thrown; i++) {
+        try {
+            manager->pop(sample, base::Time::fromSeconds(2));
+        }
+        catch (std::exception const&) {
+            thrown = true;
+        }
+    }
+    ASSERT_TRUE(thrown);
+
+    // The last packets of the stopped device may still be in the queues
+    int count = 0;
+    for (int i = 0; i < 30 && count < 10; i++) {
+        ASSERT_TRUE(manager->pop(sample, base::Time::fromSeconds(2)));
+        count += sample.device == 1;
+    }
+    ASSERT_EQ(10, count);
+}
+
+TEST_F(SonarManagerTest, it_applies_conversion_settings_changed_while_running)
+{
+    startDevices(1);
+    manager->configure(0, fireConfiguration(5), UPDATE_40HZ_MAX);
+    manager->start();
+
+    Driver& driver = manager->getDriver(0);
+    DeviceSonar sample;
+    for (int i = 0; i < 20; i++) {
+        DecodeRegion region;
+        region.range_decimation = 1 + i % 2;
+        driver.setDecodeRegion(region);
+        GainCompensation compensation;
+        compensation.enabled = i % 2;
+        driver.setGainCompensation(compensation);
+        driver.setIntensityLUT(i % 2 ? IntensityLUT::gamma(0.5) : IntensityLUT());
+        manager->configure(0, fireConfiguration(5 + i % 2), UPDATE_40HZ_MAX);
+        ASSERT_TRUE(manager->pop(sample, base::Time::fromSeconds(2)));
+    }
+
+    manager->configure(0, fireConfiguration(5), UPDATE_40HZ_MAX);
+    DecodeRegion region;
+    region.range_decimation = 2;
+    driver.setDecodeRegion(region);
+    ASSERT_EQ(2, driver.getDecodeRegion().range_decimation);
+    // Wait for the pings decoded before the change to go through
+    for (int i = 0; i < 40; i++) {
+        ASSERT_TRUE(manager->pop(sample, base::Time::fromSeconds(2)));
+    }
+    ASSERT_EQ(50, sample.sonar.bin_count);
+    ASSERT_EQ(0u, manager->getStatistics().decode_errors);
+}
+
+TEST_F(SonarManagerTest, it_refuses_to_add_devices_while_running)
+{
+    startDevices(1);
+    manager->start();
+    ASSERT_THROW(manager->addDevice(unique_ptr<Driver>()), std::runtime_error);
+}
@@ -0,0 +1,152 @@
+#include "Helpers.hpp"
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sonar_oculus_m750d/Driver.hpp>
+#include <sonar_oculus_m750d/Simulator.hpp>
+#include <sonar_oculus_m750d/StatusListener.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+using namespace test_helpers;
+
+struct StatusListenerTest : public ::testing::Test {
+    StatusListener listener = StatusListener(0);
+    int sender = -1;
+
+    StatusListenerTest()
+    {
+        listener.open();
+        sender = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+
+    ~StatusListenerTest()
+    {
+        ::close(sender);
+    }
+
+    /** Stand-in for the broadcast of a sonar */
+    void send(vector<uint8_t> const& datagram)
+    {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(listener.getPort());
+        ASSERT_EQ(static_cast<ssize_t>(datagram.size()),
+            sendto(sender,
+                datagram.data(),
+                datagram.size(),
+                0,
+                reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)));
+    }
+};
+
+TEST_F(StatusListenerTest, it_picks_the_limits_of_the_part_number)
+{
+    auto limits = DeviceLimits::fromPartNumber(partNumberM1200d);
+    ASSERT_TRUE(limits.has_low_frequency);
+    ASSERT_EQ(40, limits.max_low_frequency_range);
+    ASSERT_EQ(10, limits.max_high_frequency_range);
+
+    limits = DeviceLimits::fromPartNumber(partNumberM370s);
+    ASSERT_FALSE(limits.has_high_frequency);
+    ASSERT_EQ(200, limits.max_low_frequency_range);
+}
+
+TEST_F(StatusListenerTest, it_uses_the_default_limits_for_unknown_part_numbers)
+{
+    auto limits = DeviceLimits::fromPartNumber(4242);
+    ASSERT_EQ(120, limits.max_low_frequency_range);
+    ASSERT_EQ(40, limits.max_high_frequency_range);
+}
+
+TEST_F(StatusListenerTest, it_adapts_a_configuration_to_the_device)
+{
+    M750DConfiguration conf;
+    conf.mode = 2;
+    conf.range = 100;
+    auto applied = DeviceLimits::fromPartNumber(partNumberM750d).apply(conf);
+    ASSERT_EQ(2, applied.mode);
+    ASSERT_EQ(40, applied.range);
+
+    applied = DeviceLimits::fromPartNumber(partNumberM370s).apply(conf);
+    ASSERT_EQ(1, applied.mode);
+    ASSERT_EQ(100, applied.range);
+}
+
+TEST_F(StatusListenerTest, it_parses_the_status_broadcast)
+{
+    send(statusMessage(partNumberM1200d, inet_addr("192.168.1.42"), 7));
+    DeviceStatus status;
+    ASSERT_TRUE(listener.waitForStatus(status, base::Time::fromSeconds(1)));
+    ASSERT_EQ(7u, status.device_id);
+    ASSERT_EQ(partNumberM1200d, status.part_number);
+    ASSERT_EQ("192.168.1.42", status.ip_address);
+    ASSERT_EQ("tcp://192.168.1.42:52100", status.uri());
+    ASSERT_EQ(21.5, status.temperatures[0]);
+    ASSERT_EQ(10, status.limits.max_high_frequency_range);
+    ASSERT_FALSE(status.time.isNull());
+}
+
+TEST_F(StatusListenerTest, it_falls_back_to_the_sender_address)
+{
+    send(statusMessage(partNumberM750d, 0));
+    DeviceStatus status;
+    ASSERT_TRUE(listener.waitForStatus(status, base::Time::fromSeconds(1)));
+    ASSERT_EQ("127.0.0.1", status.ip_address);
+}
+
+TEST_F(StatusListenerTest, it_ignores_other_datagrams)
+{
+    auto status_message = statusMessage(partNumberM750d, 0);
+    send(vector<uint8_t>(status_message.begin(), status_message.end() - 1));
+    status_message[0] = 0;
+    send(status_message);
+    DeviceStatus status;
+    ASSERT_FALSE(listener.waitForStatus(status, base::Time::fromMilliseconds(50)));
+}
+
+TEST_F(StatusListenerTest, it_connects_and_measures_the_time_to_first_ping)
+{
+    SimulatorConfiguration config;
+    config.beam_count = 256;
+    config.range_resolution = 0.05;
+    config.ping_rate = 100;
+    Simulator simulator(config);
+    simulator.start();
+
+    send(statusMessage(partNumberM750d, htonl(INADDR_LOOPBACK)));
+    DeviceStatus status;
+    ASSERT_TRUE(listener.waitForStatus(status, base::Time::fromSeconds(1)));
+
+    Driver driver(base::Angle::fromDeg(1), base::Angle::fromDeg(20));
+    driver.setReadTimeout(base::Time::fromSeconds(2));
+    driver.openURI(status.uri(simulator.getPort()));
+    M750DConfiguration conf;
+    conf.mode = 2;
+    conf.range = 60;
+    conf.gain = 0.5;
+    conf.speed_of_sound = 1500;
+    driver.fireSonar(status.limits.apply(conf), UPDATE_40HZ_MAX);
+    ASSERT_TRUE(driver.getTimeToFirstPing().isNull());
+
+    base::samples::Sonar sonar;
+    while (!driver.processOne(sonar)) {
+    }
+    // Clamped to the 40 m of the high frequency mode
+    ASSERT_EQ(800, sonar.bin_count);
+    base::Time time_to_first_ping = driver.getTimeToFirstPing();
+    ASSERT_GT(time_to_first_ping, base::Time());
+    ASSERT_LT(time_to_first_ping, base::Time::fromSeconds(1));
+    ASSERT_EQ(time_to_first_ping, driver.getStatistics().time_to_first_ping);
+
+    driver.processOne(sonar);
+    ASSERT_EQ(time_to_first_ping, driver.getTimeToFirstPing());
+    driver.resetStatistics();
+    ASSERT_TRUE(driver.getTimeToFirstPing().isNull());
+    simulator.stop();
+}
@@ -0,0 +1,436 @@
+#include <gtest/gtest.h>
+#include <sonar_oculus_m750d/IntensityLUT.hpp>
+#include <sonar_oculus_m750d/Protocol.hpp>
+#include <sonar_oculus_m750d/Transpose.hpp>
+
+#include <limits>
+#include <random>
+#include <string.h>
+
+using namespace sonar_oculus_m750d;
+using namespace std;
+
+struct TransposeTest : public ::testing::TestWithParam<TransposeKernel> {
+    void SetUp() override
+    {
+        if (!isTransposeKernelSupported(GetParam())) {
+            GTEST_SKIP() << "kernel not supported on this CPU";
+        }
+    }
+
+    static vector<uint8_t> randomImage(uint16_t beam_count, uint16_t bin_count)
+    {
+        mt19937 rng(beam_count * bin_count);
+        uniform_int_distribution<int> dist(0, 255);
+        vector<uint8_t> image(beam_count * bin_count);
+        for (auto& sample : image) {
+            sample = dist(rng);
+        }
+        return image;
+    }
+
+    static vector<float> reference(vector<uint8_t> const& image,
+        uint16_t beam_count,
+        uint16_t bin_count)
+    {
+        auto bins = Protocol::toBeamMajor(image, beam_count, bin_count);
+        Protocol::normalizeBins(bins);
+        return bins;
+    }
+
+    void assertMatchesReference(uint16_t beam_count, uint16_t bin_count)
+    {
+        auto image = randomImage(beam_count, bin_count);
+        vector<float> bins(beam_count * bin_count);
+        transposeNormalize(image.data(),
+            bins.data(),
+            beam_count,
+            bin_count,
+            Protocol::NORMALIZATION_FACTOR,
+            GetParam());
+        auto expected = reference(image, beam_count, bin_count);
+        ASSERT_EQ(0, memcmp(expected.data(), bins.data(), bins.size() * sizeof(float)));
+    }
+};
+
+TEST_P(TransposeTest, it_matches_the_two_pass_conversion_on_a_small_image)
+{
+    vector<uint8_t> image = {1, 2, 3, 4, 5, 6};
+    vector<float> bins(6);
+    transposeNormalize(image.data(),
+        bins.data(),
+        3,
+        2,
+        Protocol::NORMALIZATION_FACTOR,
+        GetParam());
+    ASSERT_EQ(reference(image, 3, 2), bins);
+}
+
+TEST_P(TransposeTest, it_matches_the_two_pass_conversion_for_every_sample_value)
+{
+    vector<uint8_t> image(256);
+    for (int i = 0; i < 256; i++) {
+        image[i] = i;
+    }
+    vector<float> bins(256);
+    transposeNormalize(image.data(),
+        bins.data(),
+        16,
+        16,
+        Protocol::NORMALIZATION_FACTOR,
+        GetParam());
+    ASSERT_EQ(reference(image, 16, 16), bins);
+}
+
+TEST_P(TransposeTest, it_matches_the_two_pass_conversion_on_full_size_images)
+{
+    assertMatchesReference(256, 1250);
+    assertMatchesReference(512, 1514);
+}
+
+TEST_P(TransposeTest, it_handles_sizes_that_are_not_a_multiple_of_the_block_size)
+{
+    assertMatchesReference(37, 101);
+    assertMatchesReference(513, 67);
+    assertMatchesReference(1, 9);
+}
+
+template <typename Sample>
+static void assertWideSamplesMatch(TransposeKernel kernel, double factor)
+{
+    uint16_t beam_count = 67;
+    uint16_t bin_count = 45;
+    mt19937 rng(42);
+    // Char types are not valid arguments of uniform_int_distribution
+    uniform_int_distribution<uint32_t> dist(0, numeric_limits<Sample>::max());
+    vector<Sample> samples(beam_count * bin_count);
+    for (auto& sample : samples) {
+        sample = static_cast<Sample>(dist(rng));
+    }
+    samples[0] = numeric_limits<Sample>::max();
+    samples[1] = 0;
+
+    // Offset the image by one byte to check that unaligned images are supported
+    vector<uint8_t> image(samples.size() * sizeof(Sample) + 1);
+    memcpy(image.data() + 1, samples.data(), samples.size() * sizeof(Sample));
+    vector<float> bins(samples.size());
+    transposeNormalize<Sample>(image.data() + 1,
+        bins.data(),
+        beam_count,
+        bin_count,
+        factor,
+        kernel);
+
+    for (int b = 0; b < beam_count; b++) {
+        for (int r = 0; r < bin_count; r++) {
+            float expected = static_cast<float>(
+                static_cast<double>(samples[r * beam_count + b]) * factor);
+            ASSERT_EQ(expected, bins[b * bin_count + r]) << b << " " << r;
+        }
+    }
+    ASSERT_EQ(1, bins[0]);
+}
+
+TEST_P(TransposeTest, it_converts_16_bit_samples)
+{
+    assertWideSamplesMatch<uint16_t>(GetParam(), Protocol::NORMALIZATION_FACTOR_16BIT);
+}
+
+TEST_P(TransposeTest, it_converts_32_bit_samples)
+{
+    assertWideSamplesMatch<uint32_t>(GetParam(), Protocol::NORMALIZATION_FACTOR_32BIT);
+}
+
+TEST_P(TransposeTest, it_applies_the_per_bin_gains_after_the_normalization)
+{
+    uint16_t beam_count = 37;
+    uint16_t bin_count = 101;
+    auto image = randomImage(beam_count, bin_count);
+    vector<float> gains(bin_count);
+    for (int r = 0; r < bin_count; r++) {
+        gains[r] = 1 + r * 0.37f;
+    }
+    vector<float> bins(beam_count * bin_count);
+    transposeNormalize(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        Protocol::NORMALIZATION_FACTOR,
+        GetParam(),
+        gains.data());
+
+    auto expected = reference(image, beam_count, bin_count);
+    for (int b = 0; b < beam_count; b++) {
+        for (int r = 0; r < bin_count; r++) {
+            ASSERT_EQ(expected[b * bin_count + r] * gains[r], bins[b * bin_count + r])
+                << b << " " << r;
+        }
+    }
+}
+
+TEST_P(TransposeTest, the_linear_table_gives_the_same_bins_than_the_normalization)
+{
+    uint16_t beam_count = 513;
+    uint16_t bin_count = 1250;
+    auto image = randomImage(beam_count, bin_count);
+    IntensityLUT lut;
+    vector<float> bins(beam_count * bin_count);
+    transposeLookup(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        lut.data(),
+        GetParam());
+    auto expected = reference(image, beam_count, bin_count);
+    ASSERT_EQ(0, memcmp(expected.data(), bins.data(), bins.size() * sizeof(float)));
+}
+
+TEST_P(TransposeTest, it_maps_the_samples_through_the_table)
+{
+    uint16_t beam_count = 37;
+    uint16_t bin_count = 101;
+    auto image = randomImage(beam_count, bin_count);
+    auto lut = IntensityLUT::gamma(0.4);
+    vector<float> gains(bin_count);
+    for (int r = 0; r < bin_count; r++) {
+        gains[r] = 1 + r * 0.37f;
+    }
+    vector<float> bins(beam_count * bin_count);
+    transposeLookup(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        lut.data(),
+        GetParam(),
+        gains.data());
+
+    for (int b = 0; b < beam_count; b++) {
+        for (int r = 0; r < bin_count; r++) {
+            ASSERT_EQ(lut[image[r * beam_count + b]] * gains[r], bins[b * bin_count + r])
+                << b << " " << r;
+        }
+    }
+}
+
+TEST_P(TransposeTest, it_interpolates_the_table_for_wider_samples)
+{
+    vector<uint16_t> samples = {0, 65535, 257 * 10, 257 * 10 + 128};
+    vector<uint8_t> image(samples.size() * sizeof(uint16_t));
+    memcpy(image.data(), samples.data(), image.size());
+    auto lut = IntensityLUT::gamma(2);
+    vector<float> bins(4);
+    transposeLookup<uint16_t>(image.data(), bins.data(), 4, 1, lut.data(), GetParam());
+    ASSERT_EQ(lut[0], bins[0]);
+    ASSERT_EQ(lut[255], bins[1]);
+    ASSERT_FLOAT_EQ(lut[10], bins[2]);
+    ASSERT_GT(bins[3], lut[10]);
+    ASSERT_LT(bins[3], lut[11]);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllKernels,
+    TransposeTest,
+    ::testing::Values(TRANSPOSE_KERNEL_SCALAR,
+        TRANSPOSE_KERNEL_SSE2,
+        TRANSPOSE_KERNEL_AVX2));
+
+/** Naive pooling of the window, as documented in TransposeWindow */
+static vector<double> poolReference(vector<uint8_t> const& image,
+    uint16_t beam_count,
+    TransposeWindow const& window)
+{
+    int out_bins = window.outputBinCount();
+    int out_beams = window.outputBeamCount();
+    vector<double> pooled(out_bins * out_beams);
+    for (int j = 0; j < out_beams; j++) {
+        for (int i = 0; i < out_bins; i++) {
+            double sum = 0;
+            double max = 0;
+            int count = 0;
+            for (int r = i * window.bin_step; r < (i + 1) * window.bin_step; r++) {
+                for (int b = window.beam_begin + j * window.beam_step;
+                     b < window.beam_begin + (j + 1) * window.beam_step;
+                     b++) {
+                    if (r < window.bin_begin || r >= window.bin_end ||
+                        b >= window.beam_end) {
+                        continue;
+                    }
+                    double sample = image[r * beam_count + b];
+                    sum += sample;
+                    max = std::max(max, sample);
+                    count++;
+                }
+            }
+            double value = window.pooling == POOLING_MAX ? max : sum / count;
+            pooled[j * out_bins + i] = count ? value : 0;
+        }
+    }
+    return pooled;
+}
+
+struct TransposeWindowTest : public ::testing::Test {
+    uint16_t beam_count = 131;
+    uint16_t bin_count = 203;
+    vector<uint8_t> image = TransposeTest::randomImage(beam_count, bin_count);
+
+    void assertMatchesReference(TransposeWindow const& window)
+    {
+        auto expected = poolReference(image, beam_count, window);
+        vector<float> bins(expected.size());
+        transposeWindow(image.data(),
+            bins.data(),
+            beam_count,
+            bin_count,
+            window,
+            Protocol::NORMALIZATION_FACTOR);
+        vector<uint8_t> bytes(expected.size());
+        transposeWindowBytes(image.data(), bytes.data(), beam_count, bin_count, window);
+        for (size_t i = 0; i < expected.size(); i++) {
+            ASSERT_FLOAT_EQ(expected[i] / 255, bins[i]) << i;
+            ASSERT_EQ(static_cast<uint8_t>(expected[i]), bytes[i]) << i;
+        }
+    }
+};
+
+TEST_F(TransposeWindowTest, it_converts_a_crop_exactly_as_the_full_conversion)
+{
+    TransposeWindow window;
+    window.bin_begin = 0;
+    window.bin_end = 150;
+    window.beam_begin = 10;
+    window.beam_end = 100;
+
+    vector<float> full(beam_count * bin_count);
+    transposeNormalize(image.data(),
+        full.data(),
+        beam_count,
+        bin_count,
+        Protocol::NORMALIZATION_FACTOR);
+    vector<float> bins(90 * 150);
+    transposeWindow(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        window,
+        Protocol::NORMALIZATION_FACTOR);
+    for (int b = 0; b < 90; b++) {
+        ASSERT_EQ(0,
+            memcmp(full.data() + (b + 10) * bin_count,
+                bins.data() + b * 150,
+                150 * sizeof(float)))
+            << b;
+    }
+}
+
+TEST_F(TransposeWindowTest, it_zeroes_the_bins_before_the_window)
+{
+    TransposeWindow window;
+    window.bin_begin = 70;
+    window.bin_end = bin_count;
+    window.beam_end = beam_count;
+    assertMatchesReference(window);
+}
+
+TEST_F(TransposeWindowTest, it_pools_with_the_maximum)
+{
+    TransposeWindow window;
+    window.bin_begin = 11;
+    window.bin_end = 190;
+    window.beam_begin = 3;
+    window.beam_end = 128;
+    window.bin_step = 3;
+    window.beam_step = 2;
+    window.pooling = POOLING_MAX;
+    assertMatchesReference(window);
+}
+
+TEST_F(TransposeWindowTest, it_pools_with_the_mean)
+{
+    TransposeWindow window;
+    window.bin_begin = 11;
+    window.bin_end = 190;
+    window.beam_begin = 3;
+    window.beam_end = 128;
+    window.bin_step = 4;
+    window.beam_step = 3;
+    window.pooling = POOLING_MEAN;
+    assertMatchesReference(window);
+}
+
+TEST_F(TransposeWindowTest, it_applies_the_gains_to_the_pooled_bins)
+{
+    TransposeWindow window;
+    window.bin_end = bin_count;
+    window.beam_end = beam_count;
+    window.bin_step = 3;
+    window.beam_step = 2;
+    vector<float> gains(window.outputBinCount());
+    for (size_t i = 0; i < gains.size(); i++) {
+        gains[i] = 1 + i * 0.5f;
+    }
+
+    auto expected = poolReference(image, beam_count, window);
+    vector<float> bins(expected.size());
+    transposeWindow(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        window,
+        Protocol::NORMALIZATION_FACTOR,
+        gains.data());
+    int out_bins = window.outputBinCount();
+    for (size_t k = 0; k < expected.size(); k++) {
+        float gain = gains[k % out_bins];
+        ASSERT_FLOAT_EQ(expected[k] / 255 * gain, bins[k]) << k;
+    }
+}
+
+TEST_F(TransposeWindowTest, it_maps_the_pooled_values_through_the_table)
+{
+    TransposeWindow window;
+    window.bin_begin = 10;
+    window.bin_end = bin_count;
+    window.beam_end = beam_count;
+    window.bin_step = 2;
+    window.pooling = POOLING_MAX;
+    auto lut = IntensityLUT::gamma(0.4);
+
+    auto expected = poolReference(image, beam_count, window);
+    vector<float> bins(expected.size());
+    transposeWindowLookup(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        window,
+        lut.data());
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(lut[static_cast<uint8_t>(expected[i])], bins[i]) << i;
+    }
+}
+
+TEST_F(TransposeWindowTest, it_sets_the_bins_without_input_to_zero_whatever_the_table)
+{
+    TransposeWindow window;
+    window.bin_begin = 10;
+    window.bin_end = bin_count;
+    window.beam_end = beam_count;
+    window.bin_step = 2;
+    auto lut = IntensityLUT::fromCurve([](double x) { return 1 - x; });
+
+    auto expected = poolReference(image, beam_count, window);
+    vector<float> bins(expected.size());
+    transposeWindowLookup(image.data(),
+        bins.data(),
+        beam_count,
+        bin_count,
+        window,
+        lut.data());
+    // The first 5 output bins are before bin_begin
+    int out_bins = window.outputBinCount();
+    for (int j = 0; j < window.outputBeamCount(); j++) {
+        for (int i = 0; i < 5; i++) {
+            ASSERT_EQ(0, bins[j * out_bins + i]) << j << " " << i;
+        }
+        float first = lut[static_cast<uint8_t>(expected[j * out_bins + 5])];
+        ASSERT_EQ(first, bins[j * out_bins + 5]) << j;
+    }
+}